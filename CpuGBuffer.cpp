@@ -0,0 +1,152 @@
+#include "CpuGBuffer.h"
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace ReSTIR
+{
+    namespace
+    {
+        bool IsLittleEndianHost()
+        {
+            uint32_t v = 1;
+            uint8_t b;
+            std::memcpy(&b, &v, 1);
+            return b == 1;
+        }
+
+        void SwapBytes(std::vector<float>& data)
+        {
+            for (auto& f : data)
+            {
+                uint32_t v;
+                std::memcpy(&v, &f, 4);
+                v = (v >> 24) | ((v >> 8) & 0xff00u) | ((v << 8) & 0xff0000u) | (v << 24);
+                std::memcpy(&f, &v, 4);
+            }
+        }
+
+        std::string PlanePath(const std::string& directory, const char* name)
+        {
+            return directory + "/" + name + ".pfm";
+        }
+
+        bool LoadPlane(const std::string& directory, const char* name, uint32_t expectedChannels, uint32_t& width, uint32_t& height, std::vector<float>& data)
+        {
+            uint32_t w, h, c;
+            if (!ReadPfm(PlanePath(directory, name), w, h, c, data)) return false;
+            if (c != expectedChannels) throw std::runtime_error(std::string("Plane '") + name + "' has the wrong channel count");
+            if (width == 0 && height == 0)
+            {
+                width = w;
+                height = h;
+            }
+            else if (w != width || h != height)
+            {
+                throw std::runtime_error(std::string("Plane '") + name + "' does not match the frame size");
+            }
+            return true;
+        }
+
+        bool LoadPlane(const std::string& directory, const char* name, uint32_t& width, uint32_t& height, std::vector<Vec3>& plane)
+        {
+            std::vector<float> data;
+            if (!LoadPlane(directory, name, 3, width, height, data)) return false;
+            plane.resize(data.size() / 3);
+            for (size_t i = 0; i < plane.size(); i++) plane[i] = Vec3(data[3 * i], data[3 * i + 1], data[3 * i + 2]);
+            return true;
+        }
+
+        bool LoadPlane(const std::string& directory, const char* name, uint32_t& width, uint32_t& height, std::vector<float>& plane)
+        {
+            return LoadPlane(directory, name, 1, width, height, plane);
+        }
+    }
+
+    bool ReadPfm(const std::string& path, uint32_t& width, uint32_t& height, uint32_t& channels, std::vector<float>& data)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return false;
+
+        std::string magic;
+        float scale;
+        file >> magic >> width >> height >> scale;
+        file.get();
+        if (!file || (magic != "PF" && magic != "Pf")) return false;
+        channels = magic == "PF" ? 3 : 1;
+
+        size_t rowSize = (size_t)width * channels;
+        data.resize(rowSize * height);
+        // PFM stores the bottom row first.
+        for (uint32_t y = 0; y < height; y++)
+        {
+            file.read(reinterpret_cast<char*>(data.data() + rowSize * (height - 1 - y)), rowSize * sizeof(float));
+        }
+        if (!file) return false;
+
+        bool fileLittleEndian = scale < 0.f;
+        if (fileLittleEndian != IsLittleEndianHost()) SwapBytes(data);
+        return true;
+    }
+
+    bool WritePfm(const std::string& path, uint32_t width, uint32_t height, uint32_t channels, const float* data)
+    {
+        std::ofstream file(path, std::ios::binary);
+        if (!file) return false;
+
+        file << (channels == 3 ? "PF" : "Pf") << "\n" << width << " " << height << "\n" << (IsLittleEndianHost() ? "-1.0" : "1.0") << "\n";
+        size_t rowSize = (size_t)width * channels;
+        for (uint32_t y = 0; y < height; y++)
+        {
+            file.write(reinterpret_cast<const char*>(data + rowSize * (height - 1 - y)), rowSize * sizeof(float));
+        }
+        return (bool)file;
+    }
+
+    CpuGBuffer CpuGBuffer::LoadFromDirectory(const std::string& directory)
+    {
+        CpuGBuffer g;
+        auto require = [&](bool loaded, const char* name)
+        {
+            if (!loaded) throw std::runtime_error("Missing G-buffer plane '" + PlanePath(directory, name) + "'");
+        };
+
+        require(LoadPlane(directory, "vPosW", g.width, g.height, g.vPosW), "vPosW");
+        require(LoadPlane(directory, "vNormW", g.width, g.height, g.vNormW), "vNormW");
+        require(LoadPlane(directory, "sPosW", g.width, g.height, g.sPosW), "sPosW");
+        require(LoadPlane(directory, "sNormW", g.width, g.height, g.sNormW), "sNormW");
+        require(LoadPlane(directory, "sColor", g.width, g.height, g.sColor), "sColor");
+        require(LoadPlane(directory, "random", g.width, g.height, g.random), "random");
+
+        if (!LoadPlane(directory, "depth", g.width, g.height, g.depth) || !LoadPlane(directory, "normW", g.width, g.height, g.normW))
+        {
+            g.depth.clear();
+            g.normW.clear();
+        }
+        return g;
+    }
+
+    void CpuGBuffer::SaveToDirectory(const std::string& directory) const
+    {
+        auto save = [&](const char* name, uint32_t channels, const void* data)
+        {
+            if (!WritePfm(PlanePath(directory, name), width, height, channels, static_cast<const float*>(data)))
+            {
+                throw std::runtime_error("Failed to write G-buffer plane '" + PlanePath(directory, name) + "'");
+            }
+        };
+
+        save("vPosW", 3, vPosW.data());
+        save("vNormW", 3, vNormW.data());
+        save("sPosW", 3, sPosW.data());
+        save("sNormW", 3, sNormW.data());
+        save("sColor", 3, sColor.data());
+        save("random", 1, random.data());
+        if (HasSimilarityPlanes())
+        {
+            save("depth", 1, depth.data());
+            save("normW", 3, normW.data());
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "HostReservoir.h"
+#include <string>
+#include <vector>
+
+namespace ReSTIR
+{
+    /** The per pixel inputs of ReSTIRPass held in CPU memory, one plane per render graph channel.
+        Planes are stored as PFM files named after the pass channels (vPosW.pfm, vNormW.pfm, sPosW.pfm, sNormW.pfm,
+        sColor.pfm, random.pfm and optionally depth.pfm and normW.pfm).
+    */
+    struct CpuGBuffer
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+
+        std::vector<Vec3> vPosW;
+        std::vector<Vec3> vNormW;
+        std::vector<Vec3> sPosW;
+        std::vector<Vec3> sNormW;
+        std::vector<Vec3> sColor;
+        std::vector<float> random;
+
+        std::vector<float> depth;       ///< Optional, used by the similarity test.
+        std::vector<Vec3> normW;        ///< Optional, used by the similarity test.
+
+        uint32_t GetPixelCount() const { return width * height; }
+        bool HasSimilarityPlanes() const { return !depth.empty() && !normW.empty(); }
+
+        /** Load all planes from a directory. Throws std::runtime_error if a required plane is missing or the sizes differ.
+        */
+        static CpuGBuffer LoadFromDirectory(const std::string& directory);
+
+        void SaveToDirectory(const std::string& directory) const;
+    };
+
+    /** Read a PFM image (color "PF" or grayscale "Pf"). Rows are returned top to bottom.
+        \param[out] channels 3 or 1.
+    */
+    bool ReadPfm(const std::string& path, uint32_t& width, uint32_t& height, uint32_t& channels, std::vector<float>& data);
+
+    bool WritePfm(const std::string& path, uint32_t width, uint32_t height, uint32_t channels, const float* data);
+}
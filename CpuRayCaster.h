@@ -0,0 +1,28 @@
+#pragma once
+#include "HostReservoir.h"
+
+namespace ReSTIR
+{
+    /** Visibility queries of the CPU reference engine.
+        Implementations must be safe to call from several threads at once.
+    */
+    class ICpuRayCaster
+    {
+    public:
+        virtual ~ICpuRayCaster() = default;
+
+        /** Same contract as TraceVisibilityRay in SpatialtemporalResample.cs.slang:
+            the segment from origin to 0.999 of the way to dst is tested, starting at t = 0.001.
+            \return True if nothing blocks the segment.
+        */
+        virtual bool TraceVisibilityRay(const Vec3& origin, const Vec3& norm, const Vec3& dst) const = 0;
+    };
+
+    /** Ray caster for scenes without occluders, or studies that ignore visibility.
+    */
+    class UnoccludedRayCaster : public ICpuRayCaster
+    {
+    public:
+        bool TraceVisibilityRay(const Vec3&, const Vec3&, const Vec3&) const override { return true; }
+    };
+}
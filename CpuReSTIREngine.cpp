@@ -0,0 +1,331 @@
+#include "CpuReSTIREngine.h"
+#include <stdexcept>
+
+namespace ReSTIR
+{
+    namespace
+    {
+        /** clip = viewProj * (p, 1) with a column major matrix. */
+        void TransformPoint(const float m[16], const Vec3& p, float clip[4])
+        {
+            for (int r = 0; r < 4; r++) clip[r] = m[r] * p.x + m[4 + r] * p.y + m[8 + r] * p.z + m[12 + r];
+        }
+    }
+
+    CpuReSTIREngine::CpuReSTIREngine(CpuThreadPool& threadPool, const ICpuRayCaster& rayCaster)
+        : mThreadPool(threadPool)
+        , mRayCaster(rayCaster)
+    {
+        mScratch.resize(mThreadPool.GetWorkerCount());
+    }
+
+    void CpuReSTIREngine::Reset()
+    {
+        mFrameCount = 0;
+        std::fill(mTemporalReservoirs.begin(), mTemporalReservoirs.end(), Reservoir());
+        std::fill(mSpatialReservoirs.begin(), mSpatialReservoirs.end(), Reservoir());
+    }
+
+    void CpuReSTIREngine::Resize(uint32_t width, uint32_t height)
+    {
+        uint32_t srcWidth = mWidth;
+        uint32_t srcHeight = mHeight;
+        std::vector<Reservoir> srcTemporal = std::move(mTemporalReservoirs);
+        const Reservoir* pSrcHistory = srcTemporal.empty() ? nullptr : srcTemporal.data() + (size_t)mTemLastOffset * srcWidth * srcHeight;
+
+        mWidth = width;
+        mHeight = height;
+        size_t elemCount = (size_t)width * height;
+        mInitialReservoirs.assign(elemCount, Reservoir());
+        mTemporalReservoirs.assign(2 * elemCount, Reservoir());
+        mSpatialReservoirs.assign(elemCount, Reservoir());
+
+        if (mFrameCount == 0 || !pSrcHistory || elemCount == 0) return;
+
+        // Same mapping as ReservoirResize.cs.slang.
+        float scaleX = (float)srcWidth / width;
+        float scaleY = (float)srcHeight / height;
+        float coverage = std::min(1.f, scaleX * scaleY);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            uint32_t srcY = std::min((uint32_t)((y + 0.5f) * scaleY), srcHeight - 1);
+            for (uint32_t x = 0; x < width; x++)
+            {
+                uint32_t srcX = std::min((uint32_t)((x + 0.5f) * scaleX), srcWidth - 1);
+                Reservoir r = pSrcHistory[srcY * srcWidth + srcX];
+                if (r.M > 0) r.M = std::max(1u, (uint32_t)(r.M * coverage));
+                TemporalReservoir(y * width + x, true) = r;
+            }
+        }
+    }
+
+    const Reservoir* CpuReSTIREngine::GetTemporalReservoirs(bool isLastFrame) const
+    {
+        size_t elemCount = (size_t)mWidth * mHeight;
+        return mTemporalReservoirs.data() + (isLastFrame ? mTemLastOffset : mTemCurOffset) * elemCount;
+    }
+
+    Reservoir& CpuReSTIREngine::TemporalReservoir(uint32_t linearID, bool isLastFrame)
+    {
+        size_t elemCount = (size_t)mWidth * mHeight;
+        return mTemporalReservoirs[(isLastFrame ? mTemLastOffset : mTemCurOffset) * elemCount + linearID];
+    }
+
+    void CpuReSTIREngine::ExecuteFrame(const CpuGBuffer& gbuffer, const CpuCameraState& camera)
+    {
+        if (gbuffer.vPosW.size() != gbuffer.GetPixelCount()) throw std::runtime_error("CpuReSTIREngine: incomplete G-buffer");
+        if (gbuffer.width != mWidth || gbuffer.height != mHeight) Resize(gbuffer.width, gbuffer.height);
+
+        mpGBuffer = &gbuffer;
+        mCamera = camera;
+        if (mFrameCount == 0) mPrevCamera = camera;
+        for (auto& scratch : mScratch) scratch.stats = FrameStats();
+
+        uint32_t tilesX = (mWidth + kTileSize - 1) / kTileSize;
+        uint32_t tilesY = (mHeight + kTileSize - 1) / kTileSize;
+        mThreadPool.ParallelFor(tilesX * tilesY, [this](uint32_t tileIndex, uint32_t workerIndex) { ExecuteTile(tileIndex, workerIndex); });
+
+        mFrameStats = FrameStats();
+        for (const auto& scratch : mScratch)
+        {
+            mFrameStats.neighborsTested += scratch.stats.neighborsTested;
+            mFrameStats.neighborsMerged += scratch.stats.neighborsMerged;
+            mFrameStats.visibilityRays += scratch.stats.visibilityRays;
+            mFrameStats.reusedVisibilityTests += scratch.stats.reusedVisibilityTests;
+            mFrameStats.temporalResets += scratch.stats.temporalResets;
+        }
+
+        mFrameCount++;
+        std::swap(mTemCurOffset, mTemLastOffset);
+        mPrevCamera = camera;
+        mpGBuffer = nullptr;
+    }
+
+    void CpuReSTIREngine::ExecuteTile(uint32_t tileIndex, uint32_t workerIndex)
+    {
+        WorkerScratch& scratch = mScratch[workerIndex];
+        uint32_t tilesX = (mWidth + kTileSize - 1) / kTileSize;
+        uint32_t x0 = (tileIndex % tilesX) * kTileSize;
+        uint32_t y0 = (tileIndex / tilesX) * kTileSize;
+
+        scratch.tilePixels.clear();
+        for (uint32_t y = y0; y < std::min(y0 + kTileSize, mHeight); y++)
+        {
+            for (uint32_t x = x0; x < std::min(x0 + kTileSize, mWidth); x++) scratch.tilePixels.push_back(y * mWidth + x);
+        }
+
+        for (uint32_t linearID : scratch.tilePixels) mInitialReservoirs[linearID] = CreateInitialReservoir(linearID);
+
+        for (uint32_t linearID : scratch.tilePixels)
+        {
+            HostSampleGenerator sg(linearID % mWidth, linearID / mWidth, mFrameCount);
+            TemporalResample(linearID % mWidth, linearID / mWidth, sg, scratch.stats);
+        }
+
+        SpatialResampleTile(scratch.tilePixels, scratch);
+    }
+
+    Reservoir CpuReSTIREngine::CreateInitialReservoir(uint32_t linearID) const
+    {
+        const CpuGBuffer& g = *mpGBuffer;
+        Reservoir r;
+        r.z.vPos = g.vPosW[linearID];
+        r.z.vNorm = g.vNormW[linearID];
+        r.z.sPos = g.sPosW[linearID];
+        r.z.sNorm = g.sNormW[linearID];
+        r.z.radiance = g.sColor[linearID];
+
+        if (Dot(r.z.vNorm, r.z.sPos - r.z.vPos) < 0.f) r.z.vNorm = -r.z.vNorm;
+        if (Dot(r.z.sNorm, r.z.vPos - r.z.sPos) < 0.f) r.z.sNorm = -r.z.sNorm;
+
+        float random = g.random[linearID];
+        r.weightF = random > 0.f ? 1.f / random : 0.f;
+        r.M = random > 0.f ? 1u : 0u;
+        r.age = 0;
+        return r;
+    }
+
+    float CpuReSTIREngine::GetDepth(uint32_t linearID) const
+    {
+        if (mpGBuffer->HasSimilarityPlanes()) return mpGBuffer->depth[linearID];
+        return Length(mpGBuffer->vPosW[linearID] - mCamera.posW);
+    }
+
+    Vec3 CpuReSTIREngine::GetNormal(uint32_t linearID) const
+    {
+        if (mpGBuffer->HasSimilarityPlanes()) return mpGBuffer->normW[linearID];
+        return mpGBuffer->vNormW[linearID];
+    }
+
+    bool CpuReSTIREngine::CompareSimilarity(uint32_t thisID, uint32_t neighborID) const
+    {
+        float depth = GetDepth(thisID);
+        if (std::abs(depth - GetDepth(neighborID)) > mSettings.depthThreshold * depth) return false;
+        if (Dot(GetNormal(thisID), GetNormal(neighborID)) < mSettings.normalThreshold) return false;
+        return true;
+    }
+
+    void CpuReSTIREngine::TemporalResample(uint32_t x, uint32_t y, HostSampleGenerator& sg, FrameStats& stats)
+    {
+        uint32_t linearID = y * mWidth + x;
+        const Reservoir& initialSample = mInitialReservoirs[linearID];
+
+        float prevClip[4];
+        TransformPoint(mPrevCamera.viewProj, initialSample.z.vPos, prevClip);
+        float prevU = prevClip[0] / prevClip[3] * 0.5f + 0.5f;
+        float prevV = prevClip[1] / prevClip[3] * -0.5f + 0.5f;
+        uint32_t prevX = (uint32_t)std::clamp(prevU * mWidth, 0.f, (float)(mWidth - 1));
+        uint32_t prevY = (uint32_t)std::clamp(prevV * mHeight, 0.f, (float)(mHeight - 1));
+
+        bool isPrevValid = mFrameCount > 0 && prevU > 0.f && prevV > 0.f && prevU < 1.f && prevV < 1.f;
+        float viewDepth = Length(initialSample.z.vPos - mCamera.posW);
+        float prevViewDepth = Length(initialSample.z.vPos - mPrevCamera.posW);
+        float rand = sg.Next1D();
+        if (viewDepth / prevViewDepth < 0.98f && rand < 0.15f) isPrevValid = false;
+
+        Reservoir temporalReservoir = TemporalReservoir(prevY * mWidth + prevX, true);
+        temporalReservoir.M = std::min(temporalReservoir.M, mSettings.temporalMaxM);
+        if (!isPrevValid || Length(temporalReservoir.z.vPos - initialSample.z.vPos) > 1.f || temporalReservoir.age > mSettings.maxSampleAge)
+        {
+            temporalReservoir.M = 0;
+            stats.temporalResets++;
+        }
+
+        float tp = Luminance(temporalReservoir.z.radiance);
+        float wSum = temporalReservoir.M * tp * std::max(0.f, temporalReservoir.weightF);
+
+        float tpCurrent = Luminance(initialSample.z.radiance);
+        temporalReservoir.Merge(sg, initialSample, tpCurrent, wSum);
+
+        float tpNew = Luminance(temporalReservoir.z.radiance);
+        temporalReservoir.ComputeFinalWeight(tpNew, wSum);
+
+        temporalReservoir.age++;
+        temporalReservoir.z.vPos = initialSample.z.vPos;
+        temporalReservoir.z.vNorm = initialSample.z.vNorm;
+        TemporalReservoir(linearID, false) = temporalReservoir;
+    }
+
+    void CpuReSTIREngine::SpatialResampleTile(const std::vector<uint32_t>& tilePixels, WorkerScratch& scratch)
+    {
+        ReuseCandidates& candidates = scratch.candidates;
+        candidates.Clear();
+        scratch.candidateInfo.clear();
+        scratch.generators.clear();
+
+        // Gather the neighbours of every pixel of the tile that pass the cheap tests.
+        for (uint32_t p = 0; p < (uint32_t)tilePixels.size(); p++)
+        {
+            uint32_t linearID = tilePixels[p];
+            uint32_t x = linearID % mWidth;
+            uint32_t y = linearID / mWidth;
+            scratch.generators.emplace_back(x, y, mFrameCount);
+            HostSampleGenerator& sg = scratch.generators.back();
+
+            const Reservoir& r = TemporalReservoir(linearID, false);
+            if (IsZero(r.z.vNorm)) continue;
+
+            for (uint32_t i = 0; i < mSettings.spatialNeighborCount; i++)
+            {
+                float offsetX = (sg.Next1D() * 2.f - 1.f) * mSettings.sampleRadius;
+                float offsetY = (sg.Next1D() * 2.f - 1.f) * mSettings.sampleRadius;
+                int32_t nx = (int32_t)(x + offsetX);
+                int32_t ny = (int32_t)(y + offsetY);
+                if (nx < 0 || ny < 0 || nx >= (int32_t)mWidth || ny >= (int32_t)mHeight) continue;
+
+                uint32_t neighborID = (uint32_t)ny * mWidth + (uint32_t)nx;
+                if (!CompareSimilarity(linearID, neighborID)) continue;
+
+                const Reservoir& neighborReservoir = TemporalReservoir(neighborID, true);
+                if (neighborReservoir.M <= 0) continue;
+
+                candidates.Push(r.z.vPos, r.z.vNorm, neighborReservoir);
+                scratch.candidateInfo.push_back({ p, neighborID });
+            }
+        }
+        scratch.stats.neighborsTested += candidates.GetCount();
+
+        EvaluateReuseCandidates(candidates, mSettings.jacobianClamp);
+
+        // Merge in order, one pixel at a time.
+        const uint32_t kMaxReuse = 16;
+        Vec3 positionList[kMaxReuse];
+        Vec3 normalList[kMaxReuse];
+        uint32_t MList[kMaxReuse];
+
+        size_t c = 0;
+        for (uint32_t p = 0; p < (uint32_t)tilePixels.size(); p++)
+        {
+            uint32_t linearID = tilePixels[p];
+            Reservoir r = TemporalReservoir(linearID, false);
+            if (IsZero(r.z.vNorm))
+            {
+                mSpatialReservoirs[linearID] = r;
+                continue;
+            }
+
+            HostSampleGenerator& sg = scratch.generators[p];
+            uint32_t nReuse = 0;
+            positionList[nReuse] = r.z.vPos;
+            normalList[nReuse] = r.z.vNorm;
+            MList[nReuse] = r.M;
+            nReuse++;
+
+            float tp = Luminance(r.z.radiance);
+            float wSum = r.M * tp * std::max(0.f, r.weightF);
+
+            uint32_t selected = 0;
+            bool selectedVisible = true;
+
+            for (; c < candidates.GetCount() && scratch.candidateInfo[c].pixelIndex == p; c++)
+            {
+                if (!candidates.accepted[c] || nReuse == kMaxReuse) continue;
+
+                const Reservoir& neighborReservoir = TemporalReservoir(scratch.candidateInfo[c].neighborID, true);
+                float targetPdf = candidates.targetPdf[c];
+                scratch.stats.visibilityRays++;
+                bool visible = mRayCaster.TraceVisibilityRay(r.z.vPos, r.z.vNorm, neighborReservoir.z.sPos);
+                if (!visible) targetPdf = 0.f;
+
+                if (r.Merge(sg, neighborReservoir, targetPdf, wSum))
+                {
+                    selected = nReuse;
+                    selectedVisible = visible;
+                }
+                positionList[nReuse] = neighborReservoir.z.vPos;
+                normalList[nReuse] = neighborReservoir.z.vNorm;
+                MList[nReuse] = neighborReservoir.M;
+                nReuse++;
+                scratch.stats.neighborsMerged++;
+            }
+
+            uint32_t z = 0;
+            for (uint32_t i = 0; i < nReuse; i++)
+            {
+                Vec3 dir = Normalize(r.z.sPos - positionList[i]);
+                if (Dot(dir, normalList[i]) < 0.f) continue;
+
+                bool visible = true;
+                if (mSettings.biasCorrectionMode == CpuBiasCorrectionMode::ReuseVisibility && (i == 0 || i == selected))
+                {
+                    // The center traced this segment while merging, the owner reached the sample by its own path.
+                    visible = i == selected || selectedVisible;
+                    scratch.stats.reusedVisibilityTests++;
+                }
+                else if (mSettings.biasCorrectionMode != CpuBiasCorrectionMode::Biased)
+                {
+                    scratch.stats.visibilityRays++;
+                    visible = mRayCaster.TraceVisibilityRay(positionList[i], normalList[i], r.z.sPos);
+                }
+                if (visible) z += MList[i];
+            }
+
+            r.M = z;
+            float tpNew = Luminance(r.z.radiance);
+            r.ComputeFinalWeight(tpNew, wSum);
+
+            r.weightF = std::clamp(r.weightF, 0.f, mSettings.weightClamp);
+            mSpatialReservoirs[linearID] = r;
+        }
+    }
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include "HostReservoir.h"
+#include "CpuGBuffer.h"
+#include "CpuRayCaster.h"
+#include "CpuResampleKernels.h"
+#include "CpuThreadPool.h"
+#include <atomic>
+
+namespace ReSTIR
+{
+    /** Camera state of a frame. viewProj is column major, the layout of Camera::getViewProjMatrixNoJitter().
+    */
+    struct CpuCameraState
+    {
+        Vec3 posW;
+        float viewProj[16] = { 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f };
+    };
+
+    /** BiasCorrectionMode of ReSTIRParams.slang, same values. */
+    enum class CpuBiasCorrectionMode : uint32_t
+    {
+        Unbiased = 0,
+        ReuseVisibility = 1,
+        Biased = 2,
+    };
+
+    /** Tunables of the resampling stages, the fields of RenderingRuntimeParams with the same names and defaults.
+        jacobianClamp is still a constant in SpatialtemporalResample.cs.slang.
+    */
+    struct CpuResampleSettings
+    {
+        uint32_t sampleRadius = 30;
+        uint32_t spatialNeighborCount = 3;
+        uint32_t temporalMaxM = 30;
+        int32_t maxSampleAge = 100;
+        float depthThreshold = 0.1f;
+        float normalThreshold = 0.9f;
+        float weightClamp = 10.f;
+        float jacobianClamp = 10.f;
+        CpuBiasCorrectionMode biasCorrectionMode = CpuBiasCorrectionMode::Unbiased;  ///< The GPU ray budget is not modelled.
+    };
+
+    /** Multithreaded CPU implementation of the ReSTIR GI resampling pipeline of ReSTIRPass:
+        initial reservoirs (initialReservoir.cs.slang), temporal and spatial resampling (SpatialtemporalResample.cs.slang).
+        The frame is split into 16x16 tiles, the size of the GPU thread groups, which run on a work stealing pool.
+        Spatial reuse of a tile is batched and the shift mapping is evaluated with the SIMD kernels of CpuResampleKernels.h.
+        The random sequences differ from the GPU, so results match statistically but not bit for bit.
+    */
+    class CpuReSTIREngine
+    {
+    public:
+        static const uint32_t kTileSize = 16;
+
+        struct FrameStats
+        {
+            uint64_t neighborsTested = 0;       ///< Neighbours passing the pixel and similarity tests.
+            uint64_t neighborsMerged = 0;       ///< Neighbours merged into the spatial reservoir.
+            uint64_t visibilityRays = 0;        ///< Rays sent to the ray caster.
+            uint64_t reusedVisibilityTests = 0; ///< Bias correction rays skipped by reusing the merge results.
+            uint64_t temporalResets = 0;        ///< Pixels whose temporal history was dropped.
+        };
+
+        CpuReSTIREngine(CpuThreadPool& threadPool, const ICpuRayCaster& rayCaster);
+
+        void SetSettings(const CpuResampleSettings& settings) { mSettings = settings; }
+        const CpuResampleSettings& GetSettings() const { return mSettings; }
+
+        /** Drop all history. The next frame starts without temporal reuse.
+        */
+        void Reset();
+
+        /** Run initial reservoir creation, temporal and spatial resampling for one frame.
+            If the frame size changes the temporal history is resampled into the new grid.
+        */
+        void ExecuteFrame(const CpuGBuffer& gbuffer, const CpuCameraState& camera);
+
+        uint32_t GetWidth() const { return mWidth; }
+        uint32_t GetHeight() const { return mHeight; }
+        uint32_t GetFrameCount() const { return mFrameCount; }
+        const FrameStats& GetFrameStats() const { return mFrameStats; }
+
+        const std::vector<Reservoir>& GetInitialReservoirs() const { return mInitialReservoirs; }
+        const Reservoir* GetTemporalReservoirs(bool isLastFrame) const;
+        const std::vector<Reservoir>& GetSpatialReservoirs() const { return mSpatialReservoirs; }
+
+    private:
+        struct CandidateInfo
+        {
+            uint32_t pixelIndex;    ///< Index of the receiving pixel inside the tile.
+            uint32_t neighborID;    ///< Linear index of the neighbour pixel.
+        };
+
+        struct WorkerScratch
+        {
+            ReuseCandidates candidates;
+            std::vector<CandidateInfo> candidateInfo;
+            std::vector<HostSampleGenerator> generators;
+            std::vector<uint32_t> tilePixels;
+            FrameStats stats;
+        };
+
+        void Resize(uint32_t width, uint32_t height);
+        void ExecuteTile(uint32_t tileIndex, uint32_t workerIndex);
+
+        Reservoir CreateInitialReservoir(uint32_t linearID) const;
+        void TemporalResample(uint32_t x, uint32_t y, HostSampleGenerator& sg, FrameStats& stats);
+        void SpatialResampleTile(const std::vector<uint32_t>& tilePixels, WorkerScratch& scratch);
+
+        bool CompareSimilarity(uint32_t thisID, uint32_t neighborID) const;
+        float GetDepth(uint32_t linearID) const;
+        Vec3 GetNormal(uint32_t linearID) const;
+
+        Reservoir& TemporalReservoir(uint32_t linearID, bool isLastFrame);
+
+        CpuThreadPool& mThreadPool;
+        const ICpuRayCaster& mRayCaster;
+        CpuResampleSettings mSettings;
+
+        uint32_t mWidth = 0;
+        uint32_t mHeight = 0;
+        uint32_t mFrameCount = 0;
+        uint32_t mTemCurOffset = 1;
+        uint32_t mTemLastOffset = 0;
+
+        std::vector<Reservoir> mInitialReservoirs;
+        std::vector<Reservoir> mTemporalReservoirs;     ///< Two slots like temporalReservoirBuffer.
+        std::vector<Reservoir> mSpatialReservoirs;
+        std::vector<WorkerScratch> mScratch;
+
+        const CpuGBuffer* mpGBuffer = nullptr;
+        CpuCameraState mCamera;
+        CpuCameraState mPrevCamera;
+        FrameStats mFrameStats;
+    };
+}
@@ -0,0 +1,169 @@
+#include "CpuResampleKernels.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RESTIR_CPU_SSE2 1
+#else
+#define RESTIR_CPU_SSE2 0
+#endif
+
+namespace ReSTIR
+{
+    namespace
+    {
+        void Push3(ReuseCandidates::Plane3& plane, const Vec3& v)
+        {
+            plane.x.push_back(v.x);
+            plane.y.push_back(v.y);
+            plane.z.push_back(v.z);
+        }
+
+        void Clear3(ReuseCandidates::Plane3& plane)
+        {
+            plane.x.clear();
+            plane.y.clear();
+            plane.z.clear();
+        }
+
+        Vec3 Load3(const ReuseCandidates::Plane3& plane, size_t i)
+        {
+            return Vec3(plane.x[i], plane.y[i], plane.z[i]);
+        }
+
+#if RESTIR_CPU_SSE2
+        struct Lane3
+        {
+            __m128 x, y, z;
+        };
+
+        Lane3 LoadLanes(const ReuseCandidates::Plane3& plane, size_t i)
+        {
+            return { _mm_loadu_ps(&plane.x[i]), _mm_loadu_ps(&plane.y[i]), _mm_loadu_ps(&plane.z[i]) };
+        }
+
+        Lane3 Sub(const Lane3& a, const Lane3& b)
+        {
+            return { _mm_sub_ps(a.x, b.x), _mm_sub_ps(a.y, b.y), _mm_sub_ps(a.z, b.z) };
+        }
+
+        __m128 Dot(const Lane3& a, const Lane3& b)
+        {
+            return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+        }
+
+        /** 1 / sqrt(v) where v > 0, 0 elsewhere. */
+        __m128 SafeInvSqrt(__m128 v)
+        {
+            __m128 positive = _mm_cmpgt_ps(v, _mm_setzero_ps());
+            __m128 inv = _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(_mm_max_ps(v, _mm_set1_ps(1e-30f))));
+            return _mm_and_ps(positive, inv);
+        }
+#endif
+    }
+
+    void ReuseCandidates::Clear()
+    {
+        Clear3(recvPos);
+        Clear3(recvNorm);
+        Clear3(neighborPos);
+        Clear3(neighborNorm);
+        Clear3(samplePos);
+        Clear3(sampleNorm);
+        luminance.clear();
+        targetPdf.clear();
+        accepted.clear();
+    }
+
+    void ReuseCandidates::Push(const Vec3& receiverPos, const Vec3& receiverNorm, const Reservoir& neighbor)
+    {
+        Push3(recvPos, receiverPos);
+        Push3(recvNorm, receiverNorm);
+        Push3(neighborPos, neighbor.z.vPos);
+        Push3(neighborNorm, neighbor.z.vNorm);
+        Push3(samplePos, neighbor.z.sPos);
+        Push3(sampleNorm, neighbor.z.sNorm);
+        luminance.push_back(Luminance(neighbor.z.radiance));
+    }
+
+    void EvaluateReuseCandidate(ReuseCandidates& c, size_t i, float jacobianClamp)
+    {
+        Vec3 recvPos = Load3(c.recvPos, i);
+        Vec3 recvNorm = Load3(c.recvNorm, i);
+        Vec3 samplePos = Load3(c.samplePos, i);
+        Vec3 sampleNorm = Load3(c.sampleNorm, i);
+
+        float targetPdf = c.luminance[i];
+        Vec3 offsetB = samplePos - Load3(c.neighborPos, i);
+        Vec3 offsetA = samplePos - recvPos;
+        // Discard back-face.
+        if (Dot(recvNorm, offsetA) <= 0.f) targetPdf = 0.f;
+
+        float RB2 = Dot(offsetB, offsetB);
+        float RA2 = Dot(offsetA, offsetA);
+        offsetB = Normalize(offsetB);
+        offsetA = Normalize(offsetA);
+        float cosA = Dot(recvNorm, offsetA);
+        float cosB = Dot(Load3(c.neighborNorm, i), offsetB);
+        float cosPhiA = -Dot(offsetA, sampleNorm);
+        float cosPhiB = -Dot(offsetB, sampleNorm);
+
+        c.accepted[i] = cosB > 0.f && cosPhiB > 0.f;
+        if (cosA <= 0.f || cosPhiA <= 0.f || RA2 <= 0.f || RB2 <= 0.f) targetPdf = 0.f;
+
+        float jacobi = RA2 * cosPhiB <= 0.f ? 0.f : std::clamp(RB2 * cosPhiA / (RA2 * cosPhiB), 0.f, jacobianClamp);
+        c.targetPdf[i] = c.accepted[i] ? targetPdf * jacobi : 0.f;
+    }
+
+    void EvaluateReuseCandidates(ReuseCandidates& c, float jacobianClamp)
+    {
+        size_t count = c.GetCount();
+        c.targetPdf.resize(count);
+        c.accepted.resize(count);
+
+        size_t i = 0;
+#if RESTIR_CPU_SSE2
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 clampValue = _mm_set1_ps(jacobianClamp);
+        for (; i + 4 <= count; i += 4)
+        {
+            Lane3 recvPos = LoadLanes(c.recvPos, i);
+            Lane3 recvNorm = LoadLanes(c.recvNorm, i);
+            Lane3 samplePos = LoadLanes(c.samplePos, i);
+            Lane3 sampleNorm = LoadLanes(c.sampleNorm, i);
+            Lane3 neighborNorm = LoadLanes(c.neighborNorm, i);
+
+            Lane3 offsetB = Sub(samplePos, LoadLanes(c.neighborPos, i));
+            Lane3 offsetA = Sub(samplePos, recvPos);
+
+            __m128 RB2 = Dot(offsetB, offsetB);
+            __m128 RA2 = Dot(offsetA, offsetA);
+            __m128 invRA = SafeInvSqrt(RA2);
+            __m128 invRB = SafeInvSqrt(RB2);
+
+            __m128 dotA = Dot(recvNorm, offsetA);
+            __m128 cosA = _mm_mul_ps(dotA, invRA);
+            __m128 cosB = _mm_mul_ps(Dot(neighborNorm, offsetB), invRB);
+            __m128 cosPhiA = _mm_mul_ps(_mm_sub_ps(zero, Dot(offsetA, sampleNorm)), invRA);
+            __m128 cosPhiB = _mm_mul_ps(_mm_sub_ps(zero, Dot(offsetB, sampleNorm)), invRB);
+
+            __m128 accepted = _mm_and_ps(_mm_cmpgt_ps(cosB, zero), _mm_cmpgt_ps(cosPhiB, zero));
+            __m128 valid = _mm_and_ps(_mm_cmpgt_ps(dotA, zero), _mm_and_ps(_mm_cmpgt_ps(cosA, zero), _mm_cmpgt_ps(cosPhiA, zero)));
+            valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpgt_ps(RA2, zero), _mm_cmpgt_ps(RB2, zero)));
+
+            __m128 denom = _mm_mul_ps(RA2, cosPhiB);
+            __m128 denomValid = _mm_cmpgt_ps(denom, zero);
+            __m128 jacobi = _mm_div_ps(_mm_mul_ps(RB2, cosPhiA), _mm_or_ps(_mm_and_ps(denomValid, denom), _mm_andnot_ps(denomValid, _mm_set1_ps(1.f))));
+            jacobi = _mm_min_ps(_mm_max_ps(jacobi, zero), clampValue);
+            jacobi = _mm_and_ps(jacobi, denomValid);
+
+            __m128 targetPdf = _mm_mul_ps(_mm_loadu_ps(&c.luminance[i]), jacobi);
+            targetPdf = _mm_and_ps(targetPdf, _mm_and_ps(valid, accepted));
+            _mm_storeu_ps(&c.targetPdf[i], targetPdf);
+
+            int mask = _mm_movemask_ps(accepted);
+            for (int lane = 0; lane < 4; lane++) c.accepted[i + lane] = (mask >> lane) & 1;
+        }
+#endif
+        for (; i < count; i++) EvaluateReuseCandidate(c, i, jacobianClamp);
+    }
+}
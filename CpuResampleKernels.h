@@ -0,0 +1,43 @@
+#pragma once
+#include "HostReservoir.h"
+#include <vector>
+
+namespace ReSTIR
+{
+    /** Spatial reuse candidates in structure of arrays layout so the shift mapping can be evaluated several lanes at a time.
+        A candidate is a neighbour reservoir whose sample is moved to the receiving pixel.
+    */
+    struct ReuseCandidates
+    {
+        struct Plane3
+        {
+            std::vector<float> x, y, z;
+        };
+
+        Plane3 recvPos;         ///< vPos of the receiving pixel.
+        Plane3 recvNorm;        ///< vNorm of the receiving pixel.
+        Plane3 neighborPos;     ///< vPos of the neighbour.
+        Plane3 neighborNorm;    ///< vNorm of the neighbour.
+        Plane3 samplePos;       ///< sPos of the neighbour sample.
+        Plane3 sampleNorm;      ///< sNorm of the neighbour sample.
+        std::vector<float> luminance;   ///< Target pdf of the neighbour sample before the shift.
+
+        std::vector<float> targetPdf;   ///< Output: shifted target pdf including the Jacobian.
+        std::vector<uint8_t> accepted;  ///< Output: 0 if the neighbour is discarded (back facing at its own visible point).
+
+        size_t GetCount() const { return luminance.size(); }
+
+        void Clear();
+        void Push(const Vec3& receiverPos, const Vec3& receiverNorm, const Reservoir& neighbor);
+    };
+
+    /** Evaluate the shift of all candidates, the vectorized equivalent of the Jacobian
+        computed for every spatial neighbour in SpatialtemporalResample.cs.slang.
+        \param[in] jacobianClamp Upper bound of the Jacobian.
+    */
+    void EvaluateReuseCandidates(ReuseCandidates& candidates, float jacobianClamp);
+
+    /** Scalar version of EvaluateReuseCandidates for a single candidate, used for the remainder lanes.
+    */
+    void EvaluateReuseCandidate(ReuseCandidates& candidates, size_t index, float jacobianClamp);
+}
@@ -0,0 +1,111 @@
+#include "CpuThreadPool.h"
+#include <algorithm>
+
+namespace ReSTIR
+{
+    CpuThreadPool::CpuThreadPool(uint32_t threadCount)
+    {
+        if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+        for (uint32_t i = 0; i < threadCount; i++) mQueues.push_back(std::make_unique<WorkQueue>());
+
+        // Worker 0 is the thread calling ParallelFor.
+        for (uint32_t i = 1; i < threadCount; i++) mThreads.emplace_back(&CpuThreadPool::WorkerLoop, this, i);
+    }
+
+    CpuThreadPool::~CpuThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mWakeMutex);
+            mStop = true;
+        }
+        mWakeCondition.notify_all();
+        for (auto& thread : mThreads) thread.join();
+    }
+
+    void CpuThreadPool::ParallelFor(uint32_t count, const Task& task)
+    {
+        if (count == 0) return;
+
+        std::lock_guard<std::mutex> jobLock(mJobMutex);
+
+        mpTask = &task;
+        mRemaining.store(count);
+
+        // Hand out contiguous ranges so neighbouring items (tiles) start on the same worker.
+        uint32_t workerCount = GetWorkerCount();
+        for (uint32_t w = 0; w < workerCount; w++)
+        {
+            uint32_t begin = (uint32_t)((uint64_t)count * w / workerCount);
+            uint32_t end = (uint32_t)((uint64_t)count * (w + 1) / workerCount);
+            std::lock_guard<std::mutex> lock(mQueues[w]->mutex);
+            for (uint32_t i = begin; i < end; i++) mQueues[w]->items.push_back(i);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mWakeMutex);
+            mGeneration++;
+        }
+        mWakeCondition.notify_all();
+
+        RunTasks(0);
+
+        std::unique_lock<std::mutex> lock(mWakeMutex);
+        mDoneCondition.wait(lock, [this]() { return mRemaining.load() == 0; });
+        mpTask = nullptr;
+    }
+
+    void CpuThreadPool::WorkerLoop(uint32_t workerIndex)
+    {
+        uint64_t seenGeneration = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mWakeMutex);
+                mWakeCondition.wait(lock, [&]() { return mStop || mGeneration != seenGeneration; });
+                if (mStop) return;
+                seenGeneration = mGeneration;
+            }
+            RunTasks(workerIndex);
+        }
+    }
+
+    void CpuThreadPool::RunTasks(uint32_t workerIndex)
+    {
+        uint32_t item;
+        while (Pop(workerIndex, item) || Steal(workerIndex, item))
+        {
+            (*mpTask)(item, workerIndex);
+            if (mRemaining.fetch_sub(1) == 1)
+            {
+                std::lock_guard<std::mutex> lock(mWakeMutex);
+                mDoneCondition.notify_all();
+            }
+        }
+    }
+
+    bool CpuThreadPool::Pop(uint32_t workerIndex, uint32_t& item)
+    {
+        WorkQueue& queue = *mQueues[workerIndex];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.items.empty()) return false;
+        item = queue.items.front();
+        queue.items.pop_front();
+        return true;
+    }
+
+    bool CpuThreadPool::Steal(uint32_t workerIndex, uint32_t& item)
+    {
+        uint32_t workerCount = GetWorkerCount();
+        for (uint32_t i = 1; i < workerCount; i++)
+        {
+            WorkQueue& queue = *mQueues[(workerIndex + i) % workerCount];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.items.empty()) continue;
+            item = queue.items.back();
+            queue.items.pop_back();
+            return true;
+        }
+        return false;
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ReSTIR
+{
+    /** Work stealing thread pool used by the CPU reference engine.
+        Every worker owns a queue, pops work from its front and steals from the back of the other queues when it runs dry.
+        The thread calling ParallelFor takes part in the work as well.
+    */
+    class CpuThreadPool
+    {
+    public:
+        using Task = std::function<void(uint32_t index, uint32_t workerIndex)>;
+
+        /** Create the pool.
+            \param[in] threadCount Number of threads doing work including the caller, 0 uses all hardware threads.
+        */
+        explicit CpuThreadPool(uint32_t threadCount = 0);
+        ~CpuThreadPool();
+
+        CpuThreadPool(const CpuThreadPool&) = delete;
+        CpuThreadPool& operator=(const CpuThreadPool&) = delete;
+
+        /** Number of workers including the calling thread. Valid worker indices are [0, GetWorkerCount()).
+        */
+        uint32_t GetWorkerCount() const { return (uint32_t)mQueues.size(); }
+
+        /** Run task(i, worker) for every i in [0, count) and block until all of them finished.
+            Calls must not be nested.
+        */
+        void ParallelFor(uint32_t count, const Task& task);
+
+    private:
+        struct WorkQueue
+        {
+            std::mutex mutex;
+            std::deque<uint32_t> items;
+        };
+
+        void WorkerLoop(uint32_t workerIndex);
+        void RunTasks(uint32_t workerIndex);
+        bool Pop(uint32_t workerIndex, uint32_t& item);
+        bool Steal(uint32_t workerIndex, uint32_t& item);
+
+        std::vector<std::unique_ptr<WorkQueue>> mQueues;
+        std::vector<std::thread> mThreads;
+
+        std::mutex mJobMutex;
+        std::mutex mWakeMutex;
+        std::condition_variable mWakeCondition;
+        std::condition_variable mDoneCondition;
+        uint64_t mGeneration = 0;
+        bool mStop = false;
+
+        const Task* mpTask = nullptr;
+        std::atomic<uint32_t> mRemaining{ 0 };
+    };
+}
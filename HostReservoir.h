@@ -0,0 +1,136 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+/** Host side mirrors of the reservoir types in GIReservoir.slang.
+    These only depend on the standard library so they can be used by tools running without a GPU.
+    The layouts match the elements of the structured buffers, so buffer contents can be copied as is.
+*/
+namespace ReSTIR
+{
+    struct Vec3
+    {
+        float x = 0.f;
+        float y = 0.f;
+        float z = 0.f;
+
+        Vec3() = default;
+        Vec3(float x_, float y_, float z_) : x(x_), y(y_), z(z_) {}
+        explicit Vec3(float v) : x(v), y(v), z(v) {}
+
+        Vec3 operator+(const Vec3& o) const { return { x + o.x, y + o.y, z + o.z }; }
+        Vec3 operator-(const Vec3& o) const { return { x - o.x, y - o.y, z - o.z }; }
+        Vec3 operator*(const Vec3& o) const { return { x * o.x, y * o.y, z * o.z }; }
+        Vec3 operator*(float s) const { return { x * s, y * s, z * s }; }
+        Vec3 operator/(float s) const { return { x / s, y / s, z / s }; }
+        Vec3 operator-() const { return { -x, -y, -z }; }
+        Vec3& operator+=(const Vec3& o) { x += o.x; y += o.y; z += o.z; return *this; }
+        Vec3& operator*=(float s) { x *= s; y *= s; z *= s; return *this; }
+        bool operator==(const Vec3& o) const { return x == o.x && y == o.y && z == o.z; }
+        bool operator!=(const Vec3& o) const { return !(*this == o); }
+    };
+
+    inline float Dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    inline float Length(const Vec3& v) { return std::sqrt(Dot(v, v)); }
+    inline Vec3 Normalize(const Vec3& v) { float l = Length(v); return l > 0.f ? v / l : Vec3(); }
+    inline bool IsZero(const Vec3& v) { return v.x == 0.f && v.y == 0.f && v.z == 0.f; }
+
+    inline float Luminance(const Vec3& color)
+    {
+        return Dot(color, Vec3(0.299f, 0.587f, 0.114f));
+    }
+
+    /** Small deterministic per pixel random generator (PCG32) standing in for SampleGenerator.
+        It does not reproduce the GPU random sequence, only its role.
+    */
+    class HostSampleGenerator
+    {
+    public:
+        HostSampleGenerator(uint32_t pixelX, uint32_t pixelY, uint32_t frameCount)
+        {
+            mState = 0u;
+            mIncrement = (((uint64_t)pixelY << 32 | pixelX) << 1u) | 1u;
+            Next();
+            mState += 0x853c49e6748fea9bull ^ ((uint64_t)frameCount << 17);
+            Next();
+        }
+
+        uint32_t Next()
+        {
+            uint64_t old = mState;
+            mState = old * 6364136223846793005ull + mIncrement;
+            uint32_t xorShifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+            uint32_t rot = (uint32_t)(old >> 59u);
+            return (xorShifted >> rot) | (xorShifted << ((32u - rot) & 31u));
+        }
+
+        float Next1D() { return (Next() >> 8) * (1.f / 16777216.f); }
+
+    private:
+        uint64_t mState;
+        uint64_t mIncrement;
+    };
+
+    struct RisSample
+    {
+        float sPdf = 0.f;
+        Vec3 vPos;
+        Vec3 vNorm;
+        Vec3 sPos;
+        Vec3 sNorm;
+        Vec3 radiance;
+    };
+
+    struct Reservoir
+    {
+        RisSample z;
+
+        uint32_t M = 0;
+        float weightF = 0.f;
+        int32_t age = 0;
+
+        bool Update(HostSampleGenerator& sg, const RisSample& newSample, float weight, float& weightS)
+        {
+            weightS += weight;
+            M++;
+
+            bool isUpdate = sg.Next1D() * weightS <= weight;
+            if (isUpdate)
+            {
+                z.sPos = newSample.sPos;
+                z.sNorm = newSample.sNorm;
+                z.radiance = newSample.radiance;
+            }
+            return isUpdate;
+        }
+
+        bool Merge(HostSampleGenerator& sg, const Reservoir& r, float pdf, float& weightS)
+        {
+            float weight = r.M * std::max(0.f, r.weightF) * pdf;
+
+            weightS += weight;
+            M += r.M;
+
+            bool isUpdate = sg.Next1D() * weightS <= weight;
+            if (isUpdate)
+            {
+                z.sPos = r.z.sPos;
+                z.sNorm = r.z.sNorm;
+                z.radiance = r.z.radiance;
+                age = r.age;
+            }
+            return isUpdate;
+        }
+
+        void ComputeFinalWeight(float targetPdf, float weightS)
+        {
+            float weight = targetPdf * M;
+            weightF = weight > 0.f ? weightS / weight : 0.f;
+        }
+    };
+
+    static_assert(sizeof(Vec3) == 12, "Vec3 must match the layout of float3");
+    static_assert(sizeof(RisSample) == 64, "RisSample must match the layout in GIReservoir.slang");
+    static_assert(sizeof(Reservoir) == 76, "Reservoir must match the layout in GIReservoir.slang");
+}
@@ -0,0 +1,258 @@
+#include "LightAliasTable.h"
+#include "CpuThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace ReSTIR
+{
+    namespace
+    {
+        constexpr uint32_t kMinChunkSize = 4096;
+
+        /** Fixed point units of one bucket. A scaled weight is at most the item count, so the sums of up to 2^32 items
+            stay below 2^63.
+        */
+        constexpr double kBucketUnits = 2147483648.0;
+        constexpr uint64_t kBucket = 1ull << 31;
+
+        using ChunkTask = std::function<void(uint32_t chunk, uint32_t begin, uint32_t end)>;
+
+        uint32_t GetChunkCount(uint32_t count, CpuThreadPool* pThreadPool)
+        {
+            if (!pThreadPool) return 1;
+            uint32_t chunks = std::min(pThreadPool->GetWorkerCount() * 4, (count + kMinChunkSize - 1) / kMinChunkSize);
+            return std::max(chunks, 1u);
+        }
+
+        void ForEachChunk(uint32_t count, uint32_t chunkCount, CpuThreadPool* pThreadPool, const ChunkTask& task)
+        {
+            auto run = [&](uint32_t chunk, uint32_t)
+            {
+                uint32_t begin = (uint32_t)((uint64_t)count * chunk / chunkCount);
+                uint32_t end = (uint32_t)((uint64_t)count * (chunk + 1) / chunkCount);
+                task(chunk, begin, end);
+            };
+            if (pThreadPool && chunkCount > 1) pThreadPool->ParallelFor(chunkCount, run);
+            else for (uint32_t chunk = 0; chunk < chunkCount; chunk++) run(chunk, 0);
+        }
+
+        /** Inclusive prefix sum of value(i) over [0, count), a sum per chunk first and then the chunks from their offsets.
+            Integer sums, so the result does not depend on the chunks.
+        */
+        void PrefixSum(uint32_t count, CpuThreadPool* pThreadPool, const std::function<uint64_t(uint32_t)>& value, std::vector<uint64_t>& sums)
+        {
+            sums.resize(count);
+            uint32_t chunkCount = GetChunkCount(count, pThreadPool);
+            std::vector<uint64_t> offsets(chunkCount, 0);
+            ForEachChunk(count, chunkCount, pThreadPool, [&](uint32_t chunk, uint32_t begin, uint32_t end)
+            {
+                uint64_t sum = 0;
+                for (uint32_t i = begin; i < end; i++) sum += value(i);
+                offsets[chunk] = sum;
+            });
+
+            uint64_t offset = 0;
+            for (auto& chunkOffset : offsets)
+            {
+                uint64_t sum = chunkOffset;
+                chunkOffset = offset;
+                offset += sum;
+            }
+
+            ForEachChunk(count, chunkCount, pThreadPool, [&](uint32_t chunk, uint32_t begin, uint32_t end)
+            {
+                uint64_t sum = offsets[chunk];
+                for (uint32_t i = begin; i < end; i++) sums[i] = sum += value(i);
+            });
+        }
+
+        float GetCleanWeight(float weight)
+        {
+            return std::isfinite(weight) && weight > 0.f ? weight : 0.f;
+        }
+
+        /** Sum over blocks of kMinChunkSize weights, then over the blocks in order. The blocks do not depend on the pool,
+            so the sum is the same with and without one.
+        */
+        double SumWeights(const std::vector<float>& weights, CpuThreadPool* pThreadPool)
+        {
+            const uint32_t count = (uint32_t)weights.size();
+            const uint32_t blockCount = (count + kMinChunkSize - 1) / kMinChunkSize;
+            std::vector<double> blockSums(blockCount, 0.0);
+            auto sumBlock = [&](uint32_t block, uint32_t)
+            {
+                uint32_t end = std::min(count, (block + 1) * kMinChunkSize);
+                for (uint32_t i = block * kMinChunkSize; i < end; i++) blockSums[block] += GetCleanWeight(weights[i]);
+            };
+            if (pThreadPool && blockCount > 1) pThreadPool->ParallelFor(blockCount, sumBlock);
+            else for (uint32_t block = 0; block < blockCount; block++) sumBlock(block, 0);
+
+            double sum = 0.0;
+            for (double blockSum : blockSums) sum += blockSum;
+            return sum;
+        }
+
+        /** Weight scaled so a bucket holds kBucket. */
+        uint64_t GetScaledWeight(float weight, double scale)
+        {
+            return (uint64_t)std::llround(GetCleanWeight(weight) * scale);
+        }
+
+        float GetThreshold(int64_t units)
+        {
+            return (float)std::clamp((double)units / kBucketUnits, 0.0, 1.0);
+        }
+
+        /** The sequential sweep of Vose's method, what Build computes in parallel.
+        */
+        void BuildSweep(const std::vector<uint64_t>& scaled, std::vector<LightAliasEntry>& entries)
+        {
+            const uint32_t count = (uint32_t)scaled.size();
+            std::vector<uint32_t> lights, heavies;
+            for (uint32_t i = 0; i < count; i++)
+            {
+                (scaled[i] < kBucket ? lights : heavies).push_back(i);
+                entries[i].threshold = 1.f;
+                entries[i].alias = i;
+            }
+            if (heavies.empty())
+            {
+                auto largest = std::max_element(lights.begin(), lights.end(), [&](uint32_t a, uint32_t b) { return scaled[a] < scaled[b]; });
+                heavies.push_back(*largest);
+                lights.erase(largest);
+            }
+
+            size_t h = 0;
+            int64_t remaining = (int64_t)scaled[heavies[0]];
+            for (uint32_t l : lights)
+            {
+                entries[l].threshold = GetThreshold((int64_t)scaled[l]);
+                entries[l].alias = heavies[h];
+                remaining -= (int64_t)(kBucket - scaled[l]);
+                while (remaining < (int64_t)kBucket && h + 1 < heavies.size())
+                {
+                    entries[heavies[h]].threshold = GetThreshold(remaining);
+                    entries[heavies[h]].alias = heavies[h + 1];
+                    remaining = (int64_t)scaled[heavies[h + 1]] - ((int64_t)kBucket - remaining);
+                    h++;
+                }
+            }
+        }
+    }
+
+    bool LightAliasTable::Build(const std::vector<float>& weights, CpuThreadPool* pThreadPool)
+    {
+        Clear();
+
+        const uint32_t count = (uint32_t)weights.size();
+        if (count == 0) return false;
+
+        const double weightSum = SumWeights(weights, pThreadPool);
+        if (weightSum <= 0.0) return false;
+        mWeightSum = weightSum;
+
+        // Scaled weights in fixed point, a bucket holds kBucket.
+        const double scale = count / weightSum * kBucketUnits;
+        std::vector<uint64_t> scaled(count);
+        mEntries.resize(count);
+        uint32_t chunkCount = GetChunkCount(count, pThreadPool);
+        ForEachChunk(count, chunkCount, pThreadPool, [&](uint32_t, uint32_t begin, uint32_t end)
+        {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                scaled[i] = GetScaledWeight(weights[i], scale);
+                mEntries[i].pdf = (float)(GetCleanWeight(weights[i]) / weightSum);
+            }
+        });
+
+        // The prefix sums make about three passes more than the sweep, they only pay off on several workers.
+        if (!pThreadPool || pThreadPool->GetWorkerCount() <= 1)
+        {
+            BuildSweep(scaled, mEntries);
+            return true;
+        }
+
+        // Lights and heavies in index order.
+        std::vector<uint32_t> lightOffsets(chunkCount + 1, 0);
+        ForEachChunk(count, chunkCount, pThreadPool, [&](uint32_t chunk, uint32_t begin, uint32_t end)
+        {
+            uint32_t lights = 0;
+            for (uint32_t i = begin; i < end; i++) lights += scaled[i] < kBucket ? 1 : 0;
+            lightOffsets[chunk + 1] = lights;
+        });
+        for (uint32_t chunk = 0; chunk < chunkCount; chunk++) lightOffsets[chunk + 1] += lightOffsets[chunk];
+
+        const uint32_t lightCount = lightOffsets.back();
+        std::vector<uint32_t> lights(lightCount), heavies(count - lightCount);
+        ForEachChunk(count, chunkCount, pThreadPool, [&](uint32_t chunk, uint32_t begin, uint32_t end)
+        {
+            uint32_t light = lightOffsets[chunk];
+            uint32_t heavy = begin - lightOffsets[chunk];
+            for (uint32_t i = begin; i < end; i++)
+            {
+                if (scaled[i] < kBucket) lights[light++] = i;
+                else heavies[heavy++] = i;
+            }
+        });
+
+        // Rounding can leave every item just below a bucket, the largest one takes the heavy role.
+        if (heavies.empty())
+        {
+            auto largest = std::max_element(lights.begin(), lights.end(), [&](uint32_t a, uint32_t b) { return scaled[a] < scaled[b]; });
+            heavies.push_back(*largest);
+            lights.erase(largest);
+        }
+
+        std::vector<uint64_t> deficits, excesses;
+        PrefixSum((uint32_t)lights.size(), pThreadPool, [&](uint32_t l) { return kBucket - scaled[lights[l]]; }, deficits);
+        PrefixSum((uint32_t)heavies.size(), pThreadPool, [&](uint32_t h) { return scaled[heavies[h]] - kBucket; }, excesses);
+
+        // A light is filled by the first heavy whose excess is not used up by the lights before it.
+        ForEachChunk((uint32_t)lights.size(), GetChunkCount((uint32_t)lights.size(), pThreadPool), pThreadPool, [&](uint32_t, uint32_t begin, uint32_t end)
+        {
+            for (uint32_t l = begin; l < end; l++)
+            {
+                uint64_t deficitBefore = l > 0 ? deficits[l - 1] : 0;
+                size_t h = std::lower_bound(excesses.begin(), excesses.end(), deficitBefore) - excesses.begin();
+                LightAliasEntry& entry = mEntries[lights[l]];
+                entry.threshold = GetThreshold((int64_t)scaled[lights[l]]);
+                entry.alias = heavies[std::min(h, heavies.size() - 1)];
+            }
+        });
+
+        // A heavy turns light after the first light that takes it below a bucket, the next heavy fills the rest of its bucket.
+        ForEachChunk((uint32_t)heavies.size(), GetChunkCount((uint32_t)heavies.size(), pThreadPool), pThreadPool, [&](uint32_t, uint32_t begin, uint32_t end)
+        {
+            for (uint32_t h = begin; h < end; h++)
+            {
+                LightAliasEntry& entry = mEntries[heavies[h]];
+                entry.threshold = 1.f;
+                entry.alias = heavies[h];
+                if (h + 1 == heavies.size()) continue;
+
+                auto turn = std::upper_bound(deficits.begin(), deficits.end(), excesses[h]);
+                if (turn == deficits.end()) continue;
+                entry.threshold = GetThreshold((int64_t)kBucket - (int64_t)(*turn - excesses[h]));
+                entry.alias = heavies[h + 1];
+            }
+        });
+        return true;
+    }
+
+    void LightAliasTable::Clear()
+    {
+        mEntries.clear();
+        mWeightSum = 0.0;
+    }
+
+    uint32_t LightAliasTable::Sample(float u0, float u1, float& pdf) const
+    {
+        uint32_t count = GetCount();
+        uint32_t bucket = std::min((uint32_t)(u0 * count), count - 1);
+        const LightAliasEntry& entry = mEntries[bucket];
+        uint32_t item = u1 < entry.threshold ? bucket : entry.alias;
+        pdf = mEntries[item].pdf;
+        return item;
+    }
+}
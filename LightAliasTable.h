@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace ReSTIR
+{
+    class CpuThreadPool;
+
+    /** One bucket of the table, LightAliasEntry in PathTracer.slang.
+    */
+    struct LightAliasEntry
+    {
+        float threshold = 1.f;          ///< The bucket keeps its own item below this value and returns alias above it.
+        uint32_t alias = 0;
+        float pdf = 0.f;                ///< Probability of the item of this bucket, its weight over the weight sum.
+    };
+    static_assert(sizeof(LightAliasEntry) == 12, "LightAliasEntry must match the shader struct");
+
+    /** Alias table over the analytic lights, weighted by power. Sampling costs one lookup and one comparison.
+
+        Build is a parallel form of the sweep of Vose's method. The weights are scaled so a bucket holds 1, the light
+        items (below 1) and heavy items (1 or above) are listed in index order, and prefix sums are taken over the
+        deficits of the lights and the excesses of the heavies. The sweep hands the lights to the heavies in order,
+        so the heavy filling a light and the point where a heavy turns light follow from the prefix sums by a binary
+        search. Every item is then filled independently of the others. The scaled weights are 31 bit fixed point, so
+        the sums are exact and the table is bit for bit the one of the sequential sweep. Without a pool, or with a
+        single worker, the sequential sweep itself runs, it is about three times faster on one core.
+    */
+    class LightAliasTable
+    {
+    public:
+        /** Build the table.
+            \param[in] weights Non-negative weight per item, negative and non-finite weights count as 0.
+            \param[in] pThreadPool Pool to build on, the calling thread runs the sequential sweep if null.
+            \return False if there are no items or all weights are 0, the table is then empty.
+        */
+        bool Build(const std::vector<float>& weights, CpuThreadPool* pThreadPool = nullptr);
+
+        void Clear();
+
+        /** Pick an item from two uniform numbers in [0, 1), like SampleAnalyticLightTable of the shader.
+        */
+        uint32_t Sample(float u0, float u1, float& pdf) const;
+
+        bool IsEmpty() const { return mEntries.empty(); }
+        uint32_t GetCount() const { return (uint32_t)mEntries.size(); }
+        const std::vector<LightAliasEntry>& GetEntries() const { return mEntries; }
+        double GetWeightSum() const { return mWeightSum; }
+
+    private:
+        std::vector<LightAliasEntry> mEntries;
+        double mWeightSum = 0.0;
+    };
+}
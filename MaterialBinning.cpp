@@ -0,0 +1,131 @@
+#include "MaterialBinning.h"
+#include "CpuThreadPool.h"
+#include <algorithm>
+
+namespace ReSTIR
+{
+    namespace
+    {
+        constexpr uint32_t kMinChunkSize = 16384;
+
+        uint32_t GetBin(uint32_t bin, uint32_t binCount)
+        {
+            return std::min(bin, binCount - 1);
+        }
+
+        uint32_t GetChunkBegin(uint32_t count, uint32_t chunk, uint32_t chunkCount)
+        {
+            return (uint32_t)((uint64_t)count * chunk / chunkCount);
+        }
+    }
+
+    void BuildMaterialBins(const std::vector<uint32_t>& pixelBins, uint32_t binCount, MaterialBins& bins, CpuThreadPool* pThreadPool)
+    {
+        const uint32_t pixelCount = (uint32_t)pixelBins.size();
+        bins.offsets.assign(binCount + 1, 0);
+        bins.pixels.resize(pixelCount);
+        if (binCount == 0)
+        {
+            bins.offsets.assign(1, 0);
+            bins.pixels.clear();
+            return;
+        }
+
+        uint32_t chunkCount = 1;
+        if (pThreadPool) chunkCount = std::max(1u, std::min(pThreadPool->GetWorkerCount() * 4, pixelCount / kMinChunkSize));
+
+        auto forEachChunk = [&](const CpuThreadPool::Task& task)
+        {
+            if (pThreadPool && chunkCount > 1) pThreadPool->ParallelFor(chunkCount, task);
+            else for (uint32_t chunk = 0; chunk < chunkCount; chunk++) task(chunk, 0);
+        };
+
+        // Count, a histogram per chunk.
+        std::vector<uint32_t> chunkCounts((size_t)chunkCount * binCount, 0);
+        forEachChunk([&](uint32_t chunk, uint32_t)
+        {
+            uint32_t* pCounts = chunkCounts.data() + (size_t)chunk * binCount;
+            uint32_t end = GetChunkBegin(pixelCount, chunk + 1, chunkCount);
+            for (uint32_t i = GetChunkBegin(pixelCount, chunk, chunkCount); i < end; i++) pCounts[GetBin(pixelBins[i], binCount)]++;
+        });
+
+        // Exclusive prefix sum over the bins, a chunk starts behind the earlier chunks in every bin.
+        uint32_t offset = 0;
+        for (uint32_t bin = 0; bin < binCount; bin++)
+        {
+            bins.offsets[bin] = offset;
+            for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+            {
+                uint32_t& count = chunkCounts[(size_t)chunk * binCount + bin];
+                uint32_t chunkOffset = offset;
+                offset += count;
+                count = chunkOffset;
+            }
+        }
+        bins.offsets[binCount] = offset;
+
+        // Scatter in pixel order.
+        forEachChunk([&](uint32_t chunk, uint32_t)
+        {
+            uint32_t* pOffsets = chunkCounts.data() + (size_t)chunk * binCount;
+            uint32_t end = GetChunkBegin(pixelCount, chunk + 1, chunkCount);
+            for (uint32_t i = GetChunkBegin(pixelCount, chunk, chunkCount); i < end; i++) bins.pixels[pOffsets[GetBin(pixelBins[i], binCount)]++] = i;
+        });
+    }
+
+    void BuildMaterialBinsNaive(const std::vector<uint32_t>& pixelBins, uint32_t binCount, MaterialBins& bins)
+    {
+        bins.offsets.clear();
+        bins.pixels.clear();
+        for (uint32_t bin = 0; bin < binCount; bin++)
+        {
+            bins.offsets.push_back((uint32_t)bins.pixels.size());
+            for (uint32_t i = 0; i < (uint32_t)pixelBins.size(); i++)
+            {
+                if (GetBin(pixelBins[i], binCount) == bin) bins.pixels.push_back(i);
+            }
+        }
+        bins.offsets.push_back((uint32_t)bins.pixels.size());
+    }
+
+    bool ValidateMaterialBins(const std::vector<uint32_t>& pixelBins, uint32_t binCount, const MaterialBins& bins)
+    {
+        const uint32_t pixelCount = (uint32_t)pixelBins.size();
+        if (bins.offsets.size() != (size_t)binCount + 1 || bins.pixels.size() != pixelCount) return false;
+        if (binCount == 0) return pixelCount == 0;
+        if (bins.offsets.front() != 0 || bins.offsets.back() != pixelCount) return false;
+
+        std::vector<bool> seen(pixelCount, false);
+        for (uint32_t bin = 0; bin < binCount; bin++)
+        {
+            if (bins.offsets[bin] > bins.offsets[bin + 1]) return false;
+            for (uint32_t i = bins.offsets[bin]; i < bins.offsets[bin + 1]; i++)
+            {
+                uint32_t pixel = bins.pixels[i];
+                if (pixel >= pixelCount || seen[pixel] || GetBin(pixelBins[pixel], binCount) != bin) return false;
+                seen[pixel] = true;
+            }
+        }
+        return true;
+    }
+
+    double GetAverageBinsPerWave(const std::vector<uint32_t>& pixelBins, const std::vector<uint32_t>& order, uint32_t waveSize)
+    {
+        const uint32_t threadCount = (uint32_t)(order.empty() ? pixelBins.size() : order.size());
+        if (threadCount == 0 || waveSize == 0) return 0.0;
+
+        std::vector<uint32_t> waveBins;
+        uint64_t binSum = 0;
+        uint32_t waveCount = 0;
+        for (uint32_t begin = 0; begin < threadCount; begin += waveSize)
+        {
+            waveBins.clear();
+            uint32_t end = std::min(begin + waveSize, threadCount);
+            for (uint32_t thread = begin; thread < end; thread++) waveBins.push_back(pixelBins[order.empty() ? thread : order[thread]]);
+            std::sort(waveBins.begin(), waveBins.end());
+            binSum += std::unique(waveBins.begin(), waveBins.end()) - waveBins.begin();
+            waveCount++;
+        }
+        return (double)binSum / waveCount;
+    }
+}
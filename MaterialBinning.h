@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace ReSTIR
+{
+    class CpuThreadPool;
+
+    /** Pixels sorted by material, the CPU form of MaterialBinning.cs.slang.
+    */
+    struct MaterialBins
+    {
+        std::vector<uint32_t> offsets;      ///< First sorted index per bin and the pixel count at the end, binCount + 1 entries.
+        std::vector<uint32_t> pixels;       ///< Pixel indices sorted by bin, in pixel order inside a bin.
+
+        uint32_t GetBinCount() const { return offsets.empty() ? 0 : (uint32_t)offsets.size() - 1; }
+        uint32_t GetBinSize(uint32_t bin) const { return offsets[bin + 1] - offsets[bin]; }
+    };
+
+    /** Bin the pixels by count, exclusive prefix sum and scatter, the passes of the shader.
+        The pool splits the pixels into chunks that count and scatter on their own, chunk offsets keep the pixel
+        order inside a bin, so the result does not depend on the pool. The GPU orders a bin by its atomics instead.
+        \param[in] pixelBins Bin per pixel, bins at or above binCount go to the last bin like pixels without a surface.
+        \param[in] binCount Number of bins, the materials of the scene + 1.
+    */
+    void BuildMaterialBins(const std::vector<uint32_t>& pixelBins, uint32_t binCount, MaterialBins& bins, CpuThreadPool* pThreadPool = nullptr);
+
+    /** Reference, one loop over all pixels per bin.
+    */
+    void BuildMaterialBinsNaive(const std::vector<uint32_t>& pixelBins, uint32_t binCount, MaterialBins& bins);
+
+    /** Check bins against the pixels: every pixel once, in the bin of its material, and the offsets add up.
+        Holds for the unstable GPU order as well.
+    */
+    bool ValidateMaterialBins(const std::vector<uint32_t>& pixelBins, uint32_t binCount, const MaterialBins& bins);
+
+    /** Average number of different bins in a wave of waveSize consecutive threads.
+        \param[in] order Pixel index per thread, the pixel order if empty.
+    */
+    double GetAverageBinsPerWave(const std::vector<uint32_t>& pixelBins, const std::vector<uint32_t>& order, uint32_t waveSize);
+}
@@ -0,0 +1,177 @@
+#include "RadianceCache.h"
+#include "SpatialAccessModel.h"
+
+namespace ReSTIR
+{
+    namespace
+    {
+        constexpr uint32_t kMaxLevel = 31;
+        constexpr uint32_t kChecksumSeed = 0x9e3779b9u;
+
+        uint32_t HashCell(int32_t x, int32_t y, int32_t z, uint32_t levelAndAxis, uint32_t seed)
+        {
+            uint32_t h = JenkinsHash(levelAndAxis ^ seed);
+            h = JenkinsHash(h ^ (uint32_t)x);
+            h = JenkinsHash(h ^ (uint32_t)y);
+            return JenkinsHash(h ^ (uint32_t)z);
+        }
+
+        uint32_t GetDominantAxis(const Vec3& n)
+        {
+            float ax = std::abs(n.x), ay = std::abs(n.y), az = std::abs(n.z);
+            uint32_t axis = ax >= ay && ax >= az ? 0 : (ay >= az ? 1 : 2);
+            float component = axis == 0 ? n.x : (axis == 1 ? n.y : n.z);
+            return axis * 2 + (component < 0.f ? 1 : 0);
+        }
+
+        uint32_t RoundUpToPowerOfTwo(uint32_t value)
+        {
+            uint32_t result = 1;
+            while (result < value) result <<= 1;
+            return result;
+        }
+    }
+
+    RadianceCache::RadianceCache(const RadianceCacheSettings& settings)
+        : mSettings(settings)
+    {
+        mSettings.capacity = RoundUpToPowerOfTwo(std::max(settings.capacity, kProbeCount));
+        mChecksums = std::vector<std::atomic<uint32_t>>(mSettings.capacity);
+        mAccumulation = std::vector<std::atomic<uint32_t>>(4 * (size_t)mSettings.capacity);
+        mResolved.resize(mSettings.capacity);
+        mAges.resize(mSettings.capacity);
+        Clear();
+    }
+
+    RadianceCacheKey RadianceCache::ComputeKey(const Vec3& pos, const Vec3& normal, const Vec3& cameraPos) const
+    {
+        float distance = Length(pos - cameraPos);
+        uint32_t level = std::min((uint32_t)std::floor(std::log2(std::max(distance, 1.f))), kMaxLevel);
+        float cellSize = mSettings.cellSize * std::exp2((float)level);
+
+        int32_t x = (int32_t)std::floor(pos.x / cellSize);
+        int32_t y = (int32_t)std::floor(pos.y / cellSize);
+        int32_t z = (int32_t)std::floor(pos.z / cellSize);
+        uint32_t levelAndAxis = level | (GetDominantAxis(normal) << 8);
+
+        RadianceCacheKey key;
+        key.slot = HashCell(x, y, z, levelAndAxis, 0) & (mSettings.capacity - 1);
+        key.checksum = std::max(HashCell(x, y, z, levelAndAxis, kChecksumSeed), 1u);
+        return key;
+    }
+
+    uint32_t RadianceCache::Find(const RadianceCacheKey& key) const
+    {
+        // Evicted entries leave holes, so the whole probe window is searched.
+        for (uint32_t i = 0; i < kProbeCount; i++)
+        {
+            uint32_t entry = (key.slot + i) & (mSettings.capacity - 1);
+            if (mChecksums[entry].load(std::memory_order_acquire) == key.checksum) return entry;
+        }
+        return kInvalidEntry;
+    }
+
+    uint32_t RadianceCache::Insert(const RadianceCacheKey& key)
+    {
+        uint32_t entry = Find(key);
+        if (entry != kInvalidEntry) return entry;
+
+        // Entries are only released by Resolve, so a slot the probe passes stays taken by another cell. Two threads inserting
+        // the same cell stop at the same first free slot, one claims it and the other sees its checksum there.
+        for (uint32_t i = 0; i < kProbeCount; i++)
+        {
+            entry = (key.slot + i) & (mSettings.capacity - 1);
+            uint32_t previous = 0;
+            if (mChecksums[entry].compare_exchange_strong(previous, key.checksum, std::memory_order_acq_rel) || previous == key.checksum) return entry;
+        }
+        return kInvalidEntry;
+    }
+
+    bool RadianceCache::Accumulate(const Vec3& pos, const Vec3& normal, const Vec3& cameraPos, const Vec3& radiance)
+    {
+        if (!std::isfinite(radiance.x) || !std::isfinite(radiance.y) || !std::isfinite(radiance.z)) return false;
+
+        uint32_t entry = Insert(ComputeKey(pos, normal, cameraPos));
+        if (entry == kInvalidEntry)
+        {
+            mDroppedUpdates.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        auto toFixed = [](float v) { return (uint32_t)(std::clamp(v, 0.f, kMaxRadiance) * kFixedPointScale + 0.5f); };
+        std::atomic<uint32_t>* sums = &mAccumulation[4 * (size_t)entry];
+        sums[0].fetch_add(toFixed(radiance.x), std::memory_order_relaxed);
+        sums[1].fetch_add(toFixed(radiance.y), std::memory_order_relaxed);
+        sums[2].fetch_add(toFixed(radiance.z), std::memory_order_relaxed);
+        sums[3].fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool RadianceCache::Lookup(const Vec3& pos, const Vec3& normal, const Vec3& cameraPos, Vec3& radiance) const
+    {
+        radiance = Vec3();
+        uint32_t entry = Find(ComputeKey(pos, normal, cameraPos));
+        if (entry == kInvalidEntry) return false;
+
+        const ResolvedEntry& resolved = mResolved[entry];
+        if (resolved.count < (float)mSettings.minSamples) return false;
+
+        radiance = resolved.radiance;
+        return true;
+    }
+
+    uint32_t RadianceCache::Resolve()
+    {
+        uint32_t evictions = 0;
+        for (uint32_t entry = 0; entry < mSettings.capacity; entry++)
+        {
+            if (mChecksums[entry].load(std::memory_order_relaxed) == 0) continue;
+
+            std::atomic<uint32_t>* sums = &mAccumulation[4 * (size_t)entry];
+            uint32_t count = sums[3].load(std::memory_order_relaxed);
+            if (count > 0)
+            {
+                float scale = 1.f / (kFixedPointScale * count);
+                Vec3 mean((float)sums[0].load(std::memory_order_relaxed) * scale, (float)sums[1].load(std::memory_order_relaxed) * scale, (float)sums[2].load(std::memory_order_relaxed) * scale);
+
+                // Running mean up to maxSamples, a moving average after that.
+                ResolvedEntry& resolved = mResolved[entry];
+                float sampleCount = resolved.count + count;
+                float t = count / sampleCount;
+                resolved.radiance = resolved.radiance * (1.f - t) + mean * t;
+                resolved.count = std::min(sampleCount, (float)mSettings.maxSamples);
+                mAges[entry] = 0;
+
+                for (uint32_t i = 0; i < 4; i++) sums[i].store(0, std::memory_order_relaxed);
+                continue;
+            }
+
+            uint32_t age = mAges[entry] + 1;
+            if (age > mSettings.maxAge)
+            {
+                mResolved[entry] = ResolvedEntry();
+                age = 0;
+                mChecksums[entry].store(0, std::memory_order_relaxed);
+                evictions++;
+            }
+            mAges[entry] = age;
+        }
+        return evictions;
+    }
+
+    void RadianceCache::Clear()
+    {
+        for (auto& checksum : mChecksums) checksum.store(0, std::memory_order_relaxed);
+        for (auto& sum : mAccumulation) sum.store(0, std::memory_order_relaxed);
+        std::fill(mResolved.begin(), mResolved.end(), ResolvedEntry());
+        std::fill(mAges.begin(), mAges.end(), 0u);
+        mDroppedUpdates.store(0, std::memory_order_relaxed);
+    }
+
+    uint32_t RadianceCache::GetEntryCount() const
+    {
+        uint32_t count = 0;
+        for (const auto& checksum : mChecksums) count += checksum.load(std::memory_order_relaxed) != 0 ? 1 : 0;
+        return count;
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "HostReservoir.h"
+#include <atomic>
+#include <vector>
+
+namespace ReSTIR
+{
+    /** Mirrors the cache fields of RenderingRuntimeParams.
+    */
+    struct RadianceCacheSettings
+    {
+        uint32_t capacity = 1u << 20;   ///< Entries, rounded up to a power of two.
+        float cellSize = 0.02f;         ///< Cell size at distance 1 from the camera, doubles with every power of two of the distance.
+        uint32_t minSamples = 8;        ///< A cell answers lookups once it holds this many samples.
+        uint32_t maxSamples = 256;      ///< Past this the running mean of a cell turns into a moving average.
+        uint32_t maxAge = 32;           ///< Cells not updated for this many resolves are evicted.
+    };
+
+    struct RadianceCacheKey
+    {
+        uint32_t slot = 0;              ///< First entry probed.
+        uint32_t checksum = 0;          ///< Second hash of the cell, never 0.
+    };
+
+    /** CPU version of the world space radiance cache in RadianceCache.slang, same keys, probing and resolve.
+
+        Accumulate and Lookup may be called from any number of threads at once. Entries are claimed with a
+        compare-exchange on the checksum and the radiance is summed in fixed point with atomic adds, like the
+        shader does with InterlockedCompareExchange and InterlockedAdd. Resolve must not overlap with them,
+        on the GPU it is a separate dispatch.
+    */
+    class RadianceCache
+    {
+    public:
+        static constexpr uint32_t kProbeCount = 8;              ///< kRadianceCacheProbeCount.
+        static constexpr float kFixedPointScale = 256.f;        ///< kRadianceCacheFixedPointScale.
+        static constexpr float kMaxRadiance = 1024.f;           ///< kRadianceCacheMaxRadiance.
+        static constexpr uint32_t kInvalidEntry = 0xffffffffu;
+
+        explicit RadianceCache(const RadianceCacheSettings& settings = {});
+
+        const RadianceCacheSettings& GetSettings() const { return mSettings; }
+        uint32_t GetCapacity() const { return mSettings.capacity; }
+
+        RadianceCacheKey ComputeKey(const Vec3& pos, const Vec3& normal, const Vec3& cameraPos) const;
+
+        /** Entry holding the cell, kInvalidEntry if there is none in the probe window. */
+        uint32_t Find(const RadianceCacheKey& key) const;
+
+        /** Entry holding the cell, claiming a free one if needed. kInvalidEntry if the probe window is full.
+        */
+        uint32_t Insert(const RadianceCacheKey& key);
+
+        /** Add one radiance sample to the cell. Returns false if the update was dropped.
+        */
+        bool Accumulate(const Vec3& pos, const Vec3& normal, const Vec3& cameraPos, const Vec3& radiance);
+
+        /** Radiance resolved up to the last Resolve, false if the cell is missing or has fewer than minSamples samples.
+        */
+        bool Lookup(const Vec3& pos, const Vec3& normal, const Vec3& cameraPos, Vec3& radiance) const;
+
+        /** Fold the sums since the last call into the resolved radiance and evict cells by age.
+            \return Number of evicted cells.
+        */
+        uint32_t Resolve();
+
+        void Clear();
+
+        uint32_t GetEntryCount() const;                 ///< Claimed entries.
+        float GetSampleCount(uint32_t entry) const { return mResolved[entry].count; }
+        uint32_t GetAge(uint32_t entry) const { return mAges[entry]; }
+        uint64_t GetDroppedUpdateCount() const { return mDroppedUpdates.load(std::memory_order_relaxed); }
+
+    private:
+        struct ResolvedEntry
+        {
+            Vec3 radiance;
+            float count = 0.f;
+        };
+
+        RadianceCacheSettings mSettings;
+        std::vector<std::atomic<uint32_t>> mChecksums;
+        std::vector<std::atomic<uint32_t>> mAccumulation;   ///< r, g, b and count per entry.
+        std::vector<ResolvedEntry> mResolved;
+        std::vector<uint32_t> mAges;
+        std::atomic<uint64_t> mDroppedUpdates{ 0 };
+    };
+}
@@ -0,0 +1,267 @@
+/** Command line front end of the host-only parts of ReSTIRPass, built by CMakeLists.txt without Falcor or a GPU.
+
+    ReSTIRCpuTool run <gbufferDir> [--frames N] [--threads N] [--camera file] [--output dir]
+        Run CpuReSTIREngine on a G-buffer stored as PFM planes, see CpuGBuffer.h.
+
+    ReSTIRCpuTool capture <file.rstc> [--verify] [--frames N] [--threads N] [--output dir]
+        Print the reservoir statistics of a capture as JSON, optionally run CpuReSTIREngine on its G-buffer.
+
+    ReSTIRCpuTool alias-table <lightCount> [--threads N] [--repeat N]
+        Time the LightAliasTable build on random light powers, the sequential sweep against the pool.
+*/
+#include "CpuReSTIREngine.h"
+#include "LightAliasTable.h"
+#include "ReservoirCapture.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+using namespace ReSTIR;
+
+namespace
+{
+    void PrintUsage()
+    {
+        std::printf(
+            "usage:\n"
+            "  ReSTIRCpuTool run <gbufferDir> [--frames N] [--threads N] [--camera file] [--output dir]\n"
+            "      Run the CPU engine on the PFM planes of gbufferDir (vPosW, vNormW, sPosW, sNormW, sColor, random).\n"
+            "      --camera  text file with posW (3 floats) and the column major viewProj (16 floats) of the frame.\n"
+            "                Without it the history cannot be reprojected and temporal reuse is turned off.\n"
+            "      --output  writes radiance.pfm (sample radiance times weight) and M.pfm of the spatial reservoirs.\n"
+            "  ReSTIRCpuTool capture <file.rstc> [--verify] [--frames N] [--threads N] [--output dir]\n"
+            "      Print the header and the statistics of every reservoir section of a capture as JSON.\n"
+            "      --verify  also check the section checksums.\n"
+            "      --frames  run the CPU engine N frames on the G-buffer of the capture, which needs sample channels.\n"
+            "                The camera of the capture is used, statistics go to stderr so stdout stays JSON.\n"
+            "  ReSTIRCpuTool alias-table <lightCount> [--threads N] [--repeat N]\n"
+            "      Time the light alias table build on random powers spanning 5 decades, without and with a pool of N threads.\n");
+    }
+
+    bool ReadCamera(const std::string& path, CpuCameraState& camera)
+    {
+        std::ifstream file(path);
+        if (!(file >> camera.posW.x >> camera.posW.y >> camera.posW.z)) return false;
+        for (float& v : camera.viewProj)
+        {
+            if (!(file >> v)) return false;
+        }
+        return true;
+    }
+
+    void WriteSpatialReservoirs(const CpuReSTIREngine& engine, const std::string& directory)
+    {
+        const auto& reservoirs = engine.GetSpatialReservoirs();
+        std::vector<float> radiance(reservoirs.size() * 3);
+        std::vector<float> m(reservoirs.size());
+        for (size_t i = 0; i < reservoirs.size(); i++)
+        {
+            Vec3 value = reservoirs[i].z.radiance * std::max(0.f, reservoirs[i].weightF);
+            radiance[3 * i + 0] = value.x;
+            radiance[3 * i + 1] = value.y;
+            radiance[3 * i + 2] = value.z;
+            m[i] = (float)reservoirs[i].M;
+        }
+        if (!WritePfm(directory + "/radiance.pfm", engine.GetWidth(), engine.GetHeight(), 3, radiance.data()) ||
+            !WritePfm(directory + "/M.pfm", engine.GetWidth(), engine.GetHeight(), 1, m.data()))
+        {
+            throw std::runtime_error("Failed to write the reservoirs to '" + directory + "'");
+        }
+    }
+
+    void RunEngine(const CpuGBuffer& gbuffer, const CpuCameraState& camera, const CpuResampleSettings& settings, uint32_t frameCount, uint32_t threadCount,
+        const std::string& outputDir, FILE* log)
+    {
+        CpuThreadPool threadPool(threadCount);
+        UnoccludedRayCaster rayCaster;
+        CpuReSTIREngine engine(threadPool, rayCaster);
+        engine.SetSettings(settings);
+
+        std::fprintf(log, "%ux%u, %u threads\n", gbuffer.width, gbuffer.height, threadPool.GetWorkerCount());
+        std::fprintf(log, "frame, ms, neighborsTested, neighborsMerged, visibilityRays, temporalResets\n");
+        for (uint32_t frame = 0; frame < frameCount; frame++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            engine.ExecuteFrame(gbuffer, camera);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            const auto& stats = engine.GetFrameStats();
+            std::fprintf(log, "%u, %.3f, %llu, %llu, %llu, %llu\n", frame, ms, (unsigned long long)stats.neighborsTested, (unsigned long long)stats.neighborsMerged,
+                (unsigned long long)stats.visibilityRays, (unsigned long long)stats.temporalResets);
+        }
+
+        if (!outputDir.empty()) WriteSpatialReservoirs(engine, outputDir);
+    }
+
+    int Run(int argc, char** argv)
+    {
+        if (argc < 1) return PrintUsage(), 1;
+        std::string gbufferDir = argv[0];
+        std::string cameraPath;
+        std::string outputDir;
+        uint32_t frameCount = 1;
+        uint32_t threadCount = 0;
+        for (int i = 1; i + 1 < argc; i += 2)
+        {
+            if (!std::strcmp(argv[i], "--frames")) frameCount = (uint32_t)std::stoul(argv[i + 1]);
+            else if (!std::strcmp(argv[i], "--threads")) threadCount = (uint32_t)std::stoul(argv[i + 1]);
+            else if (!std::strcmp(argv[i], "--camera")) cameraPath = argv[i + 1];
+            else if (!std::strcmp(argv[i], "--output")) outputDir = argv[i + 1];
+            else return PrintUsage(), 1;
+        }
+        if (argc % 2 == 0) return PrintUsage(), 1;
+
+        CpuGBuffer gbuffer = CpuGBuffer::LoadFromDirectory(gbufferDir);
+
+        CpuResampleSettings settings;
+        CpuCameraState camera;
+        if (!cameraPath.empty())
+        {
+            if (!ReadCamera(cameraPath, camera)) throw std::runtime_error("Failed to read the camera '" + cameraPath + "'");
+        }
+        else settings.temporalMaxM = 0;
+
+        RunEngine(gbuffer, camera, settings, frameCount, threadCount, outputDir, stdout);
+        return 0;
+    }
+
+    int Capture(int argc, char** argv)
+    {
+        if (argc < 1) return PrintUsage(), 1;
+        std::string capturePath = argv[0];
+        std::string outputDir;
+        bool verify = false;
+        uint32_t frameCount = 0;
+        uint32_t threadCount = 0;
+        for (int i = 1; i < argc; i++)
+        {
+            if (!std::strcmp(argv[i], "--verify")) verify = true;
+            else if (i + 1 == argc) return PrintUsage(), 1;
+            else if (!std::strcmp(argv[i], "--frames")) frameCount = (uint32_t)std::stoul(argv[++i]);
+            else if (!std::strcmp(argv[i], "--threads")) threadCount = (uint32_t)std::stoul(argv[++i]);
+            else if (!std::strcmp(argv[i], "--output")) outputDir = argv[++i];
+            else return PrintUsage(), 1;
+        }
+
+        ReservoirCaptureReader reader;
+        if (!reader.Open(capturePath, verify)) throw std::runtime_error(reader.GetError());
+
+        const CaptureFileHeader& header = reader.GetHeader();
+        std::printf("{\n  \"frame\": %llu, \"width\": %u, \"height\": %u, \"flags\": %u, \"temporalSlots\": %u,\n  \"sections\": [",
+            (unsigned long long)header.frameIndex, header.width, header.height, header.flags, header.temporalSlotCount);
+        for (uint32_t i = 0; i < reader.GetSectionCount(); i++)
+        {
+            const CaptureSectionEntry& entry = reader.GetSections()[i];
+            std::printf("%s\n    { \"name\": \"%s\", \"type\": \"%s\", \"size\": %llu }", i ? "," : "", entry.name,
+                GetCaptureSectionTypeName((CaptureSectionType)entry.type), (unsigned long long)entry.size);
+        }
+        std::printf("\n  ]");
+
+        for (CaptureSectionType type : { CaptureSectionType::InitialReservoirs, CaptureSectionType::SpatialReservoirs })
+        {
+            size_t count = 0;
+            const Reservoir* reservoirs = reader.GetReservoirs(type, count);
+            if (reservoirs) std::printf(",\n  \"%s\": %s", GetCaptureSectionTypeName(type), ComputeReservoirStats(reservoirs, count).ToJson().c_str());
+        }
+        // The history the frame read and the slot it wrote, see CaptureFileHeader.
+        if (const Reservoir* history = reader.GetTemporalSlot(header.temLastOffset))
+        {
+            std::printf(",\n  \"temporalHistory\": %s", ComputeReservoirStats(history, reader.GetPixelCount()).ToJson().c_str());
+        }
+        if (const Reservoir* current = reader.GetTemporalSlot(header.temCurOffset))
+        {
+            std::printf(",\n  \"temporalCurrent\": %s", ComputeReservoirStats(current, reader.GetPixelCount()).ToJson().c_str());
+        }
+        std::printf("\n}\n");
+
+        if (frameCount == 0) return 0;
+
+        CpuGBuffer gbuffer;
+        if (!reader.LoadGBuffer(gbuffer)) throw std::runtime_error(capturePath + ": no sample channels, captures with fused initial sampling cannot be run");
+
+        CpuResampleSettings settings;
+        CpuCameraState camera;
+        if (const CaptureSectionEntry* pEntry = reader.FindSection(CaptureSectionType::Camera))
+        {
+            const CaptureCamera& captured = *static_cast<const CaptureCamera*>(reader.GetSectionData(*pEntry));
+            camera.posW = Vec3(captured.position[0], captured.position[1], captured.position[2]);
+            std::copy(std::begin(captured.viewProj), std::end(captured.viewProj), camera.viewProj);
+        }
+        else settings.temporalMaxM = 0;
+
+        RunEngine(gbuffer, camera, settings, frameCount, threadCount, outputDir, stderr);
+        return 0;
+    }
+
+
+    int AliasTable(int argc, char** argv)
+    {
+        if (argc < 1 || argc % 2 == 0) return PrintUsage(), 1;
+        const uint32_t lightCount = (uint32_t)std::stoul(argv[0]);
+        uint32_t threadCount = 0;
+        uint32_t repeatCount = 5;
+        for (int i = 1; i + 1 < argc; i += 2)
+        {
+            if (!std::strcmp(argv[i], "--threads")) threadCount = (uint32_t)std::stoul(argv[i + 1]);
+            else if (!std::strcmp(argv[i], "--repeat")) repeatCount = std::max(1u, (uint32_t)std::stoul(argv[i + 1]));
+            else return PrintUsage(), 1;
+        }
+
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> exponent(-6.f, 6.f);
+        std::vector<float> weights(lightCount);
+        for (auto& w : weights) w = std::exp(exponent(rng));
+
+        CpuThreadPool threadPool(threadCount);
+        LightAliasTable serial, pooled;
+        auto measureMs = [&](LightAliasTable& table, CpuThreadPool* pThreadPool)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < repeatCount; i++) table.Build(weights, pThreadPool);
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeatCount;
+        };
+        double serialMs = measureMs(serial, nullptr);
+        double pooledMs = measureMs(pooled, &threadPool);
+
+        bool identical = serial.GetCount() == pooled.GetCount();
+        for (uint32_t i = 0; identical && i < serial.GetCount(); i++)
+        {
+            const LightAliasEntry& a = serial.GetEntries()[i];
+            const LightAliasEntry& b = pooled.GetEntries()[i];
+            identical = a.alias == b.alias && a.threshold == b.threshold && a.pdf == b.pdf;
+        }
+        std::printf("%u lights: sweep %.3f ms, %u workers %.3f ms, tables %s\n", lightCount, serialMs, threadPool.GetWorkerCount(), pooledMs,
+            identical ? "identical" : "differ");
+        return identical ? 0 : 1;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    try
+    {
+        if (!std::strcmp(argv[1], "run")) return Run(argc - 2, argv + 2);
+        if (!std::strcmp(argv[1], "capture")) return Capture(argc - 2, argv + 2);
+        if (!std::strcmp(argv[1], "alias-table")) return AliasTable(argc - 2, argv + 2);
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    PrintUsage();
+    return 1;
+}
@@ -26,6 +26,7 @@
  # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  **************************************************************************/
 #include "ReSTIRPass.h"
+#include "HostReservoir.h"
 
 const RenderPass::Info ReSTIRPass::kInfo{ "ReSTIRPass", "Insert pass description here." };
 
@@ -44,11 +45,19 @@ namespace
 {
     const std::string kShaderModel = "6_5";
 
+    // Part of every permutation key. The shaders of this pass are hashed, bump this when Falcor or Slang is updated.
+    const char kShaderToolchain[] = "Falcor 5.2";
+    const char kShaderCompileLogFile[] = "ReSTIRPassShaderCompiles.log";
+
     const std::string kReflectTypesPath = "RenderPasses/ReSTIRPass/ReflectTypes.cs.slang";
     const std::string kSampleInitialPassPath = "RenderPasses/ReSTIRPass/InitialSampleBuffer.rt.slang";
     const std::string kSpatialTemporalResamplePassPath = "RenderPasses/ReSTIRPass/SpatialtemporalResample.cs.slang";
     const std::string kFinalShadingPassPath = "RenderPasses/ReSTIRPass/FinalShading.rt.slang";
     const std::string kInitialResrvoirPassPath = "RenderPasses/ReSTIRPass/initialReservoir.cs.slang";
+    const std::string kReservoirResizePassPath = "RenderPasses/ReSTIRPass/ReservoirResize.cs.slang";
+    const std::string kReservoirConfidencePassPath = "RenderPasses/ReSTIRPass/ReservoirConfidence.cs.slang";
+    const std::string kRadianceCacheResolvePassPath = "RenderPasses/ReSTIRPass/RadianceCacheResolve.cs.slang";
+    const std::string kMaterialBinningPassPath = "RenderPasses/ReSTIRPass/MaterialBinning.cs.slang";
 
     const std::string kInputVBuffer = "vbuffer";
     const std::string kInputeMotionVec = "mvec";
@@ -68,12 +77,17 @@ namespace
         {kInputeMotionVec,"mvec","input vbuffer used for temporal resample",true},
         {kInputDepthBuffer,"depth","input depthbuffer used for similarity",true,ResourceFormat::R32Float},
         {kInputNormBuffer,"norm","input normalbuffer used for similarity",true,},
-        {kInputvPos,  "gVPosW",   "Visible point",                                false},
-        {kInputvNorm, "gVNormW",  "Visible surface normal",                       false},
-        {kInputsPos,  "gSPosW",   "Sample point",                                 false},
-        {kInputsNorm, "gSNormW",  "Sample surface normal",                        false},
-        {kInputsColor, "gSColor",  "Outgoing radiance at sample point in RGBA",    false},
-        {kInputPdf, "gPdf",     "Random numbers used for path",                 false},
+    };
+
+    // Initial samples. Inputs from an external pass, or optional debug outputs when initial sampling is fused into this pass.
+    ChannelList SampleChannel
+    {
+        {kInputvPos,  "gVPosW",   "Visible point",                                false, ResourceFormat::RGBA32Float},
+        {kInputvNorm, "gVNormW",  "Visible surface normal",                       false, ResourceFormat::RGBA32Float},
+        {kInputsPos,  "gSPosW",   "Sample point",                                 false, ResourceFormat::RGBA32Float},
+        {kInputsNorm, "gSNormW",  "Sample surface normal",                        false, ResourceFormat::RGBA32Float},
+        {kInputsColor, "gSColor",  "Outgoing radiance at sample point in RGBA",    false, ResourceFormat::RGBA32Float},
+        {kInputPdf, "gPdf",     "Random numbers used for path",                 false, ResourceFormat::R32Float},
     };
 
     const std::string kOutputColor = "outputColor";
@@ -86,11 +100,125 @@ namespace
     uint32_t kMaxPayloadSizeBytes = 128u;
     uint32_t kMaxRecursionDepth = 3u;
 
+    // Scripting options.
+    const char kSampleRadius[] = "sampleRadius";
+    const char kSpatialNeighborCount[] = "spatialNeighborCount";
+    const char kTemporalMaxM[] = "temporalMaxM";
+    const char kMaxSampleAge[] = "maxSampleAge";
+    const char kDepthThreshold[] = "depthThreshold";
+    const char kNormalThreshold[] = "normalThreshold";
+    const char kWeightClamp[] = "weightClamp";
+    const char kBiasCorrectionMode[] = "biasCorrectionMode";
+    const char kRayBudget[] = "rayBudget";
+    const char kTiledSpatialReuse[] = "tiledSpatialReuse";
+    const char kSparseSampling[] = "sparseSampling";
+    const char kSparseMThreshold[] = "sparseMThreshold";
+    const char kAdaptiveSpatialReuse[] = "adaptiveSpatialReuse";
+    const char kConfidenceHigh[] = "confidenceHigh";
+    const char kConfidenceLow[] = "confidenceLow";
+    const char kAdaptiveMinNeighbors[] = "adaptiveMinNeighbors";
+    const char kAdaptiveMaxNeighbors[] = "adaptiveMaxNeighbors";
+    const char kNeighborBudget[] = "neighborBudget";
+    const char kMemoryReport[] = "memoryReport";
+    const char kRadianceCache[] = "radianceCache";
+    const char kRadianceCacheCapacity[] = "radianceCacheCapacity";
+    const char kCacheCellSize[] = "cacheCellSize";
+    const char kCacheMinSamples[] = "cacheMinSamples";
+    const char kCacheMaxSamples[] = "cacheMaxSamples";
+    const char kCacheMaxAge[] = "cacheMaxAge";
+    const char kTemporalReprojection[] = "temporalReprojection";
+    const char kLightSampler[] = "lightSampler";
+    const char kFinalShading[] = "finalShading";
+    const char kHistoryDepthThreshold[] = "historyDepthThreshold";
+    const char kHistoryNormalThreshold[] = "historyNormalThreshold";
+    const char kHistorySearchRadius[] = "historySearchRadius";
+    const char kFuseInitialSampling[] = "fuseInitialSampling";
+    const char kCollectStatistics[] = "collectStatistics";
+    const char kStatisticsOutputPath[] = "statisticsOutputPath";
+    const char kCapturePath[] = "capturePath";
+    const char kCaptureFrame[] = "captureFrame";
+    const char kReplayCapture[] = "replayCapture";
+    const char kReusePrograms[] = "reusePrograms";
+    const char kShaderCompileLog[] = "shaderCompileLog";
+    const char kReservoirSlots[] = "reservoirSlots";
+
+    const size_t kMaxStatisticsFrames = 100000;
+
+    const char kCaptureHistoryName[] = "temporalHistory";
+
+    // Checksum, r/g/b/count sums, resolved radiance and age, see RadianceCache.slang.
+    const uint64_t kRadianceCacheEntrySize = sizeof(uint32_t) + 4 * sizeof(uint32_t) + 4 * sizeof(float) + sizeof(uint32_t);
+
+    const Gui::DropdownList kBiasCorrectionModeList =
+    {
+        { (uint32_t)BiasCorrectionMode::Unbiased, "Unbiased" },
+        { (uint32_t)BiasCorrectionMode::ReuseVisibility, "Reuse visibility" },
+        { (uint32_t)BiasCorrectionMode::Biased, "Biased" },
+    };
+
+    const Gui::DropdownList kLightSamplerModeList =
+    {
+        { (uint32_t)LightSamplerMode::Uniform, "Uniform" },
+        { (uint32_t)LightSamplerMode::Power, "Power" },
+        { (uint32_t)LightSamplerMode::LightBVH, "Light BVH" },
+    };
+
+    const Gui::DropdownList kFinalShadingModeList =
+    {
+        { (uint32_t)FinalShadingMode::RayTracing, "Ray tracing" },
+        { (uint32_t)FinalShadingMode::MaterialBinned, "Material binned" },
+    };
+
+    const Gui::DropdownList kTemporalReprojectionModeList =
+    {
+        { (uint32_t)TemporalReprojectionMode::Legacy, "Legacy" },
+        { (uint32_t)TemporalReprojectionMode::MotionVectors, "Motion vectors" },
+    };
+
+    const Gui::DropdownList kSparseSamplingModeList =
+    {
+        { (uint32_t)SparseSamplingMode::Full, "Full" },
+        { (uint32_t)SparseSamplingMode::Checkerboard, "Checkerboard" },
+        { (uint32_t)SparseSamplingMode::Quarter, "1 in 4" },
+        { (uint32_t)SparseSamplingMode::Importance, "Importance (history M)" },
+    };
+
+    const float3 kLuminanceWeights = float3(0.2126f, 0.7152f, 0.0722f);
+
+    /** Flux of an analytic light in luminance. Directional and distant lights have none, they count what falls on
+        the bounding sphere of the scene so they compare with the local lights.
+    */
+    float GetAnalyticLightPower(const LightData& light, float sceneRadius)
+    {
+        float intensity = glm::dot(kLuminanceWeights, light.intensity);
+        switch ((LightType)light.type)
+        {
+        case LightType::Point:
+            return intensity * 2.f * glm::pi<float>() * (1.f - std::cos(std::min(light.openingAngle, glm::pi<float>())));
+        case LightType::Directional:
+        case LightType::Distant:
+            return intensity * glm::pi<float>() * sceneRadius * sceneRadius;
+        default:
+            return intensity * glm::pi<float>() * light.surfaceArea;
+        }
+    }
+
+    ReSTIR::CaptureFormat GetCaptureFormat(ResourceFormat format)
+    {
+        switch (format)
+        {
+        case ResourceFormat::R32Float: return ReSTIR::CaptureFormat::Float;
+        case ResourceFormat::RG32Float: return ReSTIR::CaptureFormat::Float2;
+        case ResourceFormat::RGBA32Float: return ReSTIR::CaptureFormat::Float4;
+        case ResourceFormat::RG32Uint: return ReSTIR::CaptureFormat::Uint2;
+        default: return ReSTIR::CaptureFormat::Raw;
+        }
+    }
 }
 
 ReSTIRPass::SharedPtr ReSTIRPass::create(RenderContext* pRenderContext, const Dictionary& dict)
 {
-    SharedPtr pPass = SharedPtr(new ReSTIRPass());
+    SharedPtr pPass = SharedPtr(new ReSTIRPass(dict));
     return pPass;
 }
 
@@ -98,19 +226,150 @@ void ReSTIRPass::compile(RenderContext* pRenderContext, const CompileData& compi
 {
     mParams.frameDim = compileData.defaultTexDims;
     mParams.elemCount = mParams.frameDim.x * mParams.frameDim.y;
+
+    if (mpScene) ResizeReservoirs(pRenderContext);
 }
 
-ReSTIRPass::ReSTIRPass() : RenderPass(kInfo)
+ReSTIRPass::ReSTIRPass(const Dictionary& dict) : RenderPass(kInfo)
 {
+    ParseDictionary(dict);
+    mStatistics.SetMaxFrameCount(kMaxStatisticsFrames);
+
+    mShaderSourceHash = ReSTIR::HashShaderDirectory(PROJECT_DIR, { ".slang", ".slangh" });
+    std::filesystem::path logPath = mShaderCompileLogPath.empty() ? std::filesystem::temp_directory_path() / kShaderCompileLogFile : std::filesystem::path(mShaderCompileLogPath);
+    mpShaderCompileLog = std::make_unique<ReSTIR::ShaderCompileLog>(logPath);
+
+    mReservoirRing.Reset(mReservoirSlotCount);
+    UpdateRingSimulation();
+
     mpSampleGenerator = SampleGenerator::create(SAMPLE_GENERATOR_UNIFORM);
     auto defines = mpSampleGenerator->getDefines();
     mpReflectTypes = ComputePass::create(Program::Desc(kReflectTypesPath).setShaderModel(kShaderModel).csEntry("main"), defines);
     mpInitialReservoirPass = ComputePass::create(Program::Desc(kInitialResrvoirPassPath).setShaderModel(kShaderModel).csEntry("main"), defines);
+    mpReservoirResizePass = ComputePass::create(Program::Desc(kReservoirResizePassPath).setShaderModel(kShaderModel).csEntry("main"));
+    defines.add("RESTIR_STATS", mCollectStatistics ? "1" : "0");
+    mpRadianceCacheResolvePass = ComputePass::create(Program::Desc(kRadianceCacheResolvePassPath).setShaderModel(kShaderModel).csEntry("main"), defines);
+}
+
+ReSTIRPass::~ReSTIRPass()
+{
+    if (!mStatisticsOutputPath.empty()) ExportStatistics();
+    if (mCaptureWrite.valid()) mCaptureWrite.wait();
+}
+
+void ReSTIRPass::ParseDictionary(const Dictionary& dict)
+{
+    for (const auto& [key, value] : dict)
+    {
+        if (key == kSampleRadius) mParams.sampleRadius = value;
+        else if (key == kSpatialNeighborCount) mParams.spatialNeighborCount = std::min((uint32_t)value, kMaxSpatialNeighbors);
+        else if (key == kTemporalMaxM) mParams.temporalMaxM = value;
+        else if (key == kMaxSampleAge) mParams.maxSampleAge = value;
+        else if (key == kDepthThreshold) mParams.depthThreshold = value;
+        else if (key == kNormalThreshold) mParams.normalThreshold = value;
+        else if (key == kWeightClamp) mParams.weightClamp = value;
+        else if (key == kBiasCorrectionMode) mParams.biasCorrectionMode = std::min((uint32_t)value, (uint32_t)BiasCorrectionMode::Biased);
+        else if (key == kRayBudget) mParams.rayBudget = value;
+        else if (key == kTiledSpatialReuse) mTiledSpatialReuse = value;
+        else if (key == kSparseSampling) mParams.sparseSamplingMode = std::min((uint32_t)value, (uint32_t)SparseSamplingMode::Importance);
+        else if (key == kSparseMThreshold) mParams.sparseMThreshold = value;
+        else if (key == kAdaptiveSpatialReuse) mAdaptiveSpatialReuse = value;
+        else if (key == kConfidenceHigh) mParams.confidenceHigh = value;
+        else if (key == kConfidenceLow) mParams.confidenceLow = value;
+        else if (key == kAdaptiveMinNeighbors) mParams.adaptiveMinNeighbors = std::min((uint32_t)value, kMaxSpatialNeighbors);
+        else if (key == kAdaptiveMaxNeighbors) mParams.adaptiveMaxNeighbors = std::min((uint32_t)value, kMaxSpatialNeighbors);
+        else if (key == kNeighborBudget) mParams.neighborBudget = value;
+        else if (key == kMemoryReport) continue; // Output only, written by getScriptingDictionary.
+        else if (key == kRadianceCache) mUseRadianceCache = value;
+        else if (key == kRadianceCacheCapacity)
+        {
+            uint32_t capacity = std::max((uint32_t)value, kRadianceCacheProbeCount);
+            mRadianceCacheCapacity = 1;
+            while (mRadianceCacheCapacity < capacity) mRadianceCacheCapacity <<= 1;
+        }
+        else if (key == kCacheCellSize) mParams.cacheCellSize = value;
+        else if (key == kCacheMinSamples) mParams.cacheMinSamples = value;
+        else if (key == kCacheMaxSamples) mParams.cacheMaxSamples = value;
+        else if (key == kCacheMaxAge) mParams.cacheMaxAge = value;
+        else if (key == kTemporalReprojection)
+        {
+            mTemporalReprojectionMode = std::min((uint32_t)value, (uint32_t)TemporalReprojectionMode::MotionVectors);
+            mTransientBuffersDirty = true;
+        }
+        else if (key == kLightSampler)
+        {
+            mLightSamplerMode = std::min((uint32_t)value, (uint32_t)LightSamplerMode::LightBVH);
+            mLightSamplerDirty = true;
+        }
+        else if (key == kFinalShading)
+        {
+            mFinalShadingMode = std::min((uint32_t)value, (uint32_t)FinalShadingMode::MaterialBinned);
+            mTransientBuffersDirty = true;
+        }
+        else if (key == kHistoryDepthThreshold) mParams.historyDepthThreshold = value;
+        else if (key == kHistoryNormalThreshold) mParams.historyNormalThreshold = value;
+        else if (key == kHistorySearchRadius) mParams.historySearchRadius = std::min((uint32_t)value, kMaxHistorySearchRadius);
+        else if (key == kFuseInitialSampling) mFuseInitialSampling = value;
+        else if (key == kCollectStatistics) mCollectStatistics = value;
+        else if (key == kStatisticsOutputPath) mStatisticsOutputPath = value.operator std::string();
+        else if (key == kCapturePath) mCapturePath = value.operator std::string();
+        else if (key == kCaptureFrame) mCaptureFrame = value;
+        else if (key == kReplayCapture)
+        {
+            mReplayPath = value.operator std::string();
+            mReplayPending = !mReplayPath.empty();
+        }
+        else if (key == kReusePrograms) mReusePrograms = value;
+        else if (key == kShaderCompileLog) mShaderCompileLogPath = value.operator std::string();
+        else if (key == kReservoirSlots) mReservoirSlotCount = std::clamp((uint32_t)value, ReSTIR::ReservoirRing::kMinSlots, ReSTIR::ReservoirRing::kMaxSlots);
+        else logWarning("Unknown field '{}' in ReSTIRPass dictionary.", key);
+    }
 }
 
 Dictionary ReSTIRPass::getScriptingDictionary()
 {
-    return Dictionary();
+    Dictionary d;
+    d[kSampleRadius] = mParams.sampleRadius;
+    d[kSpatialNeighborCount] = mParams.spatialNeighborCount;
+    d[kTemporalMaxM] = mParams.temporalMaxM;
+    d[kMaxSampleAge] = mParams.maxSampleAge;
+    d[kDepthThreshold] = mParams.depthThreshold;
+    d[kNormalThreshold] = mParams.normalThreshold;
+    d[kWeightClamp] = mParams.weightClamp;
+    d[kBiasCorrectionMode] = mParams.biasCorrectionMode;
+    d[kRayBudget] = mParams.rayBudget;
+    d[kTiledSpatialReuse] = mTiledSpatialReuse;
+    d[kSparseSampling] = mParams.sparseSamplingMode;
+    d[kSparseMThreshold] = mParams.sparseMThreshold;
+    d[kAdaptiveSpatialReuse] = mAdaptiveSpatialReuse;
+    d[kConfidenceHigh] = mParams.confidenceHigh;
+    d[kConfidenceLow] = mParams.confidenceLow;
+    d[kAdaptiveMinNeighbors] = mParams.adaptiveMinNeighbors;
+    d[kAdaptiveMaxNeighbors] = mParams.adaptiveMaxNeighbors;
+    d[kNeighborBudget] = mParams.neighborBudget;
+    d[kMemoryReport] = mMemoryReport;
+    d[kRadianceCache] = mUseRadianceCache;
+    d[kRadianceCacheCapacity] = mRadianceCacheCapacity;
+    d[kCacheCellSize] = mParams.cacheCellSize;
+    d[kCacheMinSamples] = mParams.cacheMinSamples;
+    d[kCacheMaxSamples] = mParams.cacheMaxSamples;
+    d[kCacheMaxAge] = mParams.cacheMaxAge;
+    d[kTemporalReprojection] = mTemporalReprojectionMode;
+    d[kLightSampler] = mLightSamplerMode;
+    d[kFinalShading] = mFinalShadingMode;
+    d[kHistoryDepthThreshold] = mParams.historyDepthThreshold;
+    d[kHistoryNormalThreshold] = mParams.historyNormalThreshold;
+    d[kHistorySearchRadius] = mParams.historySearchRadius;
+    d[kFuseInitialSampling] = mFuseInitialSampling;
+    d[kCollectStatistics] = mCollectStatistics;
+    if (!mStatisticsOutputPath.empty()) d[kStatisticsOutputPath] = mStatisticsOutputPath;
+    if (!mCapturePath.empty()) d[kCapturePath] = mCapturePath;
+    if (mCaptureFrame != kNoCaptureFrame) d[kCaptureFrame] = mCaptureFrame;
+    if (!mReplayPath.empty()) d[kReplayCapture] = mReplayPath;
+    d[kReusePrograms] = mReusePrograms;
+    if (!mShaderCompileLogPath.empty()) d[kShaderCompileLog] = mShaderCompileLogPath;
+    d[kReservoirSlots] = mReservoirSlotCount;
+    return d;
 }
 
 RenderPassReflection ReSTIRPass::reflect(const CompileData& compileData)
@@ -119,6 +378,19 @@ RenderPassReflection ReSTIRPass::reflect(const CompileData& compileData)
     RenderPassReflection reflector;
     addRenderPassInputs(reflector, InputChannel);
     addRenderPassOutputs(reflector, OutputChannel);
+
+    ChannelList sampleChannels = SampleChannel;
+    if (mFuseInitialSampling)
+    {
+        // Only allocated when another pass consumes them.
+        for (auto& channel : sampleChannels) channel.optional = true;
+        addRenderPassOutputs(reflector, sampleChannels);
+    }
+    else
+    {
+        for (auto& channel : sampleChannels) channel.format = ResourceFormat::Unknown;
+        addRenderPassInputs(reflector, sampleChannels);
+    }
     return reflector;
 }
 
@@ -132,17 +404,35 @@ void ReSTIRPass::execute(RenderContext* pRenderContext, const RenderData& render
         return;
     }
 
-    //SampleInitialPass(pRenderContext, renderData);
-    InitialReservoirPass(pRenderContext, renderData);
+    UpdateReservoirRing(pRenderContext);
+    PollMaterialBinCheck();
+    if (mTransientBuffersDirty) AllocateTransientBuffers();
+    UpdateLightSamplers(pRenderContext);
+
+    PollCapture();
+    if (mReplayPending)
+    {
+        mReplayPending = false;
+        LoadCapture(mReplayPath);
+    }
+
+    BeginStatistics(pRenderContext);
+
+    if (mFuseInitialSampling) SampleInitialPass(pRenderContext, renderData);
+    else InitialReservoirPass(pRenderContext, renderData);
+    BeginCapture(pRenderContext);
     SpatialtemporalResamplePass(pRenderContext, renderData);
     FinalShadingPass(pRenderContext, renderData);
     //std::cout << "here";
 
+    EndCapture(pRenderContext, renderData);
+    EndStatistics(pRenderContext);
+
     
     mParams.frameCount++;
-    uint currentTemporal = mParams.temCurOffset;
-    mParams.temCurOffset = mParams.temLastOffset;
-    mParams.temLastOffset = currentTemporal;
+    mReservoirRing.Advance();
+    mParams.temCurOffset = mReservoirRing.GetCurrentSlot();
+    mParams.temLastOffset = mReservoirRing.GetPreviousSlot();
     
     mPrevViewProj = mpScene->getCamera()->getViewProjMatrixNoJitter();
     cameraPrePos = mpScene->getCamera()->getPosition();
@@ -150,6 +440,8 @@ void ReSTIRPass::execute(RenderContext* pRenderContext, const RenderData& render
 
 void ReSTIRPass::InitialReservoirPass(RenderContext* pRenderContext, const RenderData& renderData)
 {
+    FALCOR_PROFILE("ReStir::initialReservoir");
+
     auto vars = mpInitialReservoirPass->getRootVar();
 
     vars["manager"]["vPosW"] = renderData[kInputvPos]->asTexture();
@@ -170,55 +462,181 @@ void ReSTIRPass::InitialReservoirPass(RenderContext* pRenderContext, const Rende
 
 void ReSTIRPass::SampleInitialPass(RenderContext* pRenderContext, const RenderData& renderData)
 {
+    FALCOR_PROFILE("ReStir::initialSampling");
+
+    if (!mSampleInitialPass.mProgram) InitSampleInitialPass();
+
+    // The debug channels are only written when connected.
+    auto defines = getValidResourceDefines(SampleChannel, renderData);
+    defines.add("RESTIR_STATS", mCollectStatistics ? "1" : "0");
+    defines.add("USE_RADIANCE_CACHE", mUseRadianceCache ? "1" : "0");
+    if (mpEmissiveSampler) defines.add(mpEmissiveSampler->getDefines());
+    if (mSampleInitialPass.mProgram->addDefines(defines)) mSampleInitialPass.mVars = nullptr;
+    if (!mSampleInitialPass.mVars) mSampleInitialPass.mVars = RtProgramVars::create(mSampleInitialPass.mProgram, mSampleInitialPass.mBindTable);
+
     auto& dict = renderData.getDictionary();
     auto vars = mSampleInitialPass.mVars->getRootVar();
 
     vars["sampleInitializer"]["vbuffer_"] = renderData[kInputVBuffer]->asTexture();
 
-    vars["initialSampleBuffer"] = mpSampleBuffer;
+    vars["initialReservoirs"] = mpInitialReserovir;
     vars["temporalReservoirBuffer"] = mpTemporalReservoir;
     vars["spatialReservoirBuffer"] = mpSpatialReservoir;
     vars["PreBufferCB"]["params"].setBlob(mParams);
     vars["outputColor"] = renderData[kOutputColor]->asTexture();
     vars["gScene"] = mpScene->getParameterBlock();
+    if (mCollectStatistics) vars["gStatsCounters"] = mpStatsCounters;
+    if (mUseRadianceCache)
+    {
+        if (mClearRadianceCache)
+        {
+            for (const auto& pBuffer : { mpCacheChecksums, mpCacheAccumulation, mpCacheRadiance, mpCacheAges }) pRenderContext->clearUAV(pBuffer->getUAV().get(), uint4(0));
+            mClearRadianceCache = false;
+        }
+        vars["gCacheChecksums"] = mpCacheChecksums;
+        vars["gCacheAccumulation"] = mpCacheAccumulation;
+        vars["gCacheRadiance"] = mpCacheRadiance;
+        vars["gCacheAges"] = mpCacheAges;
+    }
+
+    for (const auto& channel : SampleChannel) vars[channel.texname] = renderData.getTexture(channel.name);
 
-    if (mpEnvMapSampler) mpEnvMapSampler->setShaderData(vars["pathtracer"]["envMapSampler"]);
-    if (mpEmissiveSampler) mpEmissiveSampler->setShaderData(vars["pathtracer"]["emissiveSampler"]);
+    BindLightSamplers(vars["pathtracer"]);
 
     vars["sampleInitializer"]["gPRNGDimension"] = dict.keyExists(kRenderPassPRNGDimension) ? dict[kRenderPassPRNGDimension] : 0u;
-    //mpScene->raytrace(pRenderContext, mSampleInitialPass.mProgram.get(), mSampleInitialPass.mVars, uint3(mParams.frameDim.x, mParams.frameDim.y, 1u));
+    mpScene->raytrace(pRenderContext, mSampleInitialPass.mProgram.get(), mSampleInitialPass.mVars, uint3(mParams.frameDim.x, mParams.frameDim.y, 1u));
+
+    if (mUseRadianceCache) ResolveRadianceCache(pRenderContext);
+}
+
+void ReSTIRPass::ResolveRadianceCache(RenderContext* pRenderContext)
+{
+    FALCOR_PROFILE("ReStir::radianceCache");
+
+    auto vars = mpRadianceCacheResolvePass->getRootVar();
+    vars["gCacheChecksums"] = mpCacheChecksums;
+    vars["gCacheAccumulation"] = mpCacheAccumulation;
+    vars["gCacheRadiance"] = mpCacheRadiance;
+    vars["gCacheAges"] = mpCacheAges;
+    vars["PreBufferCB"]["params"].setBlob(mParams);
+    if (mCollectStatistics) vars["gStatsCounters"] = mpStatsCounters;
+
+    mpRadianceCacheResolvePass->execute(pRenderContext, uint3(mParams.cacheCapacity, 1u, 1u));
 }
 
 void ReSTIRPass::SpatialtemporalResamplePass(RenderContext* pRenderContext, const RenderData& renderData)
 {
     FALCOR_PROFILE("ReStir::resampling");
 
-    auto vars = mSpatialtemporalResamplePass->getRootVar();
-    vars["resampleManager"]["motionVec"] = renderData[kInputeMotionVec]->asTexture();
+    if (mParams.rayBudget > 0)
+    {
+        if (!mpRayBudgetCounter)
+        {
+            mpRayBudgetCounter = Buffer::createStructured(sizeof(uint32_t), 1, Resource::BindFlags::ShaderResource | Resource::BindFlags::UnorderedAccess, Buffer::CpuAccess::None, nullptr, false);
+        }
+        pRenderContext->clearUAV(mpRayBudgetCounter->getUAV().get(), uint4(0));
+    }
+
+    // Without motion vectors or normals the history cannot be tested, temporal reuse falls back to the legacy projection.
+    bool useMotionVectors = mTemporalReprojectionMode == (uint32_t)TemporalReprojectionMode::MotionVectors &&
+        renderData.getTexture(kInputeMotionVec) && renderData.getTexture(kInputNormBuffer) && !mpHistory.empty();
+    mParams.temporalReprojectionMode = (uint32_t)(useMotionVectors ? TemporalReprojectionMode::MotionVectors : TemporalReprojectionMode::Legacy);
+    if (useMotionVectors && !mHistoryValid)
+    {
+        for (const auto& pHistory : mpHistory) pRenderContext->clearUAV(pHistory->getUAV().get(), uint4(0));
+    }
+    mHistoryValid = useMotionVectors;
+
+    if (mAdaptiveSpatialReuse)
+    {
+        AdaptiveResamplePass(pRenderContext, renderData);
+        return;
+    }
+
+    BindResampleVars(mSpatialtemporalResamplePass->getRootVar(), renderData);
+    mSpatialtemporalResamplePass->execute(pRenderContext, uint3(mParams.frameDim.x, mParams.frameDim.y, 1u));
+}
+
+void ReSTIRPass::AdaptiveResamplePass(RenderContext* pRenderContext, const RenderData& renderData)
+{
+    if (!mpAdaptiveState)
+    {
+        auto bindFlags = Resource::BindFlags::ShaderResource | Resource::BindFlags::UnorderedAccess;
+        mpAdaptiveState = Buffer::createStructured(sizeof(uint32_t), kAdaptiveStateSize, bindFlags, Buffer::CpuAccess::None, nullptr, false);
+        mpAdaptiveDispatchArgs = Buffer::createStructured(sizeof(uint32_t), 3, bindFlags | Resource::BindFlags::IndirectArg, Buffer::CpuAccess::None, nullptr, false);
+    }
+    pRenderContext->clearUAV(mpAdaptiveState->getUAV().get(), uint4(0));
+
+    auto bindAdaptive = [&](const ShaderVar& vars)
+    {
+        vars["gConfidence"] = mpConfidence;
+        vars["gPixelLists"] = mpPixelLists;
+        vars["gAdaptiveState"] = mpAdaptiveState;
+        vars["gAdaptiveDispatchArgs"] = mpAdaptiveDispatchArgs;
+    };
+
+    BindResampleVars(mpTemporalResamplePass->getRootVar(), renderData);
+    mpTemporalResamplePass->execute(pRenderContext, uint3(mParams.frameDim.x, mParams.frameDim.y, 1u));
+
+    {
+        FALCOR_PROFILE("ReStir::confidence");
+        for (const auto& pPass : { mpConfidencePass, mpAdaptiveArgsPass })
+        {
+            auto vars = pPass->getRootVar();
+            bindAdaptive(vars);
+            vars["temporalReservoirBuffer"] = mpTemporalReservoir;
+            vars["spatialReservoirBuffer"] = mpSpatialReservoir;
+            vars["PreBufferCB"]["params"].setBlob(mParams);
+            if (mCollectStatistics) vars["gStatsCounters"] = mpStatsCounters;
+        }
+        mpConfidencePass->execute(pRenderContext, uint3(mParams.frameDim.x, mParams.frameDim.y, 1u));
+        mpAdaptiveArgsPass->execute(pRenderContext, uint3(1u));
+    }
+
+    auto vars = mpAdaptiveSpatialPass->getRootVar();
+    BindResampleVars(vars, renderData);
+    bindAdaptive(vars);
+    mpAdaptiveSpatialPass->executeIndirect(pRenderContext, mpAdaptiveDispatchArgs.get());
+}
+
+void ReSTIRPass::BindResampleVars(const ShaderVar& vars, const RenderData& renderData)
+{
+    vars["resampleManager"]["motionVec"] = renderData.getTexture(kInputeMotionVec);
     vars["resampleManager"]["depth"] = renderData[kInputDepthBuffer]->asTexture();
-    vars["resampleManager"]["norm"] = renderData[kInputNormBuffer]->asTexture();
+    vars["resampleManager"]["norm"] = renderData.getTexture(kInputNormBuffer);
+    vars["resampleManager"]["historyPrev"] = mpHistory.empty() ? nullptr : mpHistory[mParams.temLastOffset];
+    vars["resampleManager"]["historyCur"] = mpHistory.empty() ? nullptr : mpHistory[mParams.temCurOffset];
     vars["resampleManager"]["prevViewProj"] = mPrevViewProj;
     vars["resampleManager"]["cameraPrePos"] = cameraPrePos;
     vars["initialReservoirs"] = mpInitialReserovir;
-
-    vars["initialSampleBuffer"] = mpSampleBuffer;
     vars["temporalReservoirBuffer"] = mpTemporalReservoir;
     vars["spatialReservoirBuffer"] = mpSpatialReservoir;
     vars["outputColor"] = renderData[kOutputColor]->asTexture();
     vars["PreBufferCB"]["params"].setBlob(mParams);
     vars["gScene"] = mpScene->getParameterBlock();
-
-    mSpatialtemporalResamplePass->addDefine("MAX_ITERATIONS", "8");
-    
-    mSpatialtemporalResamplePass->execute(pRenderContext, uint3(mParams.frameDim.x, mParams.frameDim.y, 1u));
+    if (mCollectStatistics) vars["gStatsCounters"] = mpStatsCounters;
+    if (mParams.rayBudget > 0) vars["gRayBudgetCounter"] = mpRayBudgetCounter;
 }
 
 void ReSTIRPass::FinalShadingPass(RenderContext* pRenderContext, const RenderData& renderdata)
 {
+    FALCOR_PROFILE("ReStir::finalShading");
+
+    if (mFinalShadingMode == (uint32_t)FinalShadingMode::MaterialBinned && mpSortedPixels)
+    {
+        MaterialBinnedShadingPass(pRenderContext, renderdata);
+        return;
+    }
+
+    // The emissive sampler type is a define, it changes with the light sampler mode.
+    if (mpEmissiveSampler && mFinalShadingPass.mProgram->addDefines(mpEmissiveSampler->getDefines()))
+    {
+        mFinalShadingPass.mVars = RtProgramVars::create(mFinalShadingPass.mProgram, mFinalShadingPass.mBindTable);
+    }
+
     auto vars = mFinalShadingPass.mVars->getRootVar();
     vars["vbuffer"] = renderdata[kInputVBuffer]->asTexture();
 
-    //vars["initialSampleBuffer"] = mpSampleBuffer;
     vars["temporalReservoirBuffer"] = mpTemporalReservoir;
     vars["spatialReservoirBuffer"] = mpSpatialReservoir;
 
@@ -226,20 +644,126 @@ void ReSTIRPass::FinalShadingPass(RenderContext* pRenderContext, const RenderDat
     vars["PreBufferCB"]["params"].setBlob(mParams);
     vars["gScene"] = mpScene->getParameterBlock();
 
-    if (mpEnvMapSampler) mpEnvMapSampler->setShaderData(vars["pathtracer"]["envMapSampler"]);
-    if (mpEmissiveSampler) mpEmissiveSampler->setShaderData(vars["pathtracer"]["emissiveSampler"]);
+    BindLightSamplers(vars["pathtracer"]);
 
     mpScene->raytrace(pRenderContext, mFinalShadingPass.mProgram.get(), mFinalShadingPass.mVars, uint3(mParams.frameDim.x, mParams.frameDim.y, 1u));
 }
 
+void ReSTIRPass::MaterialBinnedShadingPass(RenderContext* pRenderContext, const RenderData& renderData)
+{
+    if (!mpMaterialCountPass)
+    {
+        auto defines = GetFinalShadingDefines();
+        mpMaterialCountPass = GetComputePass(kMaterialBinningPassPath, "countMain", defines, true);
+        mpMaterialScanPass = GetComputePass(kMaterialBinningPassPath, "scanMain", defines, true);
+        mpMaterialScatterPass = GetComputePass(kMaterialBinningPassPath, "scatterMain", defines, true);
+        mpMaterialShadePass = GetComputePass(kMaterialBinningPassPath, "shadeMain", defines, true);
+    }
+
+    // One bin per material and one for the pixels without a surface.
+    const uint32_t binCount = mpScene->getMaterialCount() + 1;
+    if (!mpMaterialBinCounts || mpMaterialBinCounts->getElementCount() < binCount)
+    {
+        auto bindFlags = Resource::BindFlags::ShaderResource | Resource::BindFlags::UnorderedAccess;
+        mpMaterialBinCounts = Buffer::createStructured(sizeof(uint32_t), binCount, bindFlags, Buffer::CpuAccess::None, nullptr, false);
+    }
+    pRenderContext->clearUAV(mpMaterialBinCounts->getUAV().get(), uint4(0));
+
+    for (const auto& pPass : { mpMaterialCountPass, mpMaterialScanPass, mpMaterialScatterPass, mpMaterialShadePass })
+    {
+        if (mpEmissiveSampler && pPass->getProgram()->addDefines(mpEmissiveSampler->getDefines())) pPass->setVars(nullptr);
+
+        auto vars = pPass->getRootVar();
+        vars["BinningCB"]["gBinCount"] = binCount;
+        vars["gBinCounts"] = mpMaterialBinCounts;
+        vars["gPixelBins"] = mpPixelBins;
+        vars["gPixelRanks"] = mpPixelRanks;
+        vars["gSortedPixels"] = mpSortedPixels;
+        vars["vbuffer"] = renderData[kInputVBuffer]->asTexture();
+        vars["temporalReservoirBuffer"] = mpTemporalReservoir;
+        vars["spatialReservoirBuffer"] = mpSpatialReservoir;
+        vars["outputColor"] = renderData[kOutputColor]->asTexture();
+        vars["PreBufferCB"]["params"].setBlob(mParams);
+        vars["gScene"] = mpScene->getParameterBlock();
+        BindLightSamplers(vars["pathtracer"]);
+    }
+
+    mpMaterialCountPass->execute(pRenderContext, uint3(mParams.frameDim.x, mParams.frameDim.y, 1u));
+    mpMaterialScanPass->execute(pRenderContext, uint3(kMaterialScanGroupSize, 1u, 1u));
+    mpMaterialScatterPass->execute(pRenderContext, uint3(mParams.frameDim.x, mParams.frameDim.y, 1u));
+    mpMaterialShadePass->execute(pRenderContext, uint3(mParams.elemCount, 1u, 1u));
+
+    if (!mBinCheckRequested || mBinCheck.pending) return;
+    mBinCheckRequested = false;
+
+    auto copy = [&](Buffer::SharedPtr& pReadback, const Buffer::SharedPtr& pSource, uint32_t count)
+    {
+        uint64_t size = count * sizeof(uint32_t);
+        if (!pReadback || pReadback->getSize() != size) pReadback = Buffer::create(size, Resource::BindFlags::None, Buffer::CpuAccess::Read, nullptr);
+        pRenderContext->copyBufferRegion(pReadback.get(), 0, pSource.get(), 0, size);
+    };
+    copy(mBinCheck.pOffsets, mpMaterialBinCounts, binCount);
+    copy(mBinCheck.pPixelBins, mpPixelBins, mParams.elemCount);
+    copy(mBinCheck.pSortedPixels, mpSortedPixels, mParams.elemCount);
+    mBinCheck.binCount = binCount;
+    mBinCheck.width = mParams.frameDim.x;
+    mBinCheck.pixelCount = mParams.elemCount;
+
+    // Submit the copies and put a fence behind them, the readback is polled on a later frame.
+    if (!mpBinCheckFence) mpBinCheckFence = GpuFence::create();
+    pRenderContext->flush(false);
+    mBinCheck.fenceValue = mpBinCheckFence->gpuSignal(pRenderContext->getLowLevelData()->getCommandQueue());
+    mBinCheck.pending = true;
+}
+
+void ReSTIRPass::PollMaterialBinCheck()
+{
+    if (!mBinCheck.pending || mBinCheck.fenceValue > mpBinCheckFence->getGpuValue()) return;
+    mBinCheck.pending = false;
+
+    auto read = [](const Buffer::SharedPtr& pBuffer)
+    {
+        const uint32_t* pData = static_cast<const uint32_t*>(pBuffer->map(Buffer::MapType::Read));
+        std::vector<uint32_t> values(pData, pData + pBuffer->getSize() / sizeof(uint32_t));
+        pBuffer->unmap();
+        return values;
+    };
+    std::vector<uint32_t> pixelBins = read(mBinCheck.pPixelBins);
+
+    ReSTIR::MaterialBins gpuBins;
+    gpuBins.offsets = read(mBinCheck.pOffsets);
+    gpuBins.offsets.push_back(mBinCheck.pixelCount);
+    gpuBins.pixels = read(mBinCheck.pSortedPixels);
+    // Packed as in PackPixel of AdaptiveReuse.slang.
+    for (auto& pixel : gpuBins.pixels) pixel = (pixel >> 16) * mBinCheck.width + (pixel & 0xffff);
+
+    ReSTIR::MaterialBins cpuBins;
+    ReSTIR::BuildMaterialBins(pixelBins, mBinCheck.binCount, cpuBins, mpThreadPool.get());
+
+    // The GPU orders a bin by its atomics, only the offsets have to be equal.
+    bool valid = gpuBins.offsets == cpuBins.offsets && ReSTIR::ValidateMaterialBins(pixelBins, mBinCheck.binCount, gpuBins);
+    uint32_t usedBins = 0;
+    for (uint32_t bin = 0; bin < cpuBins.GetBinCount(); bin++) usedBins += cpuBins.GetBinSize(bin) > 0 ? 1 : 0;
+
+    mMaterialBinReport = valid ? "GPU bins match the CPU binning\n" : "GPU bins do not match the CPU binning\n";
+    mMaterialBinReport += "Bins used: " + std::to_string(usedBins) + " of " + std::to_string(mBinCheck.binCount) + "\n";
+    mMaterialBinReport += "Bins per wave of 32, pixel order: " + std::to_string(ReSTIR::GetAverageBinsPerWave(pixelBins, {}, 32)) + "\n";
+    mMaterialBinReport += "Bins per wave of 32, binned: " + std::to_string(ReSTIR::GetAverageBinsPerWave(pixelBins, gpuBins.pixels, 32));
+    if (!valid) logWarning("ReSTIRPass: material bins of the GPU do not match the CPU binning.");
+}
+
 void ReSTIRPass::setScene(RenderContext* pRenderContext, const Scene::SharedPtr& pScene)
 {
     mpScene = pScene;
     mParams.frameCount = 0;
+    mClearRadianceCache = true;
+    mHistoryValid = false;
 
     mSampleInitialPass.mProgram = nullptr;
     mSampleInitialPass.mBindTable = nullptr;
     mSampleInitialPass.mVars = nullptr;
+    mpMaterialCountPass = mpMaterialScanPass = mpMaterialScatterPass = mpMaterialShadePass = nullptr;
+    mPermutationCounters = {};
 
     if (mpScene->getRenderSettings().useEmissiveLights)
     {
@@ -250,44 +774,785 @@ void ReSTIRPass::setScene(RenderContext* pRenderContext, const Scene::SharedPtr&
     {
         mpEnvMapSampler = EnvMapSampler::create(pRenderContext, mpScene->getEnvMap());
     }
-    if (mpScene->useEmissiveLights())
-    {
-        mpEmissiveSampler = EmissiveUniformSampler::create(pRenderContext, mpScene);
-    }
+    // The programs created below take the defines of the emissive sampler.
+    mLightSamplerDirty = true;
+    mLightTablesDirty = true;
+    UpdateLightSamplers(pRenderContext);
 
-    InitSampleBuffer();
-    //InitSampleInitialPass();
+    ResizeReservoirs(pRenderContext);
     InitSpatialtemporalResamplePass();
     InitFinalShadingPass();
+    if (mFuseInitialSampling) InitSampleInitialPass();
+    UpdateShaderPermutationReport();
 }
 
 void ReSTIRPass::renderUI(Gui::Widgets& widget)
 {
+    if (widget.checkbox("Fuse initial sampling", mFuseInitialSampling))
+    {
+        requestRecompile();
+    }
+    widget.tooltip("Trace the initial samples in this pass and write the reservoirs directly.\nThe sample channels become optional debug outputs.");
+
+    if (mFuseInitialSampling)
+    {
+        widget.dropdown("Sparse sampling", kSparseSamplingModeList, mParams.sparseSamplingMode);
+        widget.tooltip("Pixels that trace a new initial sample each frame. The others get an empty initial reservoir and live on reuse.");
+        if (mParams.sparseSamplingMode == (uint32_t)SparseSamplingMode::Importance)
+        {
+            widget.var("M threshold", mParams.sparseMThreshold, 0u, 1000u);
+            widget.tooltip("Pixels whose temporal M is below this value trace a new sample every frame.");
+        }
+
+        if (widget.checkbox("Radiance cache", mUseRadianceCache)) mTransientBuffersDirty = true;
+        widget.tooltip("Cache the outgoing radiance of the path vertices in a world space hash grid and end the paths of the initial samples "
+            "at the first bounce when the cell there has enough samples. Trades bias for fewer rays in multi-bounce scenes.");
+        if (mUseRadianceCache)
+        {
+            widget.var("Cell size", mParams.cacheCellSize, 0.001f, 10.f, 0.001f);
+            widget.tooltip("Cell size at distance 1 from the camera, it doubles with every power of two of the distance.");
+            widget.var("Min samples", mParams.cacheMinSamples, 1u, 1024u);
+            widget.tooltip("Samples a cell needs before it ends paths.");
+            widget.var("Max samples", mParams.cacheMaxSamples, 1u, 65536u);
+            widget.tooltip("Past this number of samples a cell becomes a moving average and follows lighting changes.");
+            widget.var("Max age", mParams.cacheMaxAge, 1u, 10000u);
+            widget.tooltip("Cells without an update for this many frames are evicted.");
+            if (widget.button("Clear cache")) mClearRadianceCache = true;
+        }
+    }
+
+    if (auto group = widget.group("Light sampling"))
+    {
+        if (group.dropdown("Sampler", kLightSamplerModeList, mLightSamplerMode)) mLightSamplerDirty = true;
+        group.tooltip("Uniform picks every light and light type with the same probability.\n"
+            "Power picks emissive triangles with Falcor's power sampler and analytic lights with an alias table, "
+            "and splits the samples between emissive and analytic lights by power.\n"
+            "Light BVH picks emissive triangles by Falcor's light BVH, the rest as in Power.");
+        if (!mLightSamplingReport.empty()) group.text(mLightSamplingReport);
+    }
+
+    if (auto group = widget.group("Final shading"))
+    {
+        if (group.dropdown("Mode", kFinalShadingModeList, mFinalShadingMode)) mTransientBuffersDirty = true;
+        group.tooltip("Ray tracing shades every pixel in a ray generation shader, in pixel order.\n"
+            "Material binned sorts the pixels by material with a count, prefix sum and scatter pass and shades them in that order "
+            "in a compute pass, so the threads of a wave mostly evaluate the same material.");
+        if (mFinalShadingMode == (uint32_t)FinalShadingMode::MaterialBinned)
+        {
+            if (group.button("Check bins")) mBinCheckRequested = true;
+            group.tooltip("Read back the bins of the next frame and compare them with the CPU binning.");
+            if (!mMaterialBinReport.empty()) group.text(mMaterialBinReport);
+        }
+    }
+
+    if (auto group = widget.group("Shader permutations"))
+    {
+        group.checkbox("Reuse programs", mReusePrograms);
+        group.tooltip("Keep the programs of this session in memory by permutation key, so a scene or option seen before reuses its program.\n"
+            "Nothing compiled is written to disk, the compile log only records the keys and compile times of every run.");
+        if (group.button("Clear"))
+        {
+            mComputePassCache.clear();
+            mRtProgramCache.clear();
+            UpdateShaderPermutationReport();
+        }
+        group.text(mShaderPermutationReport);
+    }
+
+    if (auto group = widget.group("Reservoir ring"))
+    {
+        group.var("Temporal slots", mReservoirSlotCount, ReSTIR::ReservoirRing::kMinSlots, ReSTIR::ReservoirRing::kMaxSlots);
+        group.tooltip("Temporal reservoir slots used round robin. Changing the count drops the temporal history.\n"
+            "The frames run in order on the direct queue, so more than 2 slots only cost memory. They are there for the async schedule simulated below.");
+        group.text("Current slot " + std::to_string(mParams.temCurOffset) + ", previous " + std::to_string(mParams.temLastOffset) + "\n" +
+            "Slot still in flight when written: " + std::to_string(mRingBusyWrites) + " of " + std::to_string(mRingFrames) + " frames");
+
+        // What-if model of initial sampling on an async compute queue, Falcor 5 render passes only get the direct queue.
+        auto costVar = [&](const char* label, double& cost)
+        {
+            float value = (float)cost;
+            if (!group.var(label, value, 0.f, 100.f, 0.1f)) return false;
+            cost = value;
+            return true;
+        };
+        bool changed = group.var("Simulated slots", mRingSimulation.slotCount, ReSTIR::ReservoirRing::kMinSlots, ReSTIR::ReservoirRing::kMaxSlots);
+        changed |= group.var("Frames ahead", mRingSimulation.framesAhead, 0u, ReSTIR::ReservoirRing::kMaxSlots - 1);
+        changed |= costVar("G-buffer ms", mRingSimulation.costs.gbuffer);
+        changed |= costVar("Initial sampling ms", mRingSimulation.costs.initialSampling);
+        changed |= costVar("Resampling ms", mRingSimulation.costs.resampling);
+        changed |= costVar("Final shading ms", mRingSimulation.costs.finalShading);
+        if (changed) UpdateRingSimulation();
+        group.text(mRingSimulationReport);
+    }
+
+    if (auto group = widget.group("Memory"))
+    {
+        group.text(mMemoryReport);
+    }
+
+    if (auto group = widget.group("Statistics"))
+    {
+        if (group.checkbox("Collect statistics", mCollectStatistics))
+        {
+            UpdateResampleDefines();
+        }
+        group.tooltip("Count reservoir reuse events on the GPU. The counters are read back " + std::to_string(kStatsReadbackLatency) + " frames later.");
+
+        if (!mStatistics.IsEmpty())
+        {
+            const ReSTIR::FrameStatistics& frame = mStatistics.GetFrames().back();
+            std::string text;
+            text += "Frame " + std::to_string(frame.frameIndex) + "\n";
+            text += "Temporal reset rate: " + std::to_string(frame.GetTemporalResetRate()) + "\n";
+            if (mParams.temporalReprojectionMode == (uint32_t)TemporalReprojectionMode::MotionVectors)
+            {
+                text += "History acceptance rate: " + std::to_string(frame.GetHistoryAcceptanceRate()) + "\n";
+                text += "History search hit rate: " + std::to_string(frame.GetSearchHitRate()) + "\n";
+            }
+            text += "Average temporal M: " + std::to_string(frame.GetAverageTemporalM()) + "\n";
+            text += "Average spatial M: " + std::to_string(frame.GetAverageSpatialM()) + "\n";
+            text += "Similarity reject rate: " + std::to_string(frame.GetSimilarityRejectRate()) + "\n";
+            text += "Visibility rays per pixel: " + std::to_string(frame.GetRaysPerPixel());
+            if (mFuseInitialSampling)
+            {
+                text += "\nPath rays per initial sample: " + std::to_string(frame.GetPathRaysPerSample());
+                text += "\nRadiance cache hit rate: " + std::to_string(frame.GetCacheHitRate());
+            }
+            group.text(text);
+        }
+
+        group.textbox("Output path", mStatisticsOutputPath);
+        group.tooltip("Statistics are written to <path>.csv and <path>.json on export and when the pass is destroyed.");
+        if (group.button("Export")) ExportStatistics();
+        if (group.button("Clear", true)) mStatistics.Clear();
+    }
+
+    if (auto group = widget.group("Capture"))
+    {
+        group.textbox("Output path", mCapturePath);
+        group.tooltip("Captures are written to <path>_<frame>.rstc.");
+        if (group.button("Capture frame")) mCaptureRequested = true;
+        group.tooltip("Write the reservoirs, runtime parameters, camera and input channels of the next frame.\n"
+            "The copies are read back without waiting for the GPU and written by a worker thread.");
+
+        group.textbox("Replay file", mReplayPath);
+        if (group.button("Replay")) mReplayPending = true;
+        group.tooltip("Restore the temporal reservoirs, runtime parameters and previous camera of a capture before the next frame.\n"
+            "The inputs come from the render graph, the scene and camera have to match the capture for an exact replay.");
+
+        if (!mCaptureStatus.empty()) group.text(mCaptureStatus);
+    }
+
+    if (auto group = widget.group("Temporal reuse", true))
+    {
+        if (group.dropdown("Reprojection", kTemporalReprojectionModeList, mTemporalReprojectionMode)) mTransientBuffersDirty = true;
+        group.tooltip("Legacy projects the visible point with the last view-projection matrix and compares world positions.\n"
+            "Motion vectors follows mvec and rejects the history when the linear depth or normal of the last frame does not match.");
+        if (mTemporalReprojectionMode == (uint32_t)TemporalReprojectionMode::MotionVectors)
+        {
+            if (mParams.temporalReprojectionMode != mTemporalReprojectionMode) group.text("mvec or normW is not connected, using legacy reprojection.");
+            group.var("History depth threshold", mParams.historyDepthThreshold, 0.f, 1.f, 0.005f);
+            group.tooltip("Relative linear depth difference to the last frame that still counts as the same surface.");
+            group.var("History normal threshold", mParams.historyNormalThreshold, -1.f, 1.f, 0.01f);
+            group.tooltip("Min cosine between the normal and the normal of the last frame.");
+            group.var("Search radius", mParams.historySearchRadius, 0u, kMaxHistorySearchRadius);
+            group.tooltip("When the motion vector lands on another surface, search this many pixels around it for a matching history. 0 disables the search.");
+        }
+        group.var("Max M", mParams.temporalMaxM, 1u, 1000u);
+        group.tooltip("M of the temporal history is clamped to this value before merging the new sample.");
+        group.var("Max sample age", mParams.maxSampleAge, 1u, 10000u);
+        group.tooltip("Temporal samples older than this number of frames are discarded.");
+    }
+
+    if (auto group = widget.group("Spatial reuse", true))
+    {
+        if (group.checkbox("Tiled", mTiledSpatialReuse))
+        {
+            UpdateResampleDefines();
+        }
+        group.tooltip("A 16x16 tile moves by one offset per frame and every pixel picks its neighbours within 4 pixels of the moved pixel, "
+            "so the neighbours of a tile are staged in groupshared memory once.\n"
+            "The staged neighbours are packed like PackedReservoir (radiance RGB9E5, normals octahedral, M and age clamped to 16 bits), "
+            "so the result differs slightly from untiled reuse.");
+        group.var("Radius", mParams.sampleRadius, 1u, 200u);
+        group.var("Neighbors", mParams.spatialNeighborCount, 0u, kMaxSpatialNeighbors);
+        group.var("Depth threshold", mParams.depthThreshold, 0.f, 1.f, 0.01f);
+        group.tooltip("Neighbors whose depth differs by more than this fraction are rejected.");
+        group.var("Normal threshold", mParams.normalThreshold, -1.f, 1.f, 0.01f);
+        group.tooltip("Neighbors whose normal cosine is below this value are rejected.");
+        group.var("Weight clamp", mParams.weightClamp, 0.f, 1000.f, 0.1f);
+
+        group.dropdown("Bias correction", kBiasCorrectionModeList, mParams.biasCorrectionMode);
+        group.tooltip("Unbiased traces a ray from every reused pixel to the selected sample.\n"
+            "Reuse visibility skips the rays of the center and of the pixel owning the sample, they are known from merging.\n"
+            "Biased traces no rays.");
+        group.var("Ray budget", mParams.rayBudget, 0u, 1u << 30);
+        group.tooltip("Bias correction rays per frame, 0 is unlimited. Pixels past the budget fall back to the biased M.");
+
+        if (group.checkbox("Adaptive", mAdaptiveSpatialReuse)) mTransientBuffersDirty = true;
+        group.tooltip("Classify the pixels by the confidence of their temporal reservoir and give low confidence pixels more neighbors.\n"
+            "Temporal and spatial reuse run as separate dispatches, the spatial one over compacted pixel lists. Replaces tiled reuse.");
+        if (mAdaptiveSpatialReuse)
+        {
+            group.var("Converged above", mParams.confidenceHigh, 0.f, 1.f, 0.01f);
+            group.var("Low confidence below", mParams.confidenceLow, 0.f, 1.f, 0.01f);
+            group.var("Converged neighbors", mParams.adaptiveMinNeighbors, 0u, kMaxSpatialNeighbors);
+            group.var("Low confidence neighbors", mParams.adaptiveMaxNeighbors, 0u, kMaxSpatialNeighbors);
+            group.var("Neighbor budget", mParams.neighborBudget, 0u, 1u << 30);
+            group.tooltip("Spatial neighbors per frame over all pixels, 0 is unlimited. Low confidence pixels are served first.\n"
+                "The budget is never exceeded: if it cannot give every pixel the converged count, all pixels get fewer.");
+        }
+    }
 }
 
-void ReSTIRPass::InitSampleBuffer()
+void ReSTIRPass::BeginStatistics(RenderContext* pRenderContext)
 {
-    if (!mpSampleBuffer)
+    if (!mpStatsFence) mpStatsFence = GpuFence::create();
+
+    // Collect the readbacks the GPU has finished, without waiting for the others.
+    uint64_t gpuValue = mpStatsFence->getGpuValue();
+    for (auto& readback : mStatsReadback)
+    {
+        if (!readback.pending || readback.fenceValue > gpuValue) continue;
+
+        // Each counter is a low and a high word, see ReSTIRStats.slang.
+        const uint32_t* pWords = static_cast<const uint32_t*>(readback.pBuffer->map(Buffer::MapType::Read));
+        uint64_t counters[ReSTIR::kStatsCounterCount];
+        for (uint32_t i = 0; i < ReSTIR::kStatsCounterCount; i++) counters[i] = pWords[2 * i] | ((uint64_t)pWords[2 * i + 1] << 32);
+        readback.pBuffer->unmap();
+
+        mStatistics.AddFrame(readback.frameIndex, readback.pixelCount, counters, readback.passTimings);
+        readback.pending = false;
+    }
+
+    if (!mCollectStatistics) return;
+
+    if (!mpStatsCounters)
     {
-        uint32_t sumSampleCount = mParams.frameDim.x * mParams.frameDim.y;
-        std::cout << mParams.frameDim.x << " " << mParams.frameDim.y;
-        mpSampleBuffer = Buffer::createStructured(mpReflectTypes["initialSampleBuffer"], sumSampleCount, Resource::BindFlags::ShaderResource | Resource::BindFlags::UnorderedAccess, Buffer::CpuAccess::None, nullptr, false);
+        mpStatsCounters = Buffer::createStructured(sizeof(uint32_t), 2 * ReSTIR::kStatsCounterCount, Resource::BindFlags::ShaderResource | Resource::BindFlags::UnorderedAccess, Buffer::CpuAccess::None, nullptr, false);
     }
-    if (!mpTemporalReservoir)
+    pRenderContext->clearUAV(mpStatsCounters->getUAV().get(), uint4(0));
+}
+
+void ReSTIRPass::EndStatistics(RenderContext* pRenderContext)
+{
+    if (!mCollectStatistics) return;
+
+    // Drop the frame if the slot is still waiting for the GPU.
+    StatsReadback& readback = mStatsReadback[mStatsSlot];
+    if (readback.pending) return;
+
+    if (!readback.pBuffer)
+    {
+        readback.pBuffer = Buffer::create(mpStatsCounters->getSize(), Resource::BindFlags::None, Buffer::CpuAccess::Read, nullptr);
+    }
+    pRenderContext->copyResource(readback.pBuffer.get(), mpStatsCounters.get());
+    readback.pending = true;
+    readback.frameIndex = mParams.frameCount;
+    readback.pixelCount = mParams.elemCount;
+    readback.passTimings = GetPassTimings();
+
+    // Submit so the fence sits right behind the copy, as for captures. Waiting for the next frame's submit would add a frame of latency.
+    pRenderContext->flush(false);
+    readback.fenceValue = mpStatsFence->gpuSignal(pRenderContext->getLowLevelData()->getCommandQueue());
+    mStatsSlot = (mStatsSlot + 1) % kStatsReadbackLatency;
+}
+
+std::vector<ReSTIR::PassTiming> ReSTIRPass::GetPassTimings() const
+{
+    // The profiler reports the events of its last resolved frame, a few frames behind the counters.
+    std::vector<ReSTIR::PassTiming> timings;
+    if (!Profiler::instance().isEnabled()) return timings;
+
+    const std::string prefix = "ReStir::";
+    for (const Profiler::Event* pEvent : Profiler::instance().getEvents())
+    {
+        const std::string name = pEvent->getName();
+        size_t pos = name.rfind(prefix);
+        if (pos == std::string::npos || name.find('/', pos) != std::string::npos) continue;
+        timings.push_back({ name.substr(pos + prefix.size()), pEvent->getGpuTime(), pEvent->getCpuTime() });
+    }
+    return timings;
+}
+
+void ReSTIRPass::ExportStatistics()
+{
+    if (mStatisticsOutputPath.empty() || mStatistics.IsEmpty()) return;
+
+    if (!mStatistics.WriteCsv(mStatisticsOutputPath + ".csv") || !mStatistics.WriteJson(mStatisticsOutputPath + ".json"))
+    {
+        logWarning("ReSTIRPass: failed to write statistics to '{}'.", mStatisticsOutputPath);
+    }
+}
+
+uint32_t ReSTIRPass::GetCaptureFlags() const
+{
+    uint32_t flags = 0;
+    if (mFuseInitialSampling) flags |= ReSTIR::kCaptureFusedInitialSampling;
+    if (mTiledSpatialReuse) flags |= ReSTIR::kCaptureTiledSpatialReuse;
+    if (mAdaptiveSpatialReuse) flags |= ReSTIR::kCaptureAdaptiveSpatialReuse;
+    if (mTemporalReprojectionMode == (uint32_t)TemporalReprojectionMode::MotionVectors) flags |= ReSTIR::kCaptureMotionVectorReprojection;
+    return flags;
+}
+
+void ReSTIRPass::BeginCapture(RenderContext* pRenderContext)
+{
+    if (mParams.frameCount == mCaptureFrame) mCaptureRequested = true;
+    if (!mCaptureRequested || mCapture.pending || mCaptureWrite.valid()) return;
+    mCaptureRequested = false;
+
+    // initialReservoirs may share its allocation with the spatial reservoirs, so it is copied before resampling.
+    uint64_t reservoirBytes = (uint64_t)mParams.elemCount * mpTemporalReservoir->getStructSize();
+    mCapture = CaptureReadback();
+    mCapture.pInitialReservoirs = Buffer::create(reservoirBytes, Resource::BindFlags::None, Buffer::CpuAccess::Read, nullptr);
+    pRenderContext->copyBufferRegion(mCapture.pInitialReservoirs.get(), 0, mpInitialReserovir.get(), 0, reservoirBytes);
+    mCapture.pending = true;
+}
+
+void ReSTIRPass::EndCapture(RenderContext* pRenderContext, const RenderData& renderData)
+{
+    if (!mCapture.pending || mCapture.fenceValue != 0) return;
+
+    FALCOR_PROFILE("ReStir::capture");
+
+    // Every temporal slot, they are elemCount apart.
+    uint32_t stride = mpTemporalReservoir->getStructSize();
+    uint64_t reservoirBytes = (uint64_t)mParams.elemCount * stride;
+    uint64_t temporalBytes = mReservoirRing.GetSlotCount() * reservoirBytes;
+    mCapture.pTemporalReservoirs = Buffer::create(temporalBytes, Resource::BindFlags::None, Buffer::CpuAccess::Read, nullptr);
+    mCapture.pSpatialReservoirs = Buffer::create(reservoirBytes, Resource::BindFlags::None, Buffer::CpuAccess::Read, nullptr);
+    pRenderContext->copyBufferRegion(mCapture.pTemporalReservoirs.get(), 0, mpTemporalReservoir.get(), 0, temporalBytes);
+    pRenderContext->copyBufferRegion(mCapture.pSpatialReservoirs.get(), 0, mpSpatialReservoir.get(), 0, reservoirBytes);
+
+    std::vector<std::string> channels = { kInputVBuffer, kInputeMotionVec, kInputDepthBuffer, kInputNormBuffer };
+    for (const auto& channel : SampleChannel) channels.push_back(channel.name);
+    for (const auto& name : channels)
+    {
+        auto pTexture = renderData.getTexture(name);
+        if (!pTexture) continue;
+        mCapture.textures.push_back({ name, pTexture->getFormat(), pTexture->getWidth(), pTexture->getHeight(), pRenderContext->asyncReadTextureSubresource(pTexture.get(), 0) });
+    }
+
+    // The history the frame read, the motion vector reprojection needs it to replay the same resets.
+    if (mHistoryValid)
+    {
+        const auto& pHistory = mpHistory[mParams.temLastOffset];
+        mCapture.textures.push_back({ kCaptureHistoryName, pHistory->getFormat(), pHistory->getWidth(), pHistory->getHeight(), pRenderContext->asyncReadTextureSubresource(pHistory.get(), 0) });
+    }
+
+    // The state the frame ran with, before the temporal slots are swapped.
+    auto& header = mCapture.writer.GetHeader();
+    header.frameIndex = mParams.frameCount;
+    header.width = mParams.frameDim.x;
+    header.height = mParams.frameDim.y;
+    header.temCurOffset = mParams.temCurOffset;
+    header.temLastOffset = mParams.temLastOffset;
+    header.temporalSlotCount = mReservoirRing.GetSlotCount();
+    header.reservoirStride = stride;
+    header.flags = GetCaptureFlags();
+    mCapture.writer.AddSection(ReSTIR::CaptureSectionType::Params, "params", sizeof(mParams), &mParams, sizeof(mParams));
+
+    auto pCamera = mpScene->getCamera();
+    glm::float4x4 viewProj = pCamera->getViewProjMatrixNoJitter();
+    float3 position = pCamera->getPosition();
+    ReSTIR::CaptureCamera camera = {};
+    std::memcpy(camera.prevViewProj, &mPrevViewProj[0][0], sizeof(camera.prevViewProj));
+    std::memcpy(camera.viewProj, &viewProj[0][0], sizeof(camera.viewProj));
+    for (int i = 0; i < 3; i++)
+    {
+        camera.prevPosition[i] = cameraPrePos[i];
+        camera.position[i] = position[i];
+    }
+    mCapture.writer.AddSection(ReSTIR::CaptureSectionType::Camera, "camera", sizeof(camera), &camera, sizeof(camera));
+
+    mCapture.path = (mCapturePath.empty() ? std::string("ReSTIRCapture") : mCapturePath) + "_" + std::to_string(mParams.frameCount) + ".rstc";
+
+    // Captures are rare, submitting here puts the fence right behind the copies instead of a frame later.
+    if (!mpCaptureFence) mpCaptureFence = GpuFence::create();
+    pRenderContext->flush(false);
+    mCapture.fenceValue = mpCaptureFence->gpuSignal(pRenderContext->getLowLevelData()->getCommandQueue());
+}
+
+void ReSTIRPass::PollCapture()
+{
+    if (mCaptureWrite.valid() && mCaptureWrite.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        if (mCaptureWrite.get()) mCaptureStatus = "Wrote " + mCapture.path;
+        else
+        {
+            mCaptureStatus = "Failed to write " + mCapture.path;
+            logWarning("ReSTIRPass: failed to write capture '{}'.", mCapture.path);
+        }
+    }
+
+    if (!mCapture.pending || mCapture.fenceValue == 0 || mCapture.fenceValue > mpCaptureFence->getGpuValue()) return;
+
+    auto& writer = mCapture.writer;
+    uint32_t stride = writer.GetHeader().reservoirStride;
+    auto addReservoirs = [&](Buffer::SharedPtr& pBuffer, ReSTIR::CaptureSectionType type, const std::string& name)
+    {
+        const void* pData = pBuffer->map(Buffer::MapType::Read);
+        writer.AddSection(type, name, stride, pData, pBuffer->getSize());
+        pBuffer->unmap();
+        pBuffer = nullptr;
+    };
+    addReservoirs(mCapture.pInitialReservoirs, ReSTIR::CaptureSectionType::InitialReservoirs, "initialReservoirs");
+    addReservoirs(mCapture.pTemporalReservoirs, ReSTIR::CaptureSectionType::TemporalReservoirs, "temporalReservoirBuffer");
+    addReservoirs(mCapture.pSpatialReservoirs, ReSTIR::CaptureSectionType::SpatialReservoirs, "spatialReservoirBuffer");
+
+    for (const auto& texture : mCapture.textures)
+    {
+        // The texture copies were submitted before the fence, getData does not wait.
+        std::vector<uint8_t> data = texture.pTask->getData();
+        uint32_t texelSize = getFormatBytesPerBlock(texture.format);
+        if (data.size() != (size_t)texture.width * texture.height * texelSize)
+        {
+            logWarning("ReSTIRPass: skipping channel '{}' of the capture, unexpected readback size.", texture.name);
+            continue;
+        }
+        writer.AddTexture(texture.name, GetCaptureFormat(texture.format), texelSize, texture.width, texture.height, data.data());
+    }
+    mCapture.textures.clear();
+    mCapture.pending = false;
+
+    mCaptureStatus = "Writing " + mCapture.path;
+    mCaptureWrite = std::async(std::launch::async, [writer = std::move(writer), path = mCapture.path]() { return writer.Write(path); });
+}
+
+bool ReSTIRPass::LoadCapture(const std::string& path)
+{
+    auto fail = [&](const std::string& error)
+    {
+        mCaptureStatus = "Replay failed: " + error;
+        logWarning("ReSTIRPass: {}", mCaptureStatus);
+        return false;
+    };
+
+    ReSTIR::ReservoirCaptureReader reader;
+    if (!reader.Open(path, true)) return fail(reader.GetError());
+
+    const auto& header = reader.GetHeader();
+    if (header.width != mParams.frameDim.x || header.height != mParams.frameDim.y)
+    {
+        return fail(path + " is " + std::to_string(header.width) + "x" + std::to_string(header.height) + ", the frame is " +
+            std::to_string(mParams.frameDim.x) + "x" + std::to_string(mParams.frameDim.y));
+    }
+
+    const ReSTIR::CaptureSectionEntry* pParams = reader.FindSection(ReSTIR::CaptureSectionType::Params);
+    const ReSTIR::CaptureSectionEntry* pCamera = reader.FindSection(ReSTIR::CaptureSectionType::Camera);
+    size_t temporalCount = 0;
+    const ReSTIR::Reservoir* pTemporal = reader.GetReservoirs(ReSTIR::CaptureSectionType::TemporalReservoirs, temporalCount);
+    if (!pParams || pParams->size != sizeof(mParams) || !pCamera || !pTemporal) return fail(path + " has no params, camera or temporal reservoirs of this version");
+    if (mpTemporalReservoir->getStructSize() != header.reservoirStride) return fail(path + " has a different reservoir layout");
+    if (header.temporalSlotCount != mReservoirRing.GetSlotCount() || temporalCount != (size_t)header.temporalSlotCount * mParams.elemCount)
+    {
+        return fail(path + " has " + std::to_string(header.temporalSlotCount) + " temporal slots, the ring has " + std::to_string(mReservoirRing.GetSlotCount()));
+    }
+
+    if (header.flags != GetCaptureFlags()) logWarning("ReSTIRPass: '{}' was captured with other pass options, the replay will differ.", path);
+
+    // Restore the state the captured frame started from. The frame does not write the temporal slot it reads from.
+    std::memcpy(&mParams, reader.GetSectionData(*pParams), sizeof(mParams));
+    mReservoirRing.Restore(mParams.temCurOffset, mParams.temLastOffset);
+    mpTemporalReservoir->setBlob(pTemporal, 0, temporalCount * sizeof(ReSTIR::Reservoir));
+
+    const auto& camera = *static_cast<const ReSTIR::CaptureCamera*>(reader.GetSectionData(*pCamera));
+    std::memcpy(&mPrevViewProj[0][0], camera.prevViewProj, sizeof(camera.prevViewProj));
+    cameraPrePos = float3(camera.prevPosition[0], camera.prevPosition[1], camera.prevPosition[2]);
+
+    // Without a captured history the first replayed frame rejects every motion vector reprojection.
+    const ReSTIR::CaptureSectionEntry* pHistory = reader.FindSection(ReSTIR::CaptureSectionType::Texture, kCaptureHistoryName);
+    mHistoryValid = pHistory && !mpHistory.empty() && pHistory->width == header.width && pHistory->height == header.height && pHistory->elementSize == 2 * sizeof(uint32_t);
+    if (mHistoryValid) gpDevice->getRenderContext()->updateTextureData(mpHistory[mParams.temLastOffset].get(), reader.GetSectionData(*pHistory));
+
+    mCaptureStatus = "Replaying frame " + std::to_string(header.frameIndex) + " of " + path;
+    return true;
+}
+
+void ReSTIRPass::CreateEmissiveSampler(RenderContext* pRenderContext)
+{
+    mpEmissiveSampler = nullptr;
+    if (!mpScene->useEmissiveLights()) return;
+
+    switch ((LightSamplerMode)mLightSamplerMode)
+    {
+    case LightSamplerMode::Power: mpEmissiveSampler = EmissivePowerSampler::create(pRenderContext, mpScene); break;
+    case LightSamplerMode::LightBVH: mpEmissiveSampler = LightBVHSampler::create(pRenderContext, mpScene); break;
+    default: mpEmissiveSampler = EmissiveUniformSampler::create(pRenderContext, mpScene); break;
+    }
+}
+
+void ReSTIRPass::UpdateLightSamplers(RenderContext* pRenderContext)
+{
+    FALCOR_PROFILE("ReStir::updateLightSamplers");
+
+    auto updates = mpScene->getUpdates();
+    if (mLightSamplerDirty || is_set(updates, Scene::UpdateFlags::LightCountChanged) || is_set(updates, Scene::UpdateFlags::LightIntensityChanged) ||
+        is_set(updates, Scene::UpdateFlags::LightPropertiesChanged) || is_set(updates, Scene::UpdateFlags::LightCollectionChanged))
+    {
+        mLightTablesDirty = true;
+    }
+
+    // Uniform sampling reads neither the table nor the powers, they are built once another mode is selected.
+    // The analytic table is built on the thread pool while this thread builds or refits the light BVH, which Falcor does on one thread.
+    std::future<double> tableBuild;
+    if (mLightTablesDirty && mLightSamplerMode != (uint32_t)LightSamplerMode::Uniform) tableBuild = BuildAnalyticLightTable();
+
+    auto start = std::chrono::steady_clock::now();
+    if (mLightSamplerDirty)
+    {
+        mLightSamplerDirty = false;
+        CreateEmissiveSampler(pRenderContext);
+    }
+    // Builds or refits the light BVH, the programs pick up the sampler defines when they bind their vars.
+    if (mpEmissiveSampler) mpEmissiveSampler->update(pRenderContext);
+    double samplerTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    if (tableBuild.valid()) FinishLightTables(pRenderContext, tableBuild.get(), samplerTime);
+}
+
+std::future<double> ReSTIRPass::BuildAnalyticLightTable()
+{
+    mLightTablesDirty = false;
+
+    float sceneRadius = 0.5f * glm::length(mpScene->getSceneBounds().extent());
+    const auto& lights = mpScene->getActiveLights();
+    std::vector<float> weights(lights.size());
+    for (size_t i = 0; i < lights.size(); i++) weights[i] = GetAnalyticLightPower(lights[i]->getData(), sceneRadius);
+
+    if (!mpThreadPool) mpThreadPool = std::make_unique<ReSTIR::CpuThreadPool>();
+    return std::async(std::launch::async, [this, weights = std::move(weights)]()
+    {
+        auto start = std::chrono::steady_clock::now();
+        mAnalyticLightTable.Build(weights, mpThreadPool.get());
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    });
+}
+
+void ReSTIRPass::FinishLightTables(RenderContext* pRenderContext, double tableTime, double samplerTime)
+{
+    mAnalyticLightPower = (float)mAnalyticLightTable.GetWeightSum();
+
+    const auto& entries = mAnalyticLightTable.GetEntries();
+    mpAnalyticLightTable = entries.empty() ? nullptr :
+        Buffer::createStructured(sizeof(ReSTIR::LightAliasEntry), (uint32_t)entries.size(), Resource::BindFlags::ShaderResource, Buffer::CpuAccess::None, entries.data(), false);
+
+    // The triangle fluxes are integrated by the light collection.
+    mEmissiveLightPower = 0.f;
+    if (mpScene->useEmissiveLights())
+    {
+        for (const auto& triangle : mpScene->getLightCollection(pRenderContext)->getMeshLightTriangles(pRenderContext)) mEmissiveLightPower += triangle.flux;
+    }
+
+    mLightSamplingReport = "Analytic lights: " + std::to_string(entries.size()) + ", table built in " + std::to_string(tableTime) + " ms on " +
+        std::to_string(mpThreadPool->GetWorkerCount()) + " threads\n";
+    mLightSamplingReport += "Emissive sampler update alongside: " + std::to_string(samplerTime) + " ms\n";
+    mLightSamplingReport += "Emissive power: " + std::to_string(mEmissiveLightPower) + "\nAnalytic power: " + std::to_string(mAnalyticLightPower);
+}
+
+void ReSTIRPass::BindLightSamplers(const ShaderVar& pathtracer)
+{
+    if (mpEnvMapSampler) mpEnvMapSampler->setShaderData(pathtracer["envMapSampler"]);
+    if (mpEmissiveSampler) mpEmissiveSampler->setShaderData(pathtracer["emissiveSampler"]);
+    pathtracer["analyticLightTable"] = mpAnalyticLightTable;
+    pathtracer["lightSamplerMode"] = mLightSamplerMode;
+    pathtracer["emissiveLightPower"] = mEmissiveLightPower;
+    pathtracer["analyticLightPower"] = mAnalyticLightPower;
+}
+
+void ReSTIRPass::InitSampleBuffer()
+{
+    if (mParams.elemCount == 0) return;
+
+    // Buffers only grow, a smaller resolution sub-allocates the existing ones. Reservoir slots are elemCount apart.
+    bool grow = mParams.elemCount > mReservoirCapacity;
+    if (grow) mReservoirCapacity = mParams.elemCount;
+
+    uint32_t sumTemporalReservoir = mReservoirRing.GetSlotCount() * mReservoirCapacity;
+    if (!mpTemporalReservoir || mpTemporalReservoir->getElementCount() != sumTemporalReservoir)
     {
-        uint32_t sumTemporalReservoir = 2 * mParams.frameDim.x * mParams.frameDim.y;
         mpTemporalReservoir = Buffer::createStructured(mpReflectTypes["temporalReservoirBuffer"], sumTemporalReservoir, Resource::BindFlags::ShaderResource | Resource::BindFlags::UnorderedAccess, Buffer::CpuAccess::None, nullptr, false);
     }
-    if (!mpSpatialReservoir)
+    mReservoirDim = mParams.frameDim;
+
+    // The transient buffers hold no history, they are simply planned again.
+    AllocateTransientBuffers();
+}
+
+void ReSTIRPass::AllocateTransientBuffers()
+{
+    mTransientBuffersDirty = false;
+    if (mReservoirCapacity == 0) return;
+
+    // Temporal and spatial reuse share a stage unless they run as separate dispatches.
+    ReSTIR::ResourceLifetimePlanner planner;
+    uint32_t initialStage = planner.AddStage("initial sampling");
+    uint32_t temporalStage = planner.AddStage(mAdaptiveSpatialReuse ? "temporal reuse" : "resampling");
+    uint32_t confidenceStage = mAdaptiveSpatialReuse ? planner.AddStage("confidence") : temporalStage;
+    uint32_t spatialStage = mAdaptiveSpatialReuse ? planner.AddStage("spatial reuse") : temporalStage;
+    uint32_t finalStage = planner.AddStage("final shading");
+
+    const uint64_t capacity = mReservoirCapacity;
+    const uint64_t reservoirSize = sizeof(ReSTIR::Reservoir);
+
+    uint32_t initialIndex = planner.AddResource({ "initialReservoirs", capacity * reservoirSize, initialStage, temporalStage, "Reservoir" });
+    planner.AddResource({ "temporalReservoirBuffer", mReservoirRing.GetSlotCount() * capacity * reservoirSize, initialStage, finalStage, "Reservoir", true });
+    uint32_t spatialIndex = planner.AddResource({ "spatialReservoirBuffer", capacity * reservoirSize, spatialStage, finalStage, "Reservoir" });
+    uint32_t confidenceIndex = planner.AddResource({ "gConfidence", capacity * sizeof(float), confidenceStage, spatialStage, "float", false, mAdaptiveSpatialReuse });
+    uint32_t pixelListIndex = planner.AddResource({ "gPixelLists", capacity * kConfidenceClassCount * sizeof(uint32_t), confidenceStage, spatialStage, "uint", false, mAdaptiveSpatialReuse });
+    bool useMaterialBins = mFinalShadingMode == (uint32_t)FinalShadingMode::MaterialBinned;
+    uint32_t pixelBinIndex = planner.AddResource({ "gPixelBins", capacity * sizeof(uint32_t), finalStage, finalStage, "uint", false, useMaterialBins });
+    uint32_t pixelRankIndex = planner.AddResource({ "gPixelRanks", capacity * sizeof(uint32_t), finalStage, finalStage, "uint", false, useMaterialBins });
+    uint32_t sortedPixelIndex = planner.AddResource({ "gSortedPixels", capacity * sizeof(uint32_t), finalStage, finalStage, "uint", false, useMaterialBins });
+    planner.AddResource({ "radianceCache", mRadianceCacheCapacity * kRadianceCacheEntrySize, initialStage, initialStage, "RadianceCache", true, mUseRadianceCache });
+    bool useHistory = mTemporalReprojectionMode == (uint32_t)TemporalReprojectionMode::MotionVectors;
+    planner.AddResource({ "temporalHistory", mReservoirRing.GetSlotCount() * (uint64_t)mParams.elemCount * 2 * sizeof(uint32_t), temporalStage, temporalStage, "History", true, useHistory });
+
+    ReSTIR::ResourcePlan plan = planner.Plan();
+
+    auto bindFlags = Resource::BindFlags::ShaderResource | Resource::BindFlags::UnorderedAccess;
+    std::vector<Buffer::SharedPtr> allocations(plan.allocations.size());
+    for (size_t i = 0; i < plan.allocations.size(); i++)
+    {
+        const auto& allocation = plan.allocations[i];
+        if (allocation.persistent) continue;
+        if (allocation.aliasGroup == "Reservoir")
+        {
+            allocations[i] = Buffer::createStructured(mpReflectTypes["initialReservoirs"], (uint32_t)(allocation.size / reservoirSize), bindFlags, Buffer::CpuAccess::None, nullptr, false);
+        }
+        else
+        {
+            allocations[i] = Buffer::createStructured(sizeof(uint32_t), (uint32_t)(allocation.size / sizeof(uint32_t)), bindFlags, Buffer::CpuAccess::None, nullptr, false);
+        }
+    }
+    auto getBuffer = [&](uint32_t index) { return plan.allocationOf[index] == ReSTIR::ResourcePlan::kSkipped ? nullptr : allocations[plan.allocationOf[index]]; };
+
+    mpInitialReserovir = getBuffer(initialIndex);
+    mpSpatialReservoir = getBuffer(spatialIndex);
+    mpConfidence = getBuffer(confidenceIndex);
+    mpPixelLists = getBuffer(pixelListIndex);
+    mpPixelBins = getBuffer(pixelBinIndex);
+    mpPixelRanks = getBuffer(pixelRankIndex);
+    mpSortedPixels = getBuffer(sortedPixelIndex);
+
+    // The cache is in world space and keeps its entries over resolution changes.
+    bool cacheAllocated = mpCacheChecksums && mpCacheChecksums->getElementCount() == mRadianceCacheCapacity;
+    if (!mUseRadianceCache)
+    {
+        mpCacheChecksums = mpCacheAccumulation = mpCacheRadiance = mpCacheAges = nullptr;
+    }
+    else if (!cacheAllocated)
     {
-        uint32_t sumSpatialReservoir = 2 * mParams.frameDim.x * mParams.frameDim.y;
-        mpSpatialReservoir = Buffer::createStructured(mpReflectTypes["spatialReservoirBuffer"], sumSpatialReservoir, Resource::BindFlags::ShaderResource | Resource::BindFlags::UnorderedAccess, Buffer::CpuAccess::None, nullptr, false);
+        mpCacheChecksums = Buffer::createStructured(sizeof(uint32_t), mRadianceCacheCapacity, bindFlags, Buffer::CpuAccess::None, nullptr, false);
+        mpCacheAccumulation = Buffer::createStructured(sizeof(uint32_t), 4 * mRadianceCacheCapacity, bindFlags, Buffer::CpuAccess::None, nullptr, false);
+        mpCacheRadiance = Buffer::createStructured(4 * sizeof(float), mRadianceCacheCapacity, bindFlags, Buffer::CpuAccess::None, nullptr, false);
+        mpCacheAges = Buffer::createStructured(sizeof(uint32_t), mRadianceCacheCapacity, bindFlags, Buffer::CpuAccess::None, nullptr, false);
+        mClearRadianceCache = true;
     }
-    if(!mpInitialReserovir)
+    mParams.cacheCapacity = mUseRadianceCache ? mRadianceCacheCapacity : 0;
+
+    // The history is not resampled on a resize, the first frame after it rejects every history and starts over.
+    const uint32_t slotCount = mReservoirRing.GetSlotCount();
+    bool historyAllocated = mpHistory.size() == slotCount && mpHistory[0]->getWidth() == mParams.frameDim.x && mpHistory[0]->getHeight() == mParams.frameDim.y;
+    if (!useHistory)
     {
-        uint32_t sumSampleCount = mParams.frameDim.x * mParams.frameDim.y;
-        mpInitialReserovir = Buffer::createStructured(mpReflectTypes["initialReservoirs"], sumSampleCount, Resource::BindFlags::ShaderResource | Resource::BindFlags::UnorderedAccess, Buffer::CpuAccess::None, nullptr, false);
+        mpHistory.clear();
+        mHistoryValid = false;
     }
+    else if (!historyAllocated)
+    {
+        mpHistory.resize(slotCount);
+        for (auto& pHistory : mpHistory) pHistory = Texture::create2D(mParams.frameDim.x, mParams.frameDim.y, ResourceFormat::RG32Uint, 1, 1, nullptr, bindFlags);
+        mHistoryValid = false;
+    }
+
+    mMemoryReport = planner.FormatReport(plan, mParams.frameDim.x, mParams.frameDim.y);
+    if (mReservoirCapacity > mParams.elemCount)
+    {
+        mMemoryReport += "Sized for " + std::to_string(mReservoirCapacity) + " pixels, the frame uses " + std::to_string(mParams.elemCount) + "\n";
+    }
+}
+
+void ReSTIRPass::ResizeReservoirs(RenderContext* pRenderContext)
+{
+    if (mpTemporalReservoir && mReservoirDim == mParams.frameDim) return;
+
+    FALCOR_PROFILE("ReStir::resizeReservoirs");
+
+    bool keepHistory = mpTemporalReservoir && mParams.frameCount > 0 && mReservoirDim.x > 0 && mReservoirDim.y > 0 && mParams.elemCount > 0;
+    if (!keepHistory)
+    {
+        InitSampleBuffer();
+        return;
+    }
+
+    // The newest temporal reservoirs are in the last slot after the swap at the end of execute().
+    uint2 srcDim = mReservoirDim;
+    uint32_t srcCount = srcDim.x * srcDim.y;
+    uint32_t srcOffset = mParams.temLastOffset * srcCount;
+    Buffer::SharedPtr pSrc = mpTemporalReservoir;
+
+    if (mParams.elemCount <= mReservoirCapacity)
+    {
+        // The history is rewritten in place, move it out of the way first.
+        uint32_t stride = mpTemporalReservoir->getStructSize();
+        pSrc = Buffer::createStructured(mpReflectTypes["temporalReservoirBuffer"], srcCount, Resource::BindFlags::ShaderResource, Buffer::CpuAccess::None, nullptr, false);
+        pRenderContext->copyBufferRegion(pSrc.get(), 0, mpTemporalReservoir.get(), (uint64_t)srcOffset * stride, (uint64_t)srcCount * stride);
+        srcOffset = 0;
+    }
+
+    InitSampleBuffer();
+
+    auto vars = mpReservoirResizePass->getRootVar();
+    vars["ResizeCB"]["srcDim"] = srcDim;
+    vars["ResizeCB"]["dstDim"] = mParams.frameDim;
+    vars["ResizeCB"]["srcOffset"] = srcOffset;
+    vars["ResizeCB"]["dstOffset"] = mParams.temLastOffset * mParams.elemCount;
+    vars["srcReservoirs"] = pSrc;
+    vars["dstReservoirs"] = mpTemporalReservoir;
+    mpReservoirResizePass->execute(pRenderContext, uint3(mParams.frameDim.x, mParams.frameDim.y, 1u));
+}
+
+void ReSTIRPass::UpdateReservoirRing(RenderContext* pRenderContext)
+{
+    if (!mpRingFence) mpRingFence = GpuFence::create();
+
+    // The frame recorded last has been submitted by now, put a fence behind it.
+    mReservoirRing.Signal(mpRingFence->gpuSignal(pRenderContext->getLowLevelData()->getCommandQueue()));
+
+    if (mReservoirRing.GetSlotCount() != mReservoirSlotCount)
+    {
+        // The history does not carry over, the temporal reservoirs and histories are allocated again for the new ring.
+        mReservoirRing.Reset(mReservoirSlotCount);
+        mParams.temCurOffset = mReservoirRing.GetCurrentSlot();
+        mParams.temLastOffset = mReservoirRing.GetPreviousSlot();
+        mpTemporalReservoir = nullptr;
+        mHistoryValid = false;
+        ResizeReservoirs(pRenderContext);
+        // The new buffer holds undefined data, every slot starts empty and the frame count restarts as after a scene change.
+        pRenderContext->clearUAV(mpTemporalReservoir->getUAV().get(), uint4(0));
+        mParams.frameCount = 0;
+    }
+
+    // The frames run in order on one queue, so the current slot is safe to write. Initial sampling on an async queue
+    // would have to wait in the frames counted here.
+    mRingFrames++;
+    if (!mReservoirRing.IsWritable(mReservoirRing.GetCurrentSlot(), mpRingFence->getGpuValue())) mRingBusyWrites++;
+}
+
+void ReSTIRPass::UpdateRingSimulation()
+{
+    ReSTIR::RingSimulationDesc serialDesc = mRingSimulation;
+    serialDesc.framesAhead = 0;
+    ReSTIR::RingSimulationResult serial = ReSTIR::SimulateReservoirRing(serialDesc);
+    ReSTIR::RingSimulationResult pipelined = ReSTIR::SimulateReservoirRing(mRingSimulation);
+    std::string error = ReSTIR::ValidateRingSchedule(pipelined);
+
+    mRingSimulationReport = "One queue: " + std::to_string(serial.frameInterval) + " ms per frame\n";
+    mRingSimulationReport += std::to_string(pipelined.framesAhead) + " frames ahead on " + std::to_string(pipelined.slotCount) + " slots: " +
+        std::to_string(pipelined.frameInterval) + " ms per frame, latency " + std::to_string(pipelined.latency) + " ms\n";
+    mRingSimulationReport += "Both queues busy " + std::to_string(100.0 * pipelined.overlap) + "% of the time, " + std::to_string(pipelined.slotStalls) + " slot stalls";
+    if (!error.empty()) mRingSimulationReport += "\nInvalid schedule: " + error;
 }
 
 void ReSTIRPass::InitSampleInitialPass()
@@ -312,16 +1577,32 @@ void ReSTIRPass::InitSampleInitialPass()
     defines.add("USE_ENV_LIGHT", mpScene && mpScene->useEnvLight() ? "1" : "0");
     defines.add("PATH_MAX_BOUNCES", std::to_string(kMaxRecursionDepth));
     if (mpEmissiveSampler) defines.add(mpEmissiveSampler->getDefines());
-    mSampleInitialPass.mProgram = RtProgram::create(desc, defines);
-
-    mSampleInitialPass.mVars = RtProgramVars::create(mSampleInitialPass.mProgram, mSampleInitialPass.mBindTable);
+    auto permutation = GetPermutationDesc(kSampleInitialPassPath, { "RayGen", "ScatterMiss", "ScatterTriangleClosestHit", "ScatterTriangleAnyHit" }, defines, true);
+    mSampleInitialPass.mProgram = GetRtProgram(desc, permutation, defines);
+    mSampleInitialPass.mVars = nullptr;
 }
 
 void ReSTIRPass::InitSpatialtemporalResamplePass()
 {
     auto defines = mpSampleGenerator->getDefines();
     defines.add(mpScene->getSceneDefines());
-    mSpatialtemporalResamplePass = ComputePass::create(Program::Desc(kSpatialTemporalResamplePassPath).setShaderModel(kShaderModel).csEntry("main").addTypeConformances(mpScene->getTypeConformances()), defines);
+    defines.add("RESTIR_STATS", mCollectStatistics ? "1" : "0");
+    defines.add("TILED_SPATIAL_REUSE", mTiledSpatialReuse ? "1" : "0");
+    mSpatialtemporalResamplePass = GetComputePass(kSpatialTemporalResamplePassPath, "main", defines, true);
+    mpTemporalResamplePass = GetComputePass(kSpatialTemporalResamplePassPath, "temporalMain", defines, true);
+    mpAdaptiveSpatialPass = GetComputePass(kSpatialTemporalResamplePassPath, "spatialMain", defines, true);
+
+    Program::DefineList confidenceDefines = { { "RESTIR_STATS", mCollectStatistics ? "1" : "0" } };
+    mpConfidencePass = GetComputePass(kReservoirConfidencePassPath, "classifyMain", confidenceDefines, false);
+    mpAdaptiveArgsPass = GetComputePass(kReservoirConfidencePassPath, "argsMain", confidenceDefines, false);
+}
+
+void ReSTIRPass::UpdateResampleDefines()
+{
+    // The defines are part of the permutation key, the passes are looked up again instead of changing the ones in the cache.
+    if (mpScene) InitSpatialtemporalResamplePass();
+    // Not cached, only this pass uses it.
+    mpRadianceCacheResolvePass->addDefine("RESTIR_STATS", mCollectStatistics ? "1" : "0");
 }
 
 void ReSTIRPass::InitFinalShadingPass()
@@ -339,6 +1620,15 @@ void ReSTIRPass::InitFinalShadingPass()
     mFinalShadingPass.mBindTable->setMiss(0, desc.addMiss("ScatterMiss"));
     mFinalShadingPass.mBindTable->setHitGroup(0, mpScene->getGeometryIDs(Scene::GeometryType::TriangleMesh), desc.addHitGroup("ScatterTriangleClosestHit", "ScatterTriangleAnyHit"));
 
+    auto defines = GetFinalShadingDefines();
+    auto permutation = GetPermutationDesc(kFinalShadingPassPath, { "RayGen", "ScatterMiss", "ScatterTriangleClosestHit", "ScatterTriangleAnyHit" }, defines, true);
+    mFinalShadingPass.mProgram = GetRtProgram(desc, permutation, defines);
+
+    mFinalShadingPass.mVars = RtProgramVars::create(mFinalShadingPass.mProgram, mFinalShadingPass.mBindTable);
+}
+
+Program::DefineList ReSTIRPass::GetFinalShadingDefines() const
+{
     auto defines = mpScene->getSceneDefines();
     defines.add(mpSampleGenerator->getDefines());
     if (mpEmissiveSampler) defines.add(mpEmissiveSampler->getDefines());
@@ -346,7 +1636,96 @@ void ReSTIRPass::InitFinalShadingPass()
     defines.add("USE_EMISSIVE_LIGHTS", mpScene && mpScene->useEmissiveLights() ? "1" : "0");
     defines.add("USE_ENV_LIGHT", mpScene && mpScene->useEnvLight() ? "1" : "0");
     defines.add("PATH_MAX_BOUNCES", std::to_string(kMaxRecursionDepth));
-    mFinalShadingPass.mProgram = RtProgram::create(desc, defines);
+    return defines;
+}
 
-    mFinalShadingPass.mVars = RtProgramVars::create(mFinalShadingPass.mProgram, mFinalShadingPass.mBindTable);
+ReSTIR::ShaderPermutationDesc ReSTIRPass::GetPermutationDesc(const std::string& path, const std::vector<std::string>& entryPoints, const Program::DefineList& defines, bool useSceneTypes) const
+{
+    ReSTIR::ShaderPermutationDesc permutation;
+    permutation.programName = std::filesystem::path(path).filename().string() + ":" + entryPoints.front();
+    permutation.sources = { path };
+    permutation.entryPoints = entryPoints;
+    permutation.shaderModel = kShaderModel;
+    for (const auto& [name, value] : defines) permutation.defines.emplace_back(name, value);
+    if (useSceneTypes)
+    {
+        for (const auto& [conformance, id] : mpScene->getTypeConformances())
+        {
+            permutation.typeConformances.emplace_back(conformance.first, conformance.second + "#" + std::to_string(id));
+        }
+    }
+    permutation.sourceHash = mShaderSourceHash;
+    permutation.toolchain = kShaderToolchain;
+    return permutation;
+}
+
+ComputePass::SharedPtr ReSTIRPass::GetComputePass(const std::string& path, const std::string& entryPoint, const Program::DefineList& defines, bool useSceneTypes)
+{
+    auto permutation = GetPermutationDesc(path, { entryPoint }, defines, useSceneTypes);
+    uint64_t key = ReSTIR::ComputePermutationKey(permutation);
+
+    auto it = mComputePassCache.find(key);
+    if (mReusePrograms && it != mComputePassCache.end())
+    {
+        mPermutationCounters.reused++;
+        return it->second;
+    }
+
+    Program::Desc desc(path);
+    desc.setShaderModel(kShaderModel).csEntry(entryPoint);
+    if (useSceneTypes) desc.addTypeConformances(mpScene->getTypeConformances());
+    auto pPass = ComputePass::create(desc, defines);
+    CompileAndLogPermutation(permutation, key, pPass->getProgram());
+    if (mReusePrograms) mComputePassCache[key] = pPass;
+    return pPass;
+}
+
+RtProgram::SharedPtr ReSTIRPass::GetRtProgram(const RtProgram::Desc& desc, const ReSTIR::ShaderPermutationDesc& permutation, const Program::DefineList& defines)
+{
+    ReSTIR::ShaderPermutationDesc rtPermutation = permutation;
+    rtPermutation.options.push_back("payload=" + std::to_string(kMaxPayloadSizeBytes));
+    rtPermutation.options.push_back("attributes=" + std::to_string(mpScene->getRaytracingMaxAttributeSize()));
+    rtPermutation.options.push_back("recursion=" + std::to_string(kMaxRecursionDepth));
+    uint64_t key = ReSTIR::ComputePermutationKey(rtPermutation);
+
+    auto it = mRtProgramCache.find(key);
+    if (mReusePrograms && it != mRtProgramCache.end())
+    {
+        // The vars are created again by the caller, the binding table follows the geometry of the new scene.
+        mPermutationCounters.reused++;
+        return it->second;
+    }
+
+    auto pProgram = RtProgram::create(desc, defines);
+    CompileAndLogPermutation(rtPermutation, key, pProgram);
+    if (mReusePrograms) mRtProgramCache[key] = pProgram;
+    return pProgram;
+}
+
+void ReSTIRPass::CompileAndLogPermutation(const ReSTIR::ShaderPermutationDesc& permutation, uint64_t key, const Program::SharedPtr& pProgram)
+{
+    bool known = mpShaderCompileLog && mpShaderCompileLog->Find(key);
+
+    // Compile here rather than in the first frame that runs the program, so the log gets the compile time.
+    auto start = std::chrono::steady_clock::now();
+    pProgram->getActiveVersion();
+    double compileTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    mPermutationCounters.compiled++;
+    mPermutationCounters.compileTime += compileTime;
+    if (known) mPermutationCounters.known++;
+    else if (mpShaderCompileLog) mpShaderCompileLog->Append({ key, compileTime, permutation.programName });
+}
+
+void ReSTIRPass::UpdateShaderPermutationReport()
+{
+    const auto& counters = mPermutationCounters;
+    mShaderPermutationReport = "Programs reused: " + std::to_string(counters.reused) + "\n";
+    mShaderPermutationReport += "Programs compiled: " + std::to_string(counters.compiled) + " in " + std::to_string(counters.compileTime) + " ms\n";
+    mShaderPermutationReport += "Compiled in an earlier run: " + std::to_string(counters.known) + "\n";
+    mShaderPermutationReport += "Programs held: " + std::to_string(mComputePassCache.size() + mRtProgramCache.size()) + "\n";
+    if (mpShaderCompileLog)
+    {
+        mShaderPermutationReport += "Compile log: " + mpShaderCompileLog->GetPath().string() + ", " + std::to_string(mpShaderCompileLog->GetRecordCount()) + " permutations";
+    }
 }
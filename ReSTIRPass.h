@@ -28,11 +28,21 @@
 #pragma once
 #include "Falcor.h"
 #include "Utils/Sampling/SampleGenerator.h"
- //#include "Rendering/Lights/LightBVHSampler.h"
- //#include "Rendering/Lights/EmissivePowerSampler.h"
+#include "Rendering/Lights/LightBVHSampler.h"
+#include "Rendering/Lights/EmissivePowerSampler.h"
 #include "Rendering/Lights/EmissiveUniformSampler.h"
 #include "Rendering/Lights/EnvMapSampler.h"
 #include "ReSTIRParams.slang"
+#include "ReSTIRStats.h"
+#include "ResourceLifetimePlanner.h"
+#include "ReservoirCapture.h"
+#include "LightAliasTable.h"
+#include "CpuThreadPool.h"
+#include "ShaderPermutationLog.h"
+#include "ReservoirRingScheduler.h"
+#include "MaterialBinning.h"
+#include <future>
+#include <unordered_map>
 
 using namespace Falcor;
 
@@ -50,6 +60,8 @@ public:
     */
     static SharedPtr create(RenderContext* pRenderContext = nullptr, const Dictionary& dict = {});
 
+    virtual ~ReSTIRPass();
+
     virtual Dictionary getScriptingDictionary() override;
     virtual RenderPassReflection reflect(const CompileData& compileData) override;
     virtual void compile(RenderContext* pRenderContext, const CompileData& compileData) override;
@@ -60,33 +72,128 @@ public:
     virtual bool onKeyEvent(const KeyboardEvent& keyEvent) override { return false; }
 
 private:
-    ReSTIRPass();
+    ReSTIRPass(const Dictionary& dict);
+
+    void ParseDictionary(const Dictionary& dict);
 
     void InitSampleBuffer();
+    void AllocateTransientBuffers();
+    void ResizeReservoirs(RenderContext* pRenderContext);
+    void UpdateReservoirRing(RenderContext* pRenderContext);
+    void UpdateRingSimulation();
     void InitSampleInitialPass();
     void InitSpatialtemporalResamplePass();
     void InitFinalShadingPass();
+    Program::DefineList GetFinalShadingDefines() const;
+
+    ReSTIR::ShaderPermutationDesc GetPermutationDesc(const std::string& path, const std::vector<std::string>& entryPoints, const Program::DefineList& defines, bool useSceneTypes) const;
+    ComputePass::SharedPtr GetComputePass(const std::string& path, const std::string& entryPoint, const Program::DefineList& defines, bool useSceneTypes);
+    RtProgram::SharedPtr GetRtProgram(const RtProgram::Desc& desc, const ReSTIR::ShaderPermutationDesc& permutation, const Program::DefineList& defines);
+    void CompileAndLogPermutation(const ReSTIR::ShaderPermutationDesc& permutation, uint64_t key, const Program::SharedPtr& pProgram);
+    void UpdateShaderPermutationReport();
 
     void InitialReservoirPass(RenderContext* pRenderContext, const RenderData& renderData);
     void SampleInitialPass(RenderContext* pRenderContext, const RenderData& renderData);
+    void ResolveRadianceCache(RenderContext* pRenderContext);
     void SpatialtemporalResamplePass(RenderContext* pRenderContext, const RenderData& renderData);
+    void AdaptiveResamplePass(RenderContext* pRenderContext, const RenderData& renderData);
+    void BindResampleVars(const ShaderVar& vars, const RenderData& renderData);
+    void UpdateResampleDefines();
     void FinalShadingPass(RenderContext* pRenderContext, const RenderData& renderdata);
-    //void SetSamplers(RenderContext* pRenderContext);
+    void MaterialBinnedShadingPass(RenderContext* pRenderContext, const RenderData& renderData);
+    void PollMaterialBinCheck();
+
+    void BeginStatistics(RenderContext* pRenderContext);
+    void EndStatistics(RenderContext* pRenderContext);
+    std::vector<ReSTIR::PassTiming> GetPassTimings() const;
+    void ExportStatistics();
+
+    void BeginCapture(RenderContext* pRenderContext);
+    void EndCapture(RenderContext* pRenderContext, const RenderData& renderData);
+    void PollCapture();
+    bool LoadCapture(const std::string& path);
+    uint32_t GetCaptureFlags() const;
+
+    void CreateEmissiveSampler(RenderContext* pRenderContext);
+    void UpdateLightSamplers(RenderContext* pRenderContext);
+    std::future<double> BuildAnalyticLightTable();
+    void FinishLightTables(RenderContext* pRenderContext, double tableTime, double samplerTime);
+    void BindLightSamplers(const ShaderVar& pathtracer);
 
     RenderingRuntimeParams mParams;
+    bool mFuseInitialSampling = false;      ///< Trace the initial samples in this pass instead of reading them from the sample channels.
+    bool mTiledSpatialReuse = false;        ///< Spatial reuse through groupshared memory, see SpatialResampleTiled. Neighbours are read at PackedReservoir precision.
+    bool mAdaptiveSpatialReuse = false;     ///< Neighbor count and radius per pixel from the confidence pre-pass.
+    bool mUseRadianceCache = false;         ///< End the initial sample paths in the world space radiance cache, fused sampling only.
+    uint32_t mRadianceCacheCapacity = 1u << 20; ///< Entries, a power of two.
+    uint32_t mTemporalReprojectionMode = (uint32_t)TemporalReprojectionMode::Legacy; ///< Requested mode, mParams holds the one in use. MotionVectors is opt-in.
+    uint32_t mFinalShadingMode = (uint32_t)FinalShadingMode::RayTracing;   ///< MaterialBinned is opt-in.
 
     SampleGenerator::SharedPtr mpSampleGenerator;
     EnvMapSampler::SharedPtr mpEnvMapSampler;
     EmissiveLightSampler::SharedPtr mpEmissiveSampler;
 
+    // Light sampling. The analytic light alias table and the light type powers are rebuilt on the host when the lights change.
+    uint32_t mLightSamplerMode = (uint32_t)LightSamplerMode::Uniform;
+    bool mLightSamplerDirty = false;        ///< The mode changed, the emissive sampler is created again.
+    bool mLightTablesDirty = true;          ///< The lights changed, BuildAnalyticLightTable has to run again.
+    ReSTIR::LightAliasTable mAnalyticLightTable;
+    Buffer::SharedPtr mpAnalyticLightTable;
+    float mEmissiveLightPower = 0.f;
+    float mAnalyticLightPower = 0.f;
+    std::unique_ptr<ReSTIR::CpuThreadPool> mpThreadPool;    ///< Created with the first table build.
+    std::string mLightSamplingReport;
+
     ComputePass::SharedPtr mpInitialReservoirPass;
     ComputePass::SharedPtr mpReflectTypes;
     ComputePass::SharedPtr mSpatialtemporalResamplePass;
+    ComputePass::SharedPtr mpTemporalResamplePass;
+    ComputePass::SharedPtr mpAdaptiveSpatialPass;
+    ComputePass::SharedPtr mpConfidencePass;
+    ComputePass::SharedPtr mpAdaptiveArgsPass;
+    ComputePass::SharedPtr mpReservoirResizePass;
+    ComputePass::SharedPtr mpRadianceCacheResolvePass;
+    ComputePass::SharedPtr mpMaterialCountPass;     ///< Material binned final shading, created on first use.
+    ComputePass::SharedPtr mpMaterialScanPass;
+    ComputePass::SharedPtr mpMaterialScatterPass;
+    ComputePass::SharedPtr mpMaterialShadePass;
 
-    Buffer::SharedPtr mpSampleBuffer;
     Buffer::SharedPtr mpTemporalReservoir;
     Buffer::SharedPtr mpSpatialReservoir;
     Buffer::SharedPtr mpInitialReserovir;
+    Buffer::SharedPtr mpRayBudgetCounter;   ///< Bias correction rays taken from params.rayBudget this frame.
+    Buffer::SharedPtr mpConfidence;
+    Buffer::SharedPtr mpPixelLists;
+    Buffer::SharedPtr mpMaterialBinCounts;  ///< Pixels per material bin, sized for the materials of the scene + 1.
+    Buffer::SharedPtr mpPixelBins;
+    Buffer::SharedPtr mpPixelRanks;
+    Buffer::SharedPtr mpSortedPixels;
+    Buffer::SharedPtr mpAdaptiveState;
+    Buffer::SharedPtr mpAdaptiveDispatchArgs;
+    Buffer::SharedPtr mpCacheChecksums;
+    Buffer::SharedPtr mpCacheAccumulation;
+    Buffer::SharedPtr mpCacheRadiance;
+    Buffer::SharedPtr mpCacheAges;
+    bool mClearRadianceCache = false;       ///< The cache buffers are new or the scene changed.
+    std::vector<Texture::SharedPtr> mpHistory;  ///< Linear depth and normal per pixel, one per temporal reservoir slot.
+    bool mHistoryValid = false;             ///< The history of the last frame was written by the motion vector reprojection.
+
+    bool mTransientBuffersDirty = false;    ///< The lifetimes changed, AllocateTransientBuffers has to run again.
+    std::string mMemoryReport;
+
+    uint2 mReservoirDim = { 0, 0 };     ///< Frame size the reservoirs currently hold.
+    uint32_t mReservoirCapacity = 0;    ///< Reservoirs per slot the buffers were allocated for.
+
+    // Temporal reservoir slots. The ring picks temCurOffset and temLastOffset, a fence signaled behind every frame
+    // tells which slots the GPU still uses. The simulator models initial sampling on an async queue over the ring. The
+    // pass itself records every frame in order on the direct queue, so more than 2 slots have no effect but their memory.
+    uint32_t mReservoirSlotCount = ReSTIR::ReservoirRing::kMinSlots;   ///< Requested, the ring is reset and its slots cleared when it differs.
+    ReSTIR::ReservoirRing mReservoirRing;
+    GpuFence::SharedPtr mpRingFence;
+    uint64_t mRingFrames = 0;
+    uint64_t mRingBusyWrites = 0;           ///< Frames that wrote a slot an older frame in flight still used.
+    ReSTIR::RingSimulationDesc mRingSimulation;
+    std::string mRingSimulationReport;
 
     Scene::SharedPtr mpScene;
 
@@ -100,6 +207,102 @@ private:
     RtPass mSampleInitialPass;
     RtPass mFinalShadingPass;
 
+    // Program permutations. The programs are kept in memory by permutation key, so a scene or define set seen before in this
+    // session reuses its program, and a define change picks another entry instead of changing a cached one. The compile log
+    // on disk only records the permutations compiled so far and their compile times, nothing compiled is stored and every
+    // new run compiles again on the render thread.
+    struct ShaderPermutationCounters
+    {
+        uint32_t reused = 0;
+        uint32_t compiled = 0;
+        uint32_t known = 0;             ///< Compiled ones the log already recorded in an earlier run.
+        double compileTime = 0.0;       ///< Milliseconds.
+    };
+
+    bool mReusePrograms = true;
+    std::string mShaderCompileLogPath;      ///< A file in the temp directory if empty.
+    uint64_t mShaderSourceHash = 0;         ///< Hash of the shaders of this pass, part of every permutation key.
+    std::unique_ptr<ReSTIR::ShaderCompileLog> mpShaderCompileLog;
+    std::unordered_map<uint64_t, ComputePass::SharedPtr> mComputePassCache;
+    std::unordered_map<uint64_t, RtProgram::SharedPtr> mRtProgramCache;
+    ShaderPermutationCounters mPermutationCounters;
+    std::string mShaderPermutationReport;
+
     glm::float4x4 mPrevViewProj;
     float3 cameraPrePos;
+
+    // Reservoir statistics. The 64 bit counters are copied to a ring of readback buffers and mapped once a fence shows the copy finished.
+    static const uint32_t kStatsReadbackLatency = 3;
+
+    struct StatsReadback
+    {
+        Buffer::SharedPtr pBuffer;
+        uint64_t fenceValue = 0;
+        uint64_t frameIndex = 0;
+        uint32_t pixelCount = 0;
+        std::vector<ReSTIR::PassTiming> passTimings;
+        bool pending = false;
+    };
+
+    bool mCollectStatistics = false;
+    std::string mStatisticsOutputPath;
+    Buffer::SharedPtr mpStatsCounters;
+    GpuFence::SharedPtr mpStatsFence;
+    StatsReadback mStatsReadback[kStatsReadbackLatency];
+    uint32_t mStatsSlot = 0;
+    ReSTIR::StatsAggregator mStatistics;
+
+    // Frame capture. The reservoirs and inputs are copied to readback buffers during the frame, collected once a fence
+    // shows the copies finished and written to disk by a worker thread.
+    static const uint32_t kNoCaptureFrame = 0xffffffffu;
+
+    struct CaptureTexture
+    {
+        std::string name;
+        ResourceFormat format = ResourceFormat::Unknown;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        CopyContext::ReadTextureTask::SharedPtr pTask;
+    };
+
+    struct CaptureReadback
+    {
+        Buffer::SharedPtr pInitialReservoirs;
+        Buffer::SharedPtr pTemporalReservoirs;
+        Buffer::SharedPtr pSpatialReservoirs;
+        std::vector<CaptureTexture> textures;
+        ReSTIR::ReservoirCaptureWriter writer;          ///< Header, params and camera, the buffers are added on collection.
+        std::string path;
+        uint64_t fenceValue = 0;
+        bool pending = false;
+    };
+
+    std::string mCapturePath;               ///< Captures are written to <path>_<frame>.rstc.
+    uint32_t mCaptureFrame = kNoCaptureFrame;   ///< params.frameCount to capture from a script.
+    bool mCaptureRequested = false;
+    CaptureReadback mCapture;
+    GpuFence::SharedPtr mpCaptureFence;
+    std::future<bool> mCaptureWrite;
+    std::string mCaptureStatus;
+
+    // Material bin check. The bins of one frame are read back and compared with the CPU binning of MaterialBinning.cpp.
+    struct BinCheckReadback
+    {
+        Buffer::SharedPtr pOffsets;
+        Buffer::SharedPtr pPixelBins;
+        Buffer::SharedPtr pSortedPixels;
+        uint32_t binCount = 0;
+        uint32_t width = 0;
+        uint32_t pixelCount = 0;
+        uint64_t fenceValue = 0;        ///< Signaled behind the copies.
+        bool pending = false;
+    };
+
+    bool mBinCheckRequested = false;
+    BinCheckReadback mBinCheck;
+    GpuFence::SharedPtr mpBinCheckFence;
+    std::string mMaterialBinReport;
+
+    std::string mReplayPath;                ///< Capture whose state is restored before the next frame.
+    bool mReplayPending = false;
 };
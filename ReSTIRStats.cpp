@@ -0,0 +1,240 @@
+#include "ReSTIRStats.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace ReSTIR
+{
+    namespace
+    {
+        const char* kCounterNames[] =
+        {
+            "temporalPixels",
+            "temporalResetReprojection",
+            "temporalResetDistance",
+            "temporalResetAge",
+            "temporalMSum",
+            "spatialPixels",
+            "neighborsTested",
+            "neighborsRejectedSimilarity",
+            "neighborsMerged",
+            "visibilityRays",
+            "spatialMSum",
+            "mergeRays",
+            "unbiasedRays",
+            "reuseVisibilityRays",
+            "reusedVisibilityTests",
+            "budgetFallbackPixels",
+            "initialSamples",
+            "convergedPixels",
+            "lowConfidencePixels",
+            "pathRays",
+            "cacheHits",
+            "cacheEvictions",
+            "temporalResetDisocclusion",
+            "temporalSearchHits",
+        };
+        static_assert(sizeof(kCounterNames) / sizeof(kCounterNames[0]) == kStatsCounterCount, "Counter names out of date");
+
+        double Ratio(uint64_t a, uint64_t b)
+        {
+            return b > 0 ? (double)a / (double)b : 0.0;
+        }
+
+        struct DerivedValue
+        {
+            const char* name;
+            double (FrameStatistics::*getter)() const;
+        };
+
+        const DerivedValue kDerivedValues[] =
+        {
+            { "temporalResetRate", &FrameStatistics::GetTemporalResetRate },
+            { "historyAcceptanceRate", &FrameStatistics::GetHistoryAcceptanceRate },
+            { "searchHitRate", &FrameStatistics::GetSearchHitRate },
+            { "averageTemporalM", &FrameStatistics::GetAverageTemporalM },
+            { "averageSpatialM", &FrameStatistics::GetAverageSpatialM },
+            { "similarityRejectRate", &FrameStatistics::GetSimilarityRejectRate },
+            { "raysPerPixel", &FrameStatistics::GetRaysPerPixel },
+            { "budgetFallbackRate", &FrameStatistics::GetBudgetFallbackRate },
+            { "initialSampleRate", &FrameStatistics::GetInitialSampleRate },
+            { "pathRaysPerSample", &FrameStatistics::GetPathRaysPerSample },
+            { "cacheHitRate", &FrameStatistics::GetCacheHitRate },
+        };
+
+        const PassTiming* FindTiming(const FrameStatistics& frame, const std::string& name)
+        {
+            for (const auto& timing : frame.passTimings) if (timing.name == name) return &timing;
+            return nullptr;
+        }
+
+        bool WriteFile(const std::string& path, const std::string& text)
+        {
+            std::ofstream file(path, std::ios::binary);
+            if (!file) return false;
+            file << text;
+            return (bool)file;
+        }
+    }
+
+    const char* GetStatsCounterName(StatsCounter counter)
+    {
+        uint32_t index = (uint32_t)counter;
+        return index < kStatsCounterCount ? kCounterNames[index] : "unknown";
+    }
+
+    double FrameStatistics::GetTemporalResetRate() const
+    {
+        uint64_t resets = Get(StatsCounter::TemporalResetReprojection) + Get(StatsCounter::TemporalResetDistance) + Get(StatsCounter::TemporalResetAge) +
+            Get(StatsCounter::TemporalResetDisocclusion);
+        return Ratio(resets, Get(StatsCounter::TemporalPixels));
+    }
+
+    double FrameStatistics::GetHistoryAcceptanceRate() const
+    {
+        return Get(StatsCounter::TemporalPixels) > 0 ? 1.0 - GetTemporalResetRate() : 0.0;
+    }
+
+    double FrameStatistics::GetSearchHitRate() const
+    {
+        return Ratio(Get(StatsCounter::TemporalSearchHits), Get(StatsCounter::TemporalPixels));
+    }
+
+    double FrameStatistics::GetAverageTemporalM() const
+    {
+        return Ratio(Get(StatsCounter::TemporalMSum), Get(StatsCounter::TemporalPixels));
+    }
+
+    double FrameStatistics::GetAverageSpatialM() const
+    {
+        return Ratio(Get(StatsCounter::SpatialMSum), Get(StatsCounter::SpatialPixels));
+    }
+
+    double FrameStatistics::GetSimilarityRejectRate() const
+    {
+        return Ratio(Get(StatsCounter::NeighborsRejectedSimilarity), Get(StatsCounter::NeighborsTested));
+    }
+
+    double FrameStatistics::GetRaysPerPixel() const
+    {
+        return Ratio(Get(StatsCounter::VisibilityRays), pixelCount);
+    }
+
+    double FrameStatistics::GetBudgetFallbackRate() const
+    {
+        return Ratio(Get(StatsCounter::BudgetFallbackPixels), Get(StatsCounter::SpatialPixels));
+    }
+
+    double FrameStatistics::GetInitialSampleRate() const
+    {
+        return Ratio(Get(StatsCounter::InitialSamples), pixelCount);
+    }
+
+    double FrameStatistics::GetPathRaysPerSample() const
+    {
+        return Ratio(Get(StatsCounter::PathRays), Get(StatsCounter::InitialSamples));
+    }
+
+    double FrameStatistics::GetCacheHitRate() const
+    {
+        return Ratio(Get(StatsCounter::CacheHits), Get(StatsCounter::InitialSamples));
+    }
+
+    void StatsAggregator::AddFrame(uint64_t frameIndex, uint32_t pixelCount, const uint64_t* counters, const std::vector<PassTiming>& passTimings)
+    {
+        FrameStatistics frame;
+        frame.frameIndex = frameIndex;
+        frame.pixelCount = pixelCount;
+        for (uint32_t i = 0; i < kStatsCounterCount; i++) frame.counters[i] = counters[i];
+        frame.passTimings = passTimings;
+        for (const auto& timing : passTimings)
+        {
+            if (std::find(mTimingNames.begin(), mTimingNames.end(), timing.name) == mTimingNames.end()) mTimingNames.push_back(timing.name);
+        }
+        mFrames.push_back(std::move(frame));
+
+        if (mMaxFrameCount > 0 && mFrames.size() > mMaxFrameCount) mFrames.erase(mFrames.begin(), mFrames.end() - mMaxFrameCount);
+    }
+
+    void StatsAggregator::SetMaxFrameCount(size_t maxFrameCount)
+    {
+        mMaxFrameCount = maxFrameCount;
+        if (mMaxFrameCount > 0 && mFrames.size() > mMaxFrameCount) mFrames.erase(mFrames.begin(), mFrames.end() - mMaxFrameCount);
+    }
+
+    FrameStatistics StatsAggregator::GetTotal() const
+    {
+        FrameStatistics total;
+        for (const auto& frame : mFrames)
+        {
+            total.pixelCount += frame.pixelCount;
+            for (uint32_t i = 0; i < kStatsCounterCount; i++) total.counters[i] += frame.counters[i];
+        }
+        if (!mFrames.empty()) total.frameIndex = mFrames.back().frameIndex;
+        return total;
+    }
+
+    std::string StatsAggregator::ToCsv() const
+    {
+        std::ostringstream ss;
+        ss << "frame,pixelCount";
+        for (uint32_t i = 0; i < kStatsCounterCount; i++) ss << "," << kCounterNames[i];
+        for (const auto& derived : kDerivedValues) ss << "," << derived.name;
+        for (const auto& name : mTimingNames) ss << "," << name << "GpuMs," << name << "CpuMs";
+        ss << "\n";
+
+        for (const auto& frame : mFrames)
+        {
+            ss << frame.frameIndex << "," << frame.pixelCount;
+            for (uint32_t i = 0; i < kStatsCounterCount; i++) ss << "," << frame.counters[i];
+            for (const auto& derived : kDerivedValues) ss << "," << (frame.*derived.getter)();
+            // frames without the scope leave the cells empty
+            for (const auto& name : mTimingNames)
+            {
+                if (const PassTiming* timing = FindTiming(frame, name)) ss << "," << timing->gpuMs << "," << timing->cpuMs;
+                else ss << ",,";
+            }
+            ss << "\n";
+        }
+        return ss.str();
+    }
+
+    std::string StatsAggregator::ToJson() const
+    {
+        std::ostringstream ss;
+        ss << "{\n  \"counters\": [";
+        for (uint32_t i = 0; i < kStatsCounterCount; i++) ss << (i ? ", " : "") << "\"" << kCounterNames[i] << "\"";
+        ss << "],\n  \"frames\": [";
+
+        for (size_t f = 0; f < mFrames.size(); f++)
+        {
+            const auto& frame = mFrames[f];
+            ss << (f ? "," : "") << "\n    { \"frame\": " << frame.frameIndex << ", \"pixelCount\": " << frame.pixelCount;
+            for (uint32_t i = 0; i < kStatsCounterCount; i++) ss << ", \"" << kCounterNames[i] << "\": " << frame.counters[i];
+            for (const auto& derived : kDerivedValues) ss << ", \"" << derived.name << "\": " << (frame.*derived.getter)();
+            if (!frame.passTimings.empty())
+            {
+                ss << ", \"passTimings\": {";
+                for (size_t t = 0; t < frame.passTimings.size(); t++)
+                {
+                    const auto& timing = frame.passTimings[t];
+                    ss << (t ? ", " : " ") << "\"" << timing.name << "\": { \"gpuMs\": " << timing.gpuMs << ", \"cpuMs\": " << timing.cpuMs << " }";
+                }
+                ss << " }";
+            }
+            ss << " }";
+        }
+        ss << "\n  ]\n}\n";
+        return ss.str();
+    }
+
+    bool StatsAggregator::WriteCsv(const std::string& path) const
+    {
+        return WriteFile(path, ToCsv());
+    }
+
+    bool StatsAggregator::WriteJson(const std::string& path) const
+    {
+        return WriteFile(path, ToJson());
+    }
+}
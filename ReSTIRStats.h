@@ -0,0 +1,112 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ReSTIR
+{
+    /** Counters filled by the resampling shaders. The indices must match ReSTIRStats.slang.
+    */
+    enum class StatsCounter : uint32_t
+    {
+        TemporalPixels = 0,             ///< Pixels running temporal resampling.
+        TemporalResetReprojection,      ///< Histories dropped because the reprojection failed.
+        TemporalResetDistance,          ///< Histories dropped by the world space distance test.
+        TemporalResetAge,               ///< Histories dropped because the sample was too old.
+        TemporalMSum,                   ///< Sum of M of the temporal reservoirs after merging.
+        SpatialPixels,                  ///< Pixels running spatial resampling.
+        NeighborsTested,                ///< Neighbours inside the frame.
+        NeighborsRejectedSimilarity,    ///< Neighbours rejected by CompareSimilarity.
+        NeighborsMerged,                ///< Neighbours merged into the spatial reservoir.
+        VisibilityRays,                 ///< Visibility rays traced by spatial reuse.
+        SpatialMSum,                    ///< Sum of M of the spatial reservoirs.
+        MergeRays,                      ///< Visibility rays traced while merging neighbours.
+        UnbiasedRays,                   ///< Bias correction rays traced in BiasCorrectionMode::Unbiased.
+        ReuseVisibilityRays,            ///< Bias correction rays traced in BiasCorrectionMode::ReuseVisibility.
+        ReusedVisibilityTests,          ///< Bias correction rays skipped by reusing the merge results.
+        BudgetFallbackPixels,           ///< Pixels that ran out of ray budget and fell back to the biased M.
+        InitialSamples,                 ///< Pixels that traced a new initial sample, only counted with fused initial sampling.
+        ConvergedPixels,                ///< Pixels classified as converged by the adaptive spatial reuse.
+        LowConfidencePixels,            ///< Pixels classified as low confidence by the adaptive spatial reuse.
+        PathRays,                       ///< Rays traced past the sample point to compute the initial sample radiance.
+        CacheHits,                      ///< Initial sample paths ended by the radiance cache.
+        CacheEvictions,                 ///< Radiance cache cells evicted by age.
+        TemporalResetDisocclusion,      ///< Histories dropped by the depth and normal test of the motion vector reprojection.
+        TemporalSearchHits,             ///< Histories found in the neighbourhood of a rejected motion vector reprojection.
+
+        Count
+    };
+
+    constexpr uint32_t kStatsCounterCount = (uint32_t)StatsCounter::Count;
+
+    const char* GetStatsCounterName(StatsCounter counter);
+
+    /** Time of one profiled scope of the pass, in milliseconds.
+    */
+    struct PassTiming
+    {
+        std::string name;
+        double gpuMs = 0.0;
+        double cpuMs = 0.0;
+    };
+
+    /** Counters of one frame plus the rates derived from them.
+    */
+    struct FrameStatistics
+    {
+        uint64_t frameIndex = 0;
+        uint64_t pixelCount = 0;                ///< Summed over the frames in StatsAggregator::GetTotal, so 64 bits like the counters.
+        std::array<uint64_t, kStatsCounterCount> counters = {};
+        std::vector<PassTiming> passTimings;    ///< Empty when the profiler was off.
+
+        uint64_t Get(StatsCounter counter) const { return counters[(uint32_t)counter]; }
+
+        double GetTemporalResetRate() const;        ///< Fraction of temporal histories dropped for any reason.
+        double GetHistoryAcceptanceRate() const;    ///< Fraction of temporal histories kept, 1 - GetTemporalResetRate().
+        double GetSearchHitRate() const;            ///< Fraction of temporal histories found by the neighbourhood search.
+        double GetAverageTemporalM() const;
+        double GetAverageSpatialM() const;
+        double GetSimilarityRejectRate() const;     ///< Fraction of tested neighbours rejected by CompareSimilarity.
+        double GetRaysPerPixel() const;
+        double GetBudgetFallbackRate() const;       ///< Fraction of spatial pixels that fell back to the biased M.
+        double GetInitialSampleRate() const;        ///< Fraction of pixels that traced a new initial sample.
+        double GetPathRaysPerSample() const;        ///< Rays past the sample point per initial sample.
+        double GetCacheHitRate() const;             ///< Fraction of initial samples whose path ended in the radiance cache.
+    };
+
+    /** Collects the per frame counters read back from the GPU and exports them as CSV or JSON.
+        Pure C++ so it can be used on counter data that does not come from a GPU.
+    */
+    class StatsAggregator
+    {
+    public:
+        /** Add the counters of a frame.
+            \param[in] counters kStatsCounterCount values in StatsCounter order.
+            \param[in] passTimings Profiler times of the pass scopes, exported as <name>GpuMs and <name>CpuMs columns.
+        */
+        void AddFrame(uint64_t frameIndex, uint32_t pixelCount, const uint64_t* counters, const std::vector<PassTiming>& passTimings = {});
+
+        const std::vector<FrameStatistics>& GetFrames() const { return mFrames; }
+        bool IsEmpty() const { return mFrames.empty(); }
+        void Clear() { mFrames.clear(); mTimingNames.clear(); }
+
+        /** Counters summed over all frames, derived rates are averages weighted by pixel count.
+        */
+        FrameStatistics GetTotal() const;
+
+        /** Only the newest frames are kept, 0 keeps everything.
+        */
+        void SetMaxFrameCount(size_t maxFrameCount);
+
+        std::string ToCsv() const;
+        std::string ToJson() const;
+        bool WriteCsv(const std::string& path) const;
+        bool WriteJson(const std::string& path) const;
+
+    private:
+        std::vector<FrameStatistics> mFrames;
+        std::vector<std::string> mTimingNames;  ///< Union of the timed scopes in order of appearance, the CSV columns.
+        size_t mMaxFrameCount = 0;
+    };
+}
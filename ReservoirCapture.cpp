@@ -0,0 +1,397 @@
+#include "ReservoirCapture.h"
+#include "CpuGBuffer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ReSTIR
+{
+    namespace
+    {
+        uint64_t AlignUp(uint64_t value, uint64_t alignment)
+        {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        void CopyName(char (&dst)[32], const std::string& name)
+        {
+            std::memset(dst, 0, sizeof(dst));
+            std::memcpy(dst, name.data(), std::min(name.size(), sizeof(dst) - 1));
+        }
+
+        bool IsFinite(const Vec3& v)
+        {
+            return std::isfinite(v.x) && std::isfinite(v.y) && std::isfinite(v.z);
+        }
+
+        bool IsReservoirSection(CaptureSectionType type)
+        {
+            return type == CaptureSectionType::InitialReservoirs || type == CaptureSectionType::TemporalReservoirs || type == CaptureSectionType::SpatialReservoirs;
+        }
+    }
+
+    uint64_t CaptureChecksum(const void* data, size_t size)
+    {
+        const uint64_t kPrime = 1099511628211ull;
+        uint64_t hash = 14695981039346656037ull;
+
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        size_t wordCount = size / 8;
+        for (size_t i = 0; i < wordCount; i++)
+        {
+            uint64_t word;
+            std::memcpy(&word, bytes + i * 8, 8);
+            hash = (hash ^ word) * kPrime;
+        }
+        for (size_t i = wordCount * 8; i < size; i++) hash = (hash ^ bytes[i]) * kPrime;
+        return hash;
+    }
+
+    const char* GetCaptureSectionTypeName(CaptureSectionType type)
+    {
+        switch (type)
+        {
+        case CaptureSectionType::Params: return "params";
+        case CaptureSectionType::Camera: return "camera";
+        case CaptureSectionType::InitialReservoirs: return "initialReservoirs";
+        case CaptureSectionType::TemporalReservoirs: return "temporalReservoirs";
+        case CaptureSectionType::SpatialReservoirs: return "spatialReservoirs";
+        case CaptureSectionType::Texture: return "texture";
+        default: return "unknown";
+        }
+    }
+
+    void ReservoirCaptureWriter::AddSection(CaptureSectionType type, const std::string& name, uint32_t elementSize, const void* data, size_t size)
+    {
+        Section section;
+        section.entry.type = (uint32_t)type;
+        section.entry.elementSize = elementSize;
+        section.entry.width = (uint32_t)(size / elementSize);
+        section.entry.size = size;
+        CopyName(section.entry.name, name);
+        section.data.assign(static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+        mSections.push_back(std::move(section));
+    }
+
+    void ReservoirCaptureWriter::AddTexture(const std::string& name, CaptureFormat format, uint32_t elementSize, uint32_t width, uint32_t height, const void* data)
+    {
+        size_t size = (size_t)width * height * elementSize;
+        AddSection(CaptureSectionType::Texture, name, elementSize, data, size);
+        CaptureSectionEntry& entry = mSections.back().entry;
+        entry.format = (uint32_t)format;
+        entry.width = width;
+        entry.height = height;
+    }
+
+    bool ReservoirCaptureWriter::Write(const std::string& path) const
+    {
+        CaptureFileHeader header = mHeader;
+        std::memcpy(header.magic, kCaptureMagic, sizeof(header.magic));
+        header.version = kCaptureVersion;
+        header.headerSize = sizeof(CaptureFileHeader);
+        header.sectionCount = (uint32_t)mSections.size();
+        header.sectionAlignment = kCaptureSectionAlignment;
+        header.sectionTableOffset = sizeof(CaptureFileHeader);
+
+        std::vector<CaptureSectionEntry> table;
+        uint64_t offset = header.sectionTableOffset + mSections.size() * sizeof(CaptureSectionEntry);
+        for (const auto& section : mSections)
+        {
+            CaptureSectionEntry entry = section.entry;
+            entry.offset = AlignUp(offset, kCaptureSectionAlignment);
+            entry.checksum = CaptureChecksum(section.data.data(), section.data.size());
+            offset = entry.offset + entry.size;
+            table.push_back(entry);
+        }
+        header.fileSize = offset;
+
+        const std::string tempPath = path + ".tmp";
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            if (!file) return false;
+
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(CaptureSectionEntry));
+
+            const std::vector<char> padding(kCaptureSectionAlignment, 0);
+            uint64_t position = header.sectionTableOffset + table.size() * sizeof(CaptureSectionEntry);
+            for (size_t i = 0; i < mSections.size(); i++)
+            {
+                file.write(padding.data(), table[i].offset - position);
+                file.write(reinterpret_cast<const char*>(mSections[i].data.data()), mSections[i].data.size());
+                position = table[i].offset + table[i].size;
+            }
+            if (!file) return false;
+        }
+
+        std::remove(path.c_str());
+        return std::rename(tempPath.c_str(), path.c_str()) == 0;
+    }
+
+    bool ReservoirCaptureReader::Open(const std::string& path, bool verifyChecksums)
+    {
+        Close();
+
+        auto fail = [&](const std::string& error)
+        {
+            Close();
+            mError = path + ": " + error;
+            return false;
+        };
+
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return fail("cannot open the file");
+        mFile = file;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize)) return fail("cannot query the file size");
+        mSize = (size_t)fileSize.QuadPart;
+        if (mSize < sizeof(CaptureFileHeader)) return fail("file is smaller than the header");
+
+        mMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mMapping) return fail("cannot create a file mapping");
+        mpData = static_cast<const uint8_t*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+        if (!mpData) return fail("cannot map the file");
+#else
+        mFile = open(path.c_str(), O_RDONLY);
+        if (mFile < 0) return fail("cannot open the file");
+
+        struct stat fileStat;
+        if (fstat(mFile, &fileStat) != 0) return fail("cannot query the file size");
+        mSize = (size_t)fileStat.st_size;
+        if (mSize < sizeof(CaptureFileHeader)) return fail("file is smaller than the header");
+
+        void* pData = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, mFile, 0);
+        if (pData == MAP_FAILED) return fail("cannot map the file");
+        mpData = static_cast<const uint8_t*>(pData);
+#endif
+
+        const CaptureFileHeader& header = GetHeader();
+        if (std::memcmp(header.magic, kCaptureMagic, sizeof(kCaptureMagic)) != 0) return fail("not a reservoir capture");
+        if (header.version != kCaptureVersion) return fail("unsupported version " + std::to_string(header.version));
+        if (header.headerSize < sizeof(CaptureFileHeader)) return fail("header too small");
+        if (header.fileSize != mSize) return fail("file is truncated");
+        if (header.reservoirStride != sizeof(Reservoir)) return fail("reservoir stride " + std::to_string(header.reservoirStride) + " does not match the host layout");
+        if (header.temporalSlotCount == 0 || header.temCurOffset >= header.temporalSlotCount || header.temLastOffset >= header.temporalSlotCount)
+        {
+            return fail("temporal slots " + std::to_string(header.temCurOffset) + " and " + std::to_string(header.temLastOffset) + " are not below the slot count " + std::to_string(header.temporalSlotCount));
+        }
+        if (header.sectionAlignment == 0 || (header.sectionAlignment & (header.sectionAlignment - 1)) != 0) return fail("section alignment is not a power of two");
+        if (header.sectionTableOffset % alignof(CaptureSectionEntry) != 0 ||
+            header.sectionTableOffset > mSize ||
+            (mSize - header.sectionTableOffset) / sizeof(CaptureSectionEntry) < header.sectionCount)
+        {
+            return fail("section table out of bounds");
+        }
+
+        const uint64_t pixelCount = (uint64_t)header.width * header.height;
+        const CaptureSectionEntry* sections = GetSections();
+        for (uint32_t i = 0; i < header.sectionCount; i++)
+        {
+            const CaptureSectionEntry& entry = sections[i];
+            CaptureSectionType type = (CaptureSectionType)entry.type;
+            std::string name = "section " + std::to_string(i) + " (" + GetCaptureSectionTypeName(type) + ")";
+
+            if (std::memchr(entry.name, 0, sizeof(entry.name)) == nullptr) return fail(name + " has no terminated name");
+            if (entry.offset % header.sectionAlignment != 0) return fail(name + " is not aligned");
+            if (entry.offset > mSize || entry.size > mSize - entry.offset) return fail(name + " is out of bounds");
+            if (entry.elementSize == 0 || entry.size % entry.elementSize != 0) return fail(name + " is not a whole number of elements");
+
+            uint64_t elementCount = entry.size / entry.elementSize;
+            if (IsReservoirSection(type))
+            {
+                uint64_t expected = type == CaptureSectionType::TemporalReservoirs ? header.temporalSlotCount * pixelCount : pixelCount;
+                if (entry.elementSize != sizeof(Reservoir) || elementCount != expected) return fail(name + " does not hold one reservoir per pixel and slot");
+            }
+            else if (type == CaptureSectionType::Camera)
+            {
+                if (entry.size != sizeof(CaptureCamera)) return fail(name + " has the wrong size");
+            }
+            else if (type == CaptureSectionType::Texture)
+            {
+                if ((uint64_t)entry.width * entry.height != elementCount) return fail(name + " size does not match its dimensions");
+            }
+
+            if (verifyChecksums && CaptureChecksum(mpData + entry.offset, entry.size) != entry.checksum) return fail(name + " checksum mismatch");
+        }
+
+        mError.clear();
+        return true;
+    }
+
+    void ReservoirCaptureReader::Close()
+    {
+#ifdef _WIN32
+        if (mpData) UnmapViewOfFile(mpData);
+        if (mMapping) CloseHandle(mMapping);
+        if (mFile) CloseHandle(mFile);
+        mMapping = nullptr;
+        mFile = nullptr;
+#else
+        if (mpData) munmap(const_cast<uint8_t*>(mpData), mSize);
+        if (mFile >= 0) close(mFile);
+        mFile = -1;
+#endif
+        mpData = nullptr;
+        mSize = 0;
+    }
+
+    const CaptureSectionEntry* ReservoirCaptureReader::FindSection(CaptureSectionType type, const std::string& name) const
+    {
+        if (!IsOpen()) return nullptr;
+
+        const CaptureSectionEntry* sections = GetSections();
+        for (uint32_t i = 0; i < GetSectionCount(); i++)
+        {
+            if (sections[i].type != (uint32_t)type) continue;
+            if (name.empty() || name == sections[i].name) return &sections[i];
+        }
+        return nullptr;
+    }
+
+    const Reservoir* ReservoirCaptureReader::GetReservoirs(CaptureSectionType type, size_t& count) const
+    {
+        count = 0;
+        const CaptureSectionEntry* pEntry = IsReservoirSection(type) ? FindSection(type) : nullptr;
+        if (!pEntry) return nullptr;
+
+        count = (size_t)(pEntry->size / sizeof(Reservoir));
+        return static_cast<const Reservoir*>(GetSectionData(*pEntry));
+    }
+
+    const Reservoir* ReservoirCaptureReader::GetTemporalSlot(uint32_t slot) const
+    {
+        size_t count = 0;
+        const Reservoir* reservoirs = GetReservoirs(CaptureSectionType::TemporalReservoirs, count);
+        if (!reservoirs || slot >= GetHeader().temporalSlotCount) return nullptr;
+        return reservoirs + (size_t)slot * GetPixelCount();
+    }
+
+    bool ReservoirCaptureReader::LoadGBuffer(CpuGBuffer& gbuffer) const
+    {
+        if (!IsOpen()) return false;
+
+        const uint32_t width = GetHeader().width;
+        const uint32_t height = GetHeader().height;
+        const size_t pixelCount = (size_t)width * height;
+
+        auto findChannel = [&](const char* name, CaptureFormat format) -> const float*
+        {
+            const CaptureSectionEntry* pEntry = FindSection(CaptureSectionType::Texture, name);
+            if (!pEntry || pEntry->format != (uint32_t)format || pEntry->width != width || pEntry->height != height) return nullptr;
+            return static_cast<const float*>(GetSectionData(*pEntry));
+        };
+        auto loadVec3 = [&](const char* name, std::vector<Vec3>& plane)
+        {
+            const float* texels = findChannel(name, CaptureFormat::Float4);
+            if (!texels) return false;
+            plane.resize(pixelCount);
+            for (size_t i = 0; i < pixelCount; i++) plane[i] = Vec3(texels[4 * i], texels[4 * i + 1], texels[4 * i + 2]);
+            return true;
+        };
+        auto loadFloat = [&](const char* name, std::vector<float>& plane)
+        {
+            const float* texels = findChannel(name, CaptureFormat::Float);
+            if (!texels) return false;
+            plane.assign(texels, texels + pixelCount);
+            return true;
+        };
+
+        CpuGBuffer result;
+        result.width = width;
+        result.height = height;
+        bool complete = loadVec3("vPosW", result.vPosW) && loadVec3("vNormW", result.vNormW) &&
+            loadVec3("sPosW", result.sPosW) && loadVec3("sNormW", result.sNormW) &&
+            loadVec3("sColor", result.sColor) && loadFloat("random", result.random);
+        if (!complete) return false;
+
+        // The similarity planes are optional, but only as a pair.
+        if (!loadFloat("depth", result.depth) || !loadVec3("normW", result.normW))
+        {
+            result.depth.clear();
+            result.normW.clear();
+        }
+
+        gbuffer = std::move(result);
+        return true;
+    }
+
+    CaptureReservoirStats ComputeReservoirStats(const Reservoir* reservoirs, size_t count)
+    {
+        using Stats = CaptureReservoirStats;
+
+        Stats stats;
+        stats.count = count;
+
+        uint64_t weightCount = 0;
+        double weightSum = 0.0;
+        for (size_t i = 0; i < count; i++)
+        {
+            const Reservoir& r = reservoirs[i];
+            stats.mHistogram[std::min<uint32_t>(r.M, Stats::kMHistogramSize - 1)]++;
+
+            if (r.M == 0)
+            {
+                stats.emptyCount++;
+                continue;
+            }
+
+            bool valid = std::isfinite(r.weightF) && r.weightF >= 0.f && IsFinite(r.z.sPos) && IsFinite(r.z.radiance);
+            if (!valid)
+            {
+                stats.invalidCount++;
+                continue;
+            }
+
+            stats.mSum += r.M;
+            stats.mMax = std::max(stats.mMax, r.M);
+
+            double weight = r.weightF;
+            stats.weightMin = weightCount ? std::min(stats.weightMin, weight) : weight;
+            stats.weightMax = std::max(stats.weightMax, weight);
+            weightSum += weight;
+            weightCount++;
+
+            if (weight <= 0.0)
+            {
+                stats.zeroWeightCount++;
+                continue;
+            }
+            int32_t bin = (int32_t)std::floor(std::log2(weight)) - Stats::kWeightLog2Min;
+            bin = std::clamp(bin, 0, (int32_t)Stats::kWeightHistogramSize - 1);
+            stats.weightHistogram[bin]++;
+        }
+        stats.weightMean = weightCount ? weightSum / weightCount : 0.0;
+        return stats;
+    }
+
+    std::string CaptureReservoirStats::ToJson() const
+    {
+        std::ostringstream ss;
+        ss << "{ \"count\": " << count << ", \"empty\": " << emptyCount << ", \"invalid\": " << invalidCount;
+        ss << ", \"invalidFraction\": " << GetInvalidFraction() << ", \"averageM\": " << GetAverageM() << ", \"maxM\": " << mMax;
+        ss << ", \"weightMin\": " << weightMin << ", \"weightMax\": " << weightMax << ", \"weightMean\": " << weightMean;
+        ss << ", \"zeroWeight\": " << zeroWeightCount;
+        ss << ", \"mHistogram\": [";
+        for (uint32_t i = 0; i < kMHistogramSize; i++) ss << (i ? ", " : "") << mHistogram[i];
+        ss << "], \"weightLog2Min\": " << kWeightLog2Min << ", \"weightHistogram\": [";
+        for (uint32_t i = 0; i < kWeightHistogramSize; i++) ss << (i ? ", " : "") << weightHistogram[i];
+        ss << "] }";
+        return ss.str();
+    }
+}
@@ -0,0 +1,221 @@
+#pragma once
+#include "HostReservoir.h"
+#include <array>
+#include <string>
+#include <vector>
+
+/** Frame capture of the reservoir state of ReSTIRPass.
+
+    A capture file holds everything the resampling passes read in one frame: the runtime parameters, the camera of
+    the previous frame, the initial, temporal (every slot of the ring) and spatial reservoirs and the input G-buffer channels.
+    Layout, all values little endian:
+
+        CaptureFileHeader
+        CaptureSectionEntry[sectionCount]   at header.sectionTableOffset
+        section data                        every section starts at a multiple of header.sectionAlignment
+
+    Sections are page aligned so a mapped file can be read in place as arrays of Reservoir, float etc.
+*/
+namespace ReSTIR
+{
+    struct CpuGBuffer;
+
+    constexpr char kCaptureMagic[8] = { 'R', 'S', 'T', 'I', 'R', 'C', 'A', 'P' };
+    constexpr uint32_t kCaptureVersion = 2;
+    constexpr uint32_t kCaptureSectionAlignment = 4096;
+
+    enum class CaptureSectionType : uint32_t
+    {
+        Params = 1,             ///< RenderingRuntimeParams of the frame as a raw blob, layout of ReSTIRParams.slang.
+        Camera,                 ///< CaptureCamera.
+        InitialReservoirs,      ///< Reservoir per pixel, written by initial sampling.
+        TemporalReservoirs,     ///< Reservoir per pixel and slot, slot i starts at i * width * height.
+        SpatialReservoirs,      ///< Reservoir per pixel.
+        Texture,                ///< One input channel, texels in rows top to bottom, identified by its name.
+    };
+
+    /** Texel layout of a Texture section. Formats the reader does not interpret are stored as Raw.
+    */
+    enum class CaptureFormat : uint32_t
+    {
+        Raw = 0,
+        Float,
+        Float2,
+        Float4,
+        Uint2,
+    };
+
+    enum CaptureFlags : uint32_t
+    {
+        kCaptureFusedInitialSampling = 1u << 0,
+        kCaptureTiledSpatialReuse = 1u << 1,
+        kCaptureAdaptiveSpatialReuse = 1u << 2,
+        kCaptureMotionVectorReprojection = 1u << 3,
+    };
+
+    struct CaptureFileHeader
+    {
+        char magic[8];
+        uint32_t version = kCaptureVersion;
+        uint32_t headerSize = 0;            ///< sizeof(CaptureFileHeader), lets later versions append fields.
+        uint32_t sectionCount = 0;
+        uint32_t sectionAlignment = kCaptureSectionAlignment;
+        uint64_t sectionTableOffset = 0;
+        uint64_t fileSize = 0;
+        uint64_t frameIndex = 0;            ///< params.frameCount of the captured frame.
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t temCurOffset = 0;          ///< Temporal slot written by the captured frame.
+        uint32_t temLastOffset = 0;         ///< Temporal slot holding the history the frame read.
+        uint32_t reservoirStride = sizeof(Reservoir);
+        uint32_t flags = 0;                 ///< CaptureFlags.
+        uint32_t temporalSlotCount = 2;     ///< Slots of the reservoir ring, the TemporalReservoirs section holds this many per pixel.
+        uint32_t reserved = 0;
+    };
+
+    struct CaptureSectionEntry
+    {
+        uint32_t type = 0;                  ///< CaptureSectionType.
+        uint32_t format = 0;                ///< CaptureFormat of Texture sections, Raw otherwise.
+        uint32_t elementSize = 1;           ///< Bytes per element or texel.
+        uint32_t width = 0;                 ///< Texels per row of Texture sections, element count otherwise.
+        uint32_t height = 1;
+        uint32_t reserved = 0;
+        uint64_t offset = 0;                ///< From the start of the file.
+        uint64_t size = 0;                  ///< Bytes.
+        uint64_t checksum = 0;              ///< CaptureChecksum of the data.
+        char name[32] = {};
+    };
+
+    /** Matrices as glm stores them, column major.
+    */
+    struct CaptureCamera
+    {
+        float prevViewProj[16];             ///< The reprojection matrix the frame used.
+        float viewProj[16];
+        float prevPosition[3];              ///< cameraPrePos the frame used.
+        float position[3];
+    };
+
+    static_assert(sizeof(CaptureFileHeader) == 80, "CaptureFileHeader is part of the file format");
+    static_assert(sizeof(CaptureSectionEntry) == 80, "CaptureSectionEntry is part of the file format");
+    static_assert(sizeof(CaptureCamera) == 152, "CaptureCamera is part of the file format");
+
+    /** 64 bit FNV-1a over 8 byte words, the tail is hashed bytewise.
+    */
+    uint64_t CaptureChecksum(const void* data, size_t size);
+
+    /** Collects the sections of a frame and writes them in one go. The data is copied, so the caller can release
+        its readback buffers as soon as a section is added.
+    */
+    class ReservoirCaptureWriter
+    {
+    public:
+        CaptureFileHeader& GetHeader() { return mHeader; }
+
+        void AddSection(CaptureSectionType type, const std::string& name, uint32_t elementSize, const void* data, size_t size);
+        void AddTexture(const std::string& name, CaptureFormat format, uint32_t elementSize, uint32_t width, uint32_t height, const void* data);
+
+        /** Write to a temporary file next to path and rename it, so readers never see a partial capture.
+        */
+        bool Write(const std::string& path) const;
+
+    private:
+        struct Section
+        {
+            CaptureSectionEntry entry;
+            std::vector<uint8_t> data;
+        };
+
+        CaptureFileHeader mHeader;
+        std::vector<Section> mSections;
+    };
+
+    /** Read only memory mapping of a capture file. Sections are returned as pointers into the mapping.
+    */
+    class ReservoirCaptureReader
+    {
+    public:
+        ReservoirCaptureReader() = default;
+        ~ReservoirCaptureReader() { Close(); }
+        ReservoirCaptureReader(const ReservoirCaptureReader&) = delete;
+        ReservoirCaptureReader& operator=(const ReservoirCaptureReader&) = delete;
+
+        /** Map and validate a file: magic, version, section bounds, alignment and element sizes.
+            \param[in] verifyChecksums Also hash every section, which reads the whole file.
+            \return False with GetError() set if the file cannot be used.
+        */
+        bool Open(const std::string& path, bool verifyChecksums = false);
+        void Close();
+
+        bool IsOpen() const { return mpData != nullptr; }
+        const std::string& GetError() const { return mError; }
+
+        const CaptureFileHeader& GetHeader() const { return *reinterpret_cast<const CaptureFileHeader*>(mpData); }
+        uint32_t GetPixelCount() const { return GetHeader().width * GetHeader().height; }
+
+        const CaptureSectionEntry* GetSections() const { return reinterpret_cast<const CaptureSectionEntry*>(mpData + GetHeader().sectionTableOffset); }
+        uint32_t GetSectionCount() const { return GetHeader().sectionCount; }
+
+        /** First section of the type, or of the type and name if name is not empty. Null if there is none.
+        */
+        const CaptureSectionEntry* FindSection(CaptureSectionType type, const std::string& name = "") const;
+        const void* GetSectionData(const CaptureSectionEntry& entry) const { return mpData + entry.offset; }
+
+        /** Reservoirs of a reservoir section, count is set to the number of elements. Null if the section is missing.
+        */
+        const Reservoir* GetReservoirs(CaptureSectionType type, size_t& count) const;
+
+        /** Temporal reservoirs of one slot, offsets as in the header. Null if slot is not below temporalSlotCount. */
+        const Reservoir* GetTemporalSlot(uint32_t slot) const;
+
+        /** The G-buffer of a capture made with sample channels (not fused). Copies into the planes of CpuGBuffer.
+            \return False if one of the required Float4/Float channels is missing.
+        */
+        bool LoadGBuffer(CpuGBuffer& gbuffer) const;
+
+    private:
+        const uint8_t* mpData = nullptr;
+        size_t mSize = 0;
+        std::string mError;
+#ifdef _WIN32
+        void* mFile = nullptr;
+        void* mMapping = nullptr;
+#else
+        int mFile = -1;
+#endif
+    };
+
+    /** Reservoir statistics of a capture.
+    */
+    struct CaptureReservoirStats
+    {
+        static constexpr uint32_t kMHistogramSize = 64;         ///< M = 0..62, the last bin counts everything above.
+        static constexpr int32_t kWeightLog2Min = -16;
+        static constexpr uint32_t kWeightHistogramSize = 33;    ///< floor(log2(weightF)) clamped to [-16, 16].
+
+        uint64_t count = 0;
+        uint64_t emptyCount = 0;            ///< M == 0.
+        uint64_t invalidCount = 0;          ///< M > 0 with a negative or non finite weight, position or radiance.
+        uint64_t mSum = 0;
+        uint32_t mMax = 0;
+        double weightMin = 0.0;             ///< Over valid reservoirs with M > 0.
+        double weightMax = 0.0;
+        double weightMean = 0.0;
+        uint64_t zeroWeightCount = 0;       ///< Valid reservoirs with weightF == 0, not in the weight histogram.
+        std::array<uint64_t, kMHistogramSize> mHistogram = {};
+        std::array<uint64_t, kWeightHistogramSize> weightHistogram = {};
+
+        double GetInvalidFraction() const { return count ? double(invalidCount) / count : 0.0; }
+        double GetEmptyFraction() const { return count ? double(emptyCount) / count : 0.0; }
+        double GetAverageM() const { return count > emptyCount ? double(mSum) / (count - emptyCount) : 0.0; }
+
+        std::string ToJson() const;
+    };
+
+    /** Single pass over reservoirs in place, usually straight from ReservoirCaptureReader::GetReservoirs.
+    */
+    CaptureReservoirStats ComputeReservoirStats(const Reservoir* reservoirs, size_t count);
+
+    const char* GetCaptureSectionTypeName(CaptureSectionType type);
+}
@@ -0,0 +1,164 @@
+#pragma once
+#include "HostReservoir.h"
+#include <cstring>
+
+/** Host implementation of the packed reservoir layout (PackedReservoir in GIReservoir.slang).
+    The encoders follow the shader functions in ReSTIRMathFunctions.slang operation by operation,
+    so reservoirs packed on either side decode to the same values.
+*/
+namespace ReSTIR
+{
+    struct PackedReservoir
+    {
+        float sPos[3];
+        uint32_t vNorm;         ///< Octahedral 2x16 snorm.
+        uint32_t sNorm;         ///< Octahedral 2x16 snorm.
+        uint32_t radiance;      ///< RGB9E5.
+        float weightF;
+        uint32_t MAndAge;       ///< M in the low 16 bits, age in the high 16 bits.
+    };
+
+    static_assert(sizeof(PackedReservoir) == 32, "PackedReservoir must match the layout in GIReservoir.slang");
+
+    constexpr uint32_t kOctahedralZero = 0x80008000u;
+    constexpr float kRGB9E5MaxValue = 65408.f;
+
+    inline float SignNotZero(float v) { return v >= 0.f ? 1.f : -1.f; }
+
+    inline uint32_t EncodeOctahedral(const Vec3& n)
+    {
+        float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+        if (l1 <= 0.f) return kOctahedralZero;
+
+        float px = n.x / l1;
+        float py = n.y / l1;
+        if (n.z < 0.f)
+        {
+            float ox = (1.f - std::abs(py)) * SignNotZero(px);
+            float oy = (1.f - std::abs(px)) * SignNotZero(py);
+            px = ox;
+            py = oy;
+        }
+
+        int32_t qx = (int32_t)std::floor(std::clamp(px, -1.f, 1.f) * 32767.f + 0.5f);
+        int32_t qy = (int32_t)std::floor(std::clamp(py, -1.f, 1.f) * 32767.f + 0.5f);
+        return ((uint32_t)qx & 0xffffu) | ((uint32_t)qy << 16);
+    }
+
+    inline Vec3 DecodeOctahedral(uint32_t packed)
+    {
+        if (packed == kOctahedralZero) return Vec3();
+
+        int32_t qx = (int16_t)(packed & 0xffffu);
+        int32_t qy = (int16_t)(packed >> 16);
+        float px = std::max(qx / 32767.f, -1.f);
+        float py = std::max(qy / 32767.f, -1.f);
+
+        Vec3 n(px, py, 1.f - std::abs(px) - std::abs(py));
+        if (n.z < 0.f)
+        {
+            n.x = (1.f - std::abs(py)) * SignNotZero(px);
+            n.y = (1.f - std::abs(px)) * SignNotZero(py);
+        }
+        return Normalize(n);
+    }
+
+    inline uint32_t EncodeRGB9E5(const Vec3& color)
+    {
+        float r = std::clamp(color.x, 0.f, kRGB9E5MaxValue);
+        float g = std::clamp(color.y, 0.f, kRGB9E5MaxValue);
+        float b = std::clamp(color.z, 0.f, kRGB9E5MaxValue);
+        float maxC = std::max(r, std::max(g, b));
+
+        if (maxC <= 0.f) return 0;
+
+        int32_t exponent = std::max(-16, (int32_t)std::floor(std::log2(maxC))) + 16;
+        float denom = std::exp2((float)(exponent - 24));
+        if (std::floor(maxC / denom + 0.5f) >= 512.f)
+        {
+            denom *= 2.f;
+            exponent++;
+        }
+
+        uint32_t mr = (uint32_t)std::floor(r / denom + 0.5f);
+        uint32_t mg = (uint32_t)std::floor(g / denom + 0.5f);
+        uint32_t mb = (uint32_t)std::floor(b / denom + 0.5f);
+        return mr | (mg << 9) | (mb << 18) | ((uint32_t)exponent << 27);
+    }
+
+    inline Vec3 DecodeRGB9E5(uint32_t packed)
+    {
+        float scale = std::exp2((float)((int32_t)(packed >> 27) - 24));
+        return Vec3((float)(packed & 0x1ffu), (float)((packed >> 9) & 0x1ffu), (float)((packed >> 18) & 0x1ffu)) * scale;
+    }
+
+    inline PackedReservoir Pack(const Reservoir& r)
+    {
+        PackedReservoir p;
+        p.sPos[0] = r.z.sPos.x;
+        p.sPos[1] = r.z.sPos.y;
+        p.sPos[2] = r.z.sPos.z;
+        p.vNorm = EncodeOctahedral(r.z.vNorm);
+        p.sNorm = EncodeOctahedral(r.z.sNorm);
+        p.radiance = EncodeRGB9E5(r.z.radiance);
+        p.weightF = r.weightF;
+        p.MAndAge = std::min(r.M, 0xffffu) | ((uint32_t)std::clamp(r.age, 0, 0xffff) << 16);
+        return p;
+    }
+
+    /** Unpack a reservoir. vPos is not part of the packed layout and has to be rebuilt from depth by the caller.
+    */
+    inline Reservoir Unpack(const PackedReservoir& p, const Vec3& vPos)
+    {
+        Reservoir r;
+        r.z.vPos = vPos;
+        r.z.vNorm = DecodeOctahedral(p.vNorm);
+        r.z.sPos = Vec3(p.sPos[0], p.sPos[1], p.sPos[2]);
+        r.z.sNorm = DecodeOctahedral(p.sNorm);
+        r.z.radiance = DecodeRGB9E5(p.radiance);
+        r.weightF = p.weightF;
+        r.M = p.MAndAge & 0xffffu;
+        r.age = (int32_t)(p.MAndAge >> 16);
+        return r;
+    }
+
+    /** Precision lost by a Pack/Unpack round trip.
+    */
+    struct PackingError
+    {
+        float maxNormalAngle = 0.f;          ///< Largest angle in radians between an original and a decoded normal.
+        float maxRadianceRelError = 0.f;     ///< Largest per channel error relative to the brightest channel.
+        uint32_t countMismatches = 0;        ///< Reservoirs whose M or age did not survive (values above 16 bits).
+        uint32_t reservoirCount = 0;
+
+        void Accumulate(const Reservoir& original, const Reservoir& decoded)
+        {
+            auto angle = [](const Vec3& a, const Vec3& b)
+            {
+                if (IsZero(a) || IsZero(b)) return IsZero(a) == IsZero(b) ? 0.f : 3.14159265f;
+                return std::acos(std::clamp(Dot(Normalize(a), Normalize(b)), -1.f, 1.f));
+            };
+            maxNormalAngle = std::max(maxNormalAngle, angle(original.z.vNorm, decoded.z.vNorm));
+            maxNormalAngle = std::max(maxNormalAngle, angle(original.z.sNorm, decoded.z.sNorm));
+
+            const Vec3& c = original.z.radiance;
+            float maxC = std::max(c.x, std::max(c.y, c.z));
+            if (maxC > 0.f && maxC <= kRGB9E5MaxValue)
+            {
+                Vec3 d = decoded.z.radiance - c;
+                float e = std::max(std::abs(d.x), std::max(std::abs(d.y), std::abs(d.z))) / maxC;
+                maxRadianceRelError = std::max(maxRadianceRelError, e);
+            }
+
+            if (original.M != decoded.M || original.age != decoded.age) countMismatches++;
+            reservoirCount++;
+        }
+    };
+
+    /** Pack and unpack a reservoir and accumulate the round trip error.
+    */
+    inline void MeasureRoundTrip(const Reservoir& r, PackingError& error)
+    {
+        error.Accumulate(r, Unpack(Pack(r), r.z.vPos));
+    }
+}
@@ -0,0 +1,247 @@
+#include "ReservoirRingScheduler.h"
+#include <algorithm>
+
+namespace ReSTIR
+{
+    namespace
+    {
+        constexpr uint32_t kStageCount = (uint32_t)RingStage::Count;
+        constexpr double kEpsilon = 1e-9;
+
+        struct FrameTimes
+        {
+            double begin[kStageCount] = {};
+            double end[kStageCount] = {};
+            bool done[kStageCount] = {};
+
+            double GetEnd() const { return *std::max_element(std::begin(end), std::end(end)); }
+        };
+
+        /** Time both queues are busy. The events of a queue do not overlap each other.
+        */
+        double GetOverlapTime(const std::vector<RingStageEvent>& events)
+        {
+            std::vector<std::pair<double, double>> intervals[2];
+            for (const auto& event : events) intervals[(uint32_t)event.queue].emplace_back(event.begin, event.end);
+            for (auto& queue : intervals) std::sort(queue.begin(), queue.end());
+
+            double overlap = 0.0;
+            size_t a = 0, b = 0;
+            while (a < intervals[0].size() && b < intervals[1].size())
+            {
+                const auto& x = intervals[0][a];
+                const auto& y = intervals[1][b];
+                overlap += std::max(0.0, std::min(x.second, y.second) - std::max(x.first, y.first));
+                if (x.second < y.second) a++;
+                else b++;
+            }
+            return overlap;
+        }
+    }
+
+    void ReservoirRing::Reset(uint32_t slotCount)
+    {
+        mFences.assign(std::clamp(slotCount, kMinSlots, kMaxSlots), 0);
+        mCurrent = 1;
+        mPrevious = 0;
+    }
+
+    void ReservoirRing::Restore(uint32_t currentSlot, uint32_t previousSlot)
+    {
+        mCurrent = currentSlot % GetSlotCount();
+        mPrevious = previousSlot % GetSlotCount();
+    }
+
+    void ReservoirRing::Advance()
+    {
+        mFences[mCurrent] = kUnsignaled;
+        mFences[mPrevious] = kUnsignaled;
+        mPrevious = mCurrent;
+        mCurrent = (mCurrent + 1) % GetSlotCount();
+    }
+
+    void ReservoirRing::Signal(uint64_t fenceValue)
+    {
+        for (auto& fence : mFences)
+        {
+            if (fence == kUnsignaled) fence = fenceValue;
+        }
+    }
+
+    double RingStageCosts::Get(RingStage stage) const
+    {
+        switch (stage)
+        {
+        case RingStage::GBuffer: return gbuffer;
+        case RingStage::InitialSampling: return initialSampling;
+        case RingStage::Resampling: return resampling;
+        case RingStage::FinalShading: return finalShading;
+        default: return 0.0;
+        }
+    }
+
+    const char* GetRingStageName(RingStage stage)
+    {
+        switch (stage)
+        {
+        case RingStage::GBuffer: return "G-buffer";
+        case RingStage::InitialSampling: return "initial sampling";
+        case RingStage::Resampling: return "resampling";
+        case RingStage::FinalShading: return "final shading";
+        default: return "unknown";
+        }
+    }
+
+    RingSimulationResult SimulateReservoirRing(const RingSimulationDesc& desc)
+    {
+        RingSimulationResult result;
+        result.slotCount = std::clamp(desc.slotCount, ReservoirRing::kMinSlots, ReservoirRing::kMaxSlots);
+        result.framesAhead = std::min(desc.framesAhead, result.slotCount - 1);
+        const uint32_t frameCount = desc.frameCount;
+        const uint32_t slotCount = result.slotCount;
+        const uint32_t framesAhead = result.framesAhead;
+        if (frameCount == 0) return result;
+
+        std::vector<FrameTimes> frames(frameCount);
+        double queueFree[2] = { 0.0, 0.0 };
+
+        // The last frame on a slot has to be done with it before frame f writes it.
+        auto getSlotReady = [&](uint32_t frame)
+        {
+            return frame >= slotCount ? frames[frame - slotCount].GetEnd() : 0.0;
+        };
+
+        auto run = [&](uint32_t frame, RingStage stage, RingQueue queue, double inputsReady)
+        {
+            double& free = queueFree[(uint32_t)queue];
+            double slotReady = getSlotReady(frame);
+            double begin = std::max({ free, inputsReady, slotReady });
+            if (slotReady > std::max(free, inputsReady) + kEpsilon) result.slotStalls++;
+
+            RingStageEvent event;
+            event.frame = frame;
+            event.stage = stage;
+            event.queue = queue;
+            event.slot = frame % slotCount;
+            event.begin = begin;
+            event.end = begin + desc.costs.Get(stage);
+            result.events.push_back(event);
+
+            FrameTimes& times = frames[frame];
+            times.begin[(uint32_t)stage] = event.begin;
+            times.end[(uint32_t)stage] = event.end;
+            times.done[(uint32_t)stage] = true;
+            free = event.end;
+        };
+
+        auto resample = [&](uint32_t frame)
+        {
+            const FrameTimes& times = frames[frame];
+            double history = frame > 0 ? frames[frame - 1].end[(uint32_t)RingStage::Resampling] : 0.0;
+            run(frame, RingStage::Resampling, RingQueue::Direct, std::max(times.end[(uint32_t)RingStage::InitialSampling], history));
+            run(frame, RingStage::FinalShading, RingQueue::Direct, times.end[(uint32_t)RingStage::Resampling]);
+        };
+
+        const RingQueue initialQueue = framesAhead > 0 ? RingQueue::AsyncCompute : RingQueue::Direct;
+        for (uint32_t frame = 0; frame < frameCount; frame++)
+        {
+            run(frame, RingStage::GBuffer, RingQueue::Direct, 0.0);
+            run(frame, RingStage::InitialSampling, initialQueue, frames[frame].end[(uint32_t)RingStage::GBuffer]);
+            if (frame >= framesAhead) resample(frame - framesAhead);
+        }
+        for (uint32_t frame = frameCount - std::min(framesAhead, frameCount); frame < frameCount; frame++) resample(frame);
+
+        // Steady state. The first frames fill the pipeline, the last ones drain it without G-buffer work in between.
+        uint32_t last = frameCount - 1 - std::min(framesAhead, frameCount - 1);
+        uint32_t first = last / 2;
+        if (last > first)
+        {
+            double firstEnd = frames[first].end[(uint32_t)RingStage::FinalShading];
+            double lastEnd = frames[last].end[(uint32_t)RingStage::FinalShading];
+            result.frameInterval = (lastEnd - firstEnd) / (last - first);
+        }
+        else result.frameInterval = frames[last].GetEnd();
+
+        double latency = 0.0;
+        for (uint32_t frame = first; frame <= last; frame++)
+        {
+            latency += frames[frame].end[(uint32_t)RingStage::FinalShading] - frames[frame].begin[(uint32_t)RingStage::GBuffer];
+        }
+        result.latency = latency / (last - first + 1);
+
+        double totalTime = std::max(queueFree[0], queueFree[1]);
+        result.overlap = totalTime > 0.0 ? GetOverlapTime(result.events) / totalTime : 0.0;
+        return result;
+    }
+
+    std::string ValidateRingSchedule(const RingSimulationResult& result)
+    {
+        const uint32_t slotCount = result.slotCount;
+        if (slotCount < ReservoirRing::kMinSlots) return "fewer than " + std::to_string(ReservoirRing::kMinSlots) + " slots";
+
+        uint32_t frameCount = 0;
+        for (const auto& event : result.events) frameCount = std::max(frameCount, event.frame + 1);
+
+        std::vector<FrameTimes> frames(frameCount);
+        for (const auto& event : result.events)
+        {
+            if (event.end < event.begin) return "frame " + std::to_string(event.frame) + " " + GetRingStageName(event.stage) + " ends before it begins";
+            if (event.slot != event.frame % slotCount) return "frame " + std::to_string(event.frame) + " " + GetRingStageName(event.stage) + " uses the wrong slot";
+
+            FrameTimes& times = frames[event.frame];
+            uint32_t stage = (uint32_t)event.stage;
+            if (stage >= kStageCount || times.done[stage]) return "frame " + std::to_string(event.frame) + " has a duplicate or unknown stage";
+            times.begin[stage] = event.begin;
+            times.end[stage] = event.end;
+            times.done[stage] = true;
+        }
+
+        // A queue runs one stage at a time.
+        for (uint32_t queue = 0; queue < 2; queue++)
+        {
+            std::vector<const RingStageEvent*> queueEvents;
+            for (const auto& event : result.events)
+            {
+                if ((uint32_t)event.queue == queue) queueEvents.push_back(&event);
+            }
+            std::sort(queueEvents.begin(), queueEvents.end(), [](const RingStageEvent* a, const RingStageEvent* b) { return a->begin < b->begin; });
+            for (size_t i = 1; i < queueEvents.size(); i++)
+            {
+                if (queueEvents[i]->begin + kEpsilon < queueEvents[i - 1]->end)
+                {
+                    return "frame " + std::to_string(queueEvents[i]->frame) + " " + GetRingStageName(queueEvents[i]->stage) + " overlaps another stage on its queue";
+                }
+            }
+        }
+
+        auto check = [](const FrameTimes& times, RingStage stage, double ready) { return times.begin[(uint32_t)stage] + kEpsilon >= ready; };
+
+        for (uint32_t frame = 0; frame < frameCount; frame++)
+        {
+            const FrameTimes& times = frames[frame];
+            const std::string name = "frame " + std::to_string(frame) + " ";
+            for (uint32_t stage = 0; stage < kStageCount; stage++)
+            {
+                if (!times.done[stage]) return name + GetRingStageName((RingStage)stage) + " is missing";
+            }
+
+            if (!check(times, RingStage::InitialSampling, times.end[(uint32_t)RingStage::GBuffer])) return name + "samples before its G-buffer is done";
+            if (!check(times, RingStage::Resampling, times.end[(uint32_t)RingStage::InitialSampling])) return name + "resamples before its initial samples are done";
+            if (!check(times, RingStage::FinalShading, times.end[(uint32_t)RingStage::Resampling])) return name + "shades before resampling is done";
+            if (frame > 0 && !check(times, RingStage::Resampling, frames[frame - 1].end[(uint32_t)RingStage::Resampling])) return name + "reads a temporal history that is not written yet";
+
+            // Every stage of a frame touches its slot, the frame before on the slot has to be done with it. The
+            // temporal slot is also read as history by the frame after the one that wrote it.
+            if (frame >= slotCount)
+            {
+                double released = frames[frame - slotCount].GetEnd();
+                for (uint32_t stage = 0; stage < kStageCount; stage++)
+                {
+                    if (!check(times, (RingStage)stage, released)) return name + GetRingStageName((RingStage)stage) + " writes slot " + std::to_string(frame % slotCount) + " while frame " + std::to_string(frame - slotCount) + " still uses it";
+                }
+                if (!check(times, RingStage::Resampling, frames[frame - slotCount + 1].end[(uint32_t)RingStage::Resampling])) return name + "overwrites a temporal history that is still read";
+            }
+        }
+        return {};
+    }
+}
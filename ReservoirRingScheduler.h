@@ -0,0 +1,127 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ReSTIR
+{
+    /** Temporal reservoir slots used round robin. A frame writes the current slot and reads the previous one, the next
+        frame moves one slot on. Two slots are the ping-pong of temCurOffset and temLastOffset.
+
+        Every slot remembers the fence value signaled behind the last frame that used it. A queue other than the one
+        that used the slot last may only write it once that value completed. The fence is signaled once the frame is
+        submitted, until then the slots of the frame are not writable at all.
+    */
+    class ReservoirRing
+    {
+    public:
+        static constexpr uint32_t kMinSlots = 2;
+        static constexpr uint32_t kMaxSlots = 8;
+
+        explicit ReservoirRing(uint32_t slotCount = kMinSlots) { Reset(slotCount); }
+
+        /** Slot 1 is current and slot 0 previous, as in RenderingRuntimeParams. The fences are cleared.
+        */
+        void Reset(uint32_t slotCount);
+
+        /** Continue from a captured frame. Both slots must be below the slot count.
+        */
+        void Restore(uint32_t currentSlot, uint32_t previousSlot);
+
+        /** The frame using the current and previous slot was recorded, the current slot becomes the previous one.
+        */
+        void Advance();
+
+        /** The frames recorded since the last call were submitted and fenceValue is signaled behind them.
+        */
+        void Signal(uint64_t fenceValue);
+
+        bool IsWritable(uint32_t slot, uint64_t completedValue) const { return mFences[slot] <= completedValue; }
+
+        uint32_t GetSlotCount() const { return (uint32_t)mFences.size(); }
+        uint32_t GetCurrentSlot() const { return mCurrent; }
+        uint32_t GetPreviousSlot() const { return mPrevious; }
+        uint64_t GetSlotFence(uint32_t slot) const { return mFences[slot]; }
+
+    private:
+        static constexpr uint64_t kUnsignaled = ~0ull;
+
+        std::vector<uint64_t> mFences;
+        uint32_t mCurrent = 1;
+        uint32_t mPrevious = 0;
+    };
+
+    enum class RingStage : uint32_t
+    {
+        GBuffer,
+        InitialSampling,
+        Resampling,             ///< Temporal and spatial reuse.
+        FinalShading,
+        Count
+    };
+
+    enum class RingQueue : uint32_t
+    {
+        Direct,
+        AsyncCompute,
+    };
+
+    /** GPU time of each stage of a frame in milliseconds.
+    */
+    struct RingStageCosts
+    {
+        double gbuffer = 1.0;
+        double initialSampling = 4.0;
+        double resampling = 3.0;
+        double finalShading = 1.0;
+
+        double Get(RingStage stage) const;
+    };
+
+    struct RingSimulationDesc
+    {
+        uint32_t slotCount = 2;         ///< Slots of every per frame resource: G-buffer, initial and temporal reservoirs.
+        uint32_t framesAhead = 1;       ///< Frames initial sampling runs ahead on the async queue, 0 runs every stage in order on the direct queue.
+        uint32_t frameCount = 64;
+        RingStageCosts costs;
+    };
+
+    struct RingStageEvent
+    {
+        uint32_t frame = 0;
+        RingStage stage = RingStage::GBuffer;
+        RingQueue queue = RingQueue::Direct;
+        uint32_t slot = 0;
+        double begin = 0.0;
+        double end = 0.0;
+    };
+
+    struct RingSimulationResult
+    {
+        uint32_t slotCount = 0;         ///< Clamped to the ring limits.
+        uint32_t framesAhead = 0;       ///< Clamped below the slot count.
+        std::vector<RingStageEvent> events;     ///< In submission order.
+        double frameInterval = 0.0;     ///< Average time between frames once the pipeline is full.
+        double latency = 0.0;           ///< Average time from the G-buffer to the end of final shading, same frames.
+        double overlap = 0.0;           ///< Share of the run with both queues busy.
+        uint32_t slotStalls = 0;        ///< Stages that waited for a slot still in use by an older frame.
+    };
+
+    /** Run the stages of frameCount frames on a direct and an async compute queue.
+
+        Frame f uses slot f % slotCount of every per frame resource. The direct queue runs the G-buffer of frame f and
+        then resampling and final shading of frame f - framesAhead, the async queue runs initial sampling of frame f as
+        soon as its G-buffer is done. A stage starts once its queue is free, its inputs are done and the last frame
+        that used its slot finished reading it. Frames ahead are limited to slotCount - 1, more would make the G-buffer
+        wait for work submitted after it.
+    */
+    RingSimulationResult SimulateReservoirRing(const RingSimulationDesc& desc);
+
+    /** Check a schedule independently of the simulation: no overlap on a queue, every stage after its inputs and no
+        slot written before the frame that used it last finished reading it.
+        \return Empty if the schedule is valid, else the first violation.
+    */
+    std::string ValidateRingSchedule(const RingSimulationResult& result);
+
+    const char* GetRingStageName(RingStage stage);
+}
@@ -0,0 +1,134 @@
+#include "ResourceLifetimePlanner.h"
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+
+namespace ReSTIR
+{
+    namespace
+    {
+        bool Overlaps(const TransientResourceDesc& a, const TransientResourceDesc& b)
+        {
+            return a.firstStage <= b.lastStage && b.firstStage <= a.lastStage;
+        }
+
+        std::string FormatBytes(uint64_t bytes)
+        {
+            char text[32];
+            if (bytes >= (1ull << 20)) std::snprintf(text, sizeof(text), "%.2f MB", bytes / double(1ull << 20));
+            else if (bytes >= (1ull << 10)) std::snprintf(text, sizeof(text), "%.2f KB", bytes / double(1ull << 10));
+            else std::snprintf(text, sizeof(text), "%llu B", (unsigned long long)bytes);
+            return text;
+        }
+    }
+
+    uint32_t ResourceLifetimePlanner::AddStage(const std::string& name)
+    {
+        mStages.push_back(name);
+        return (uint32_t)mStages.size() - 1;
+    }
+
+    uint32_t ResourceLifetimePlanner::AddResource(const TransientResourceDesc& desc)
+    {
+        if (desc.firstStage > desc.lastStage || desc.lastStage >= mStages.size())
+        {
+            throw std::invalid_argument("ResourceLifetimePlanner: invalid stage interval for '" + desc.name + "'");
+        }
+        mResources.push_back(desc);
+        return (uint32_t)mResources.size() - 1;
+    }
+
+    void ResourceLifetimePlanner::Clear()
+    {
+        mStages.clear();
+        mResources.clear();
+    }
+
+    ResourcePlan ResourceLifetimePlanner::Plan() const
+    {
+        ResourcePlan plan;
+        plan.allocationOf.assign(mResources.size(), ResourcePlan::kSkipped);
+
+        std::vector<uint32_t> order(mResources.size());
+        std::iota(order.begin(), order.end(), 0u);
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return mResources[a].size > mResources[b].size; });
+
+        for (uint32_t index : order)
+        {
+            const TransientResourceDesc& desc = mResources[index];
+            if (!desc.used)
+            {
+                plan.skippedBytes += desc.size;
+                continue;
+            }
+            plan.requestedBytes += desc.size;
+
+            int32_t best = ResourcePlan::kSkipped;
+            uint64_t bestGrowth = UINT64_MAX;
+            if (!desc.persistent)
+            {
+                for (size_t a = 0; a < plan.allocations.size(); a++)
+                {
+                    const auto& allocation = plan.allocations[a];
+                    if (allocation.persistent || allocation.aliasGroup != desc.aliasGroup) continue;
+
+                    bool isFree = std::none_of(allocation.resources.begin(), allocation.resources.end(),
+                        [&](uint32_t other) { return Overlaps(desc, mResources[other]); });
+                    if (!isFree) continue;
+
+                    uint64_t growth = desc.size > allocation.size ? desc.size - allocation.size : 0;
+                    if (growth < bestGrowth)
+                    {
+                        best = (int32_t)a;
+                        bestGrowth = growth;
+                    }
+                }
+            }
+
+            if (best == ResourcePlan::kSkipped)
+            {
+                ResourcePlan::Allocation allocation;
+                allocation.aliasGroup = desc.aliasGroup;
+                allocation.persistent = desc.persistent;
+                plan.allocations.push_back(allocation);
+                best = (int32_t)plan.allocations.size() - 1;
+            }
+
+            auto& allocation = plan.allocations[best];
+            allocation.size = std::max(allocation.size, desc.size);
+            allocation.resources.push_back(index);
+            plan.allocationOf[index] = best;
+        }
+
+        for (const auto& allocation : plan.allocations) plan.allocatedBytes += allocation.size;
+        return plan;
+    }
+
+    std::string ResourceLifetimePlanner::FormatReport(const ResourcePlan& plan, uint32_t width, uint32_t height) const
+    {
+        std::ostringstream ss;
+        ss << "Reservoir memory at " << width << "x" << height << "\n";
+        for (size_t i = 0; i < mResources.size(); i++)
+        {
+            const TransientResourceDesc& desc = mResources[i];
+            ss << "  " << desc.name << ": " << FormatBytes(desc.size);
+            int32_t allocation = plan.allocationOf[i];
+            if (allocation == ResourcePlan::kSkipped)
+            {
+                ss << ", unused\n";
+                continue;
+            }
+            ss << ", allocation " << allocation;
+            if (desc.persistent) ss << ", persistent";
+            else ss << ", " << mStages[desc.firstStage] << " to " << mStages[desc.lastStage];
+            if (plan.allocations[allocation].resources.size() > 1) ss << ", aliased";
+            ss << "\n";
+        }
+        ss << "Requested " << FormatBytes(plan.requestedBytes) << ", allocated " << FormatBytes(plan.allocatedBytes);
+        ss << ", saved by aliasing " << FormatBytes(plan.requestedBytes - plan.allocatedBytes);
+        ss << ", skipped " << FormatBytes(plan.skippedBytes) << "\n";
+        return ss.str();
+    }
+}
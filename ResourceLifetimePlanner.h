@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ReSTIR
+{
+    /** A buffer of the pass and the part of the frame it is live in.
+        Stages are the indices returned by ResourceLifetimePlanner::AddStage, first and last are inclusive.
+    */
+    struct TransientResourceDesc
+    {
+        std::string name;
+        uint64_t size = 0;              ///< Bytes.
+        uint32_t firstStage = 0;
+        uint32_t lastStage = 0;
+        std::string aliasGroup;         ///< Only resources of the same group share an allocation, e.g. the element type.
+        bool persistent = false;        ///< Carries data to the next frame, never aliased.
+        bool used = true;               ///< Unused resources get no allocation.
+    };
+
+    struct ResourcePlan
+    {
+        static constexpr int32_t kSkipped = -1;
+
+        struct Allocation
+        {
+            uint64_t size = 0;
+            std::string aliasGroup;
+            bool persistent = false;
+            std::vector<uint32_t> resources;    ///< Resources placed in this allocation, in the order they were added.
+        };
+
+        std::vector<int32_t> allocationOf;      ///< Allocation index per resource, kSkipped if the resource is unused.
+        std::vector<Allocation> allocations;
+        uint64_t requestedBytes = 0;            ///< Sum of the sizes of all used resources.
+        uint64_t allocatedBytes = 0;            ///< Sum of the allocation sizes.
+        uint64_t skippedBytes = 0;              ///< Sum of the sizes of the unused resources.
+    };
+
+    /** Places the buffers of a frame into as few allocations as possible.
+        Resources whose stage intervals do not overlap are aliased onto the same allocation, largest first into the
+        allocation that grows least. Pure C++ so the plans can be checked without a GPU.
+    */
+    class ResourceLifetimePlanner
+    {
+    public:
+        uint32_t AddStage(const std::string& name);
+        uint32_t AddResource(const TransientResourceDesc& desc);
+        void Clear();
+
+        const std::vector<std::string>& GetStages() const { return mStages; }
+        const std::vector<TransientResourceDesc>& GetResources() const { return mResources; }
+
+        ResourcePlan Plan() const;
+
+        /** Human readable table of the plan, one line per resource followed by the totals.
+        */
+        std::string FormatReport(const ResourcePlan& plan, uint32_t width, uint32_t height) const;
+
+    private:
+        std::vector<std::string> mStages;
+        std::vector<TransientResourceDesc> mResources;
+    };
+}
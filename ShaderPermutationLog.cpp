@@ -0,0 +1,131 @@
+#include "ShaderPermutationLog.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+
+namespace ReSTIR
+{
+    namespace
+    {
+        constexpr uint64_t kFnvOffset = 14695981039346656037ull;
+        constexpr uint64_t kFnvPrime = 1099511628211ull;
+
+        uint64_t Fnv1a(const void* data, size_t size, uint64_t hash = kFnvOffset)
+        {
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            for (size_t i = 0; i < size; i++) hash = (hash ^ bytes[i]) * kFnvPrime;
+            return hash;
+        }
+
+        void AppendField(std::string& out, const std::string& name, const std::string& value)
+        {
+            out += name + " " + std::to_string(value.size()) + ":" + value + "\n";
+        }
+
+        bool HasExtension(const std::filesystem::path& path, const std::vector<std::string>& extensions)
+        {
+            std::string extension = path.extension().string();
+            return std::find(extensions.begin(), extensions.end(), extension) != extensions.end();
+        }
+    }
+
+    std::string ShaderPermutationDesc::GetCanonicalString() const
+    {
+        std::string out;
+        for (const auto& source : sources) AppendField(out, "source", source);
+        for (const auto& entryPoint : entryPoints) AppendField(out, "entry", entryPoint);
+        AppendField(out, "sm", shaderModel);
+        for (const auto& option : options) AppendField(out, "option", option);
+
+        std::map<std::string, std::string> sortedDefines;
+        for (const auto& [name, value] : defines) sortedDefines[name] = value;
+        for (const auto& [name, value] : sortedDefines) AppendField(out, "define", name + "=" + value);
+
+        std::vector<std::pair<std::string, std::string>> sortedConformances = typeConformances;
+        std::sort(sortedConformances.begin(), sortedConformances.end());
+        sortedConformances.erase(std::unique(sortedConformances.begin(), sortedConformances.end()), sortedConformances.end());
+        for (const auto& [type, interfaceName] : sortedConformances) AppendField(out, "conformance", type + ":" + interfaceName);
+
+        AppendField(out, "sources", FormatPermutationKey(sourceHash));
+        AppendField(out, "toolchain", toolchain);
+        return out;
+    }
+
+    uint64_t ComputePermutationKey(const ShaderPermutationDesc& desc)
+    {
+        std::string canonical = desc.GetCanonicalString();
+        return Fnv1a(canonical.data(), canonical.size());
+    }
+
+    std::string FormatPermutationKey(uint64_t key)
+    {
+        static const char kDigits[] = "0123456789abcdef";
+        std::string text(16, '0');
+        for (int i = 15; i >= 0; i--, key >>= 4) text[i] = kDigits[key & 0xf];
+        return text;
+    }
+
+    uint64_t HashShaderDirectory(const std::filesystem::path& directory, const std::vector<std::string>& extensions)
+    {
+        std::error_code error;
+        if (!std::filesystem::is_directory(directory, error)) return 0;
+
+        std::vector<std::filesystem::path> files;
+        for (auto it = std::filesystem::recursive_directory_iterator(directory, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+        {
+            if (it->is_regular_file(error) && HasExtension(it->path(), extensions)) files.push_back(it->path());
+        }
+        std::sort(files.begin(), files.end());
+
+        uint64_t hash = kFnvOffset;
+        std::vector<char> contents;
+        for (const auto& file : files)
+        {
+            std::string relative = file.lexically_relative(directory).generic_string();
+            hash = Fnv1a(relative.data(), relative.size() + 1, hash);
+
+            std::ifstream stream(file, std::ios::binary);
+            contents.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+            uint64_t size = contents.size();
+            hash = Fnv1a(&size, sizeof(size), hash);
+            hash = Fnv1a(contents.data(), contents.size(), hash);
+        }
+        return hash;
+    }
+
+    ShaderCompileLog::ShaderCompileLog(const std::filesystem::path& path)
+        : mPath(path)
+    {
+        std::ifstream file(mPath);
+        std::string line;
+        while (std::getline(file, line))
+        {
+            std::istringstream stream(line);
+            std::string key;
+            ShaderCompileRecord record;
+            if (!(stream >> key >> record.compileTime) || key.size() != 16 || key.find_first_not_of("0123456789abcdef") != std::string::npos) continue;
+            record.key = std::stoull(key, nullptr, 16);
+            std::getline(stream >> std::ws, record.programName);
+            mRecords[record.key] = std::move(record);
+        }
+    }
+
+    const ShaderCompileRecord* ShaderCompileLog::Find(uint64_t key) const
+    {
+        auto it = mRecords.find(key);
+        return it != mRecords.end() ? &it->second : nullptr;
+    }
+
+    bool ShaderCompileLog::Append(const ShaderCompileRecord& record)
+    {
+        mRecords[record.key] = record;
+
+        std::error_code error;
+        if (mPath.has_parent_path()) std::filesystem::create_directories(mPath.parent_path(), error);
+        std::ofstream file(mPath, std::ios::app);
+        file << FormatPermutationKey(record.key) << " " << record.compileTime << " " << record.programName << "\n";
+        return (bool)file;
+    }
+}
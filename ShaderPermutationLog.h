@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ReSTIR
+{
+    /** Everything the compiled code of one program permutation depends on.
+    */
+    struct ShaderPermutationDesc
+    {
+        std::string programName;                                    ///< For reports only, not part of the key.
+        std::vector<std::string> sources;                           ///< Shader files in the order they are added to the program.
+        std::vector<std::string> entryPoints;                       ///< Entry points or hit groups in binding table order.
+        std::string shaderModel;
+        std::vector<std::string> options;                           ///< Other compile settings such as payload and attribute sizes.
+        std::vector<std::pair<std::string, std::string>> defines;   ///< Any order, a later define of the same name replaces an earlier one.
+        std::vector<std::pair<std::string, std::string>> typeConformances;  ///< Type and interface, any order.
+        uint64_t sourceHash = 0;                                    ///< HashShaderDirectory over the sources and what they import.
+        std::string toolchain;                                      ///< Engine and compiler version, a new one invalidates every entry.
+
+        /** Fields one per line and length prefixed, defines and conformances sorted. Two descs with the same
+            canonical string compile to the same code.
+        */
+        std::string GetCanonicalString() const;
+    };
+
+    /** 64 bit FNV-1a of the canonical string, stable across runs and platforms. */
+    uint64_t ComputePermutationKey(const ShaderPermutationDesc& desc);
+
+    /** 16 hex digits. */
+    std::string FormatPermutationKey(uint64_t key);
+
+    /** Hash of the relative paths and contents of the files below directory with one of the extensions, visited in
+        sorted order. 0 if the directory does not exist.
+    */
+    uint64_t HashShaderDirectory(const std::filesystem::path& directory, const std::vector<std::string>& extensions);
+
+    /** One compilation in a ShaderCompileLog. */
+    struct ShaderCompileRecord
+    {
+        uint64_t key = 0;
+        double compileTime = 0.0;       ///< Milliseconds.
+        std::string programName;
+    };
+
+    /** Text log of the program permutations compiled so far, one line per permutation: key, compile time in ms and
+        program name. Nothing compiled is kept, the log only tells which permutations earlier runs needed and what they
+        cost to compile. The compiled programs are kept in memory by the pass. Lines that do not parse are skipped.
+    */
+    class ShaderCompileLog
+    {
+    public:
+        /** Read the records of earlier runs from path, if it exists. */
+        explicit ShaderCompileLog(const std::filesystem::path& path);
+
+        /** Record of the key, null if no run compiled it. */
+        const ShaderCompileRecord* Find(uint64_t key) const;
+
+        /** Add a record and append its line to the file. A later record of the same key replaces the earlier one.
+            \return False if the file could not be written, the record is kept in memory anyway.
+        */
+        bool Append(const ShaderCompileRecord& record);
+
+        const std::filesystem::path& GetPath() const { return mPath; }
+        size_t GetRecordCount() const { return mRecords.size(); }
+
+    private:
+        std::filesystem::path mPath;
+        std::unordered_map<uint64_t, ShaderCompileRecord> mRecords;
+    };
+}
@@ -0,0 +1,126 @@
+#include "SpatialAccessModel.h"
+#include <vector>
+
+namespace ReSTIR
+{
+    namespace
+    {
+        /** Offset of a tile, GetTileOffset in SpatialtemporalResample.cs.slang. */
+        void GetTileOffset(const SpatialAccessSettings& settings, uint32_t groupX, uint32_t groupY, uint32_t frameCount, int32_t& offsetX, int32_t& offsetY)
+        {
+            uint32_t hash = JenkinsHash(groupY * 0x10000 + groupX);
+            uint32_t ux = hash + frameCount * 3242174889u;
+            uint32_t uy = JenkinsHash(hash) + frameCount * 2447445413u;
+            float radius = std::max((float)settings.sampleRadius - (float)settings.tileApron, 0.f);
+            offsetX = (int32_t)(((float)ux * (1.f / 4294967296.f) * 2.f - 1.f) * radius);
+            offsetY = (int32_t)(((float)uy * (1.f / 4294967296.f) * 2.f - 1.f) * radius);
+        }
+
+        /** Offset of neighbour k from the moved pixel, GetPixelOffset in SpatialtemporalResample.cs.slang. */
+        void GetPixelOffset(const SpatialAccessSettings& settings, uint32_t groupX, uint32_t groupY, uint32_t localX, uint32_t localY, uint32_t frameCount,
+            uint32_t k, int32_t& offsetX, int32_t& offsetY)
+        {
+            uint32_t hash = JenkinsHash(JenkinsHash(groupY * 0x10000 + groupX) ^ ((localY * settings.tileSize + localX + 1) * 0x9e3779b9u));
+            uint32_t index = frameCount * settings.maxNeighborCount + k;
+            uint32_t ux = hash + index * 3242174889u;
+            uint32_t uy = JenkinsHash(hash) + index * 2447445413u;
+            float apron = (float)settings.tileApron;
+            offsetX = (int32_t)(((float)ux * (1.f / 4294967296.f) * 2.f - 1.f) * apron);
+            offsetY = (int32_t)(((float)uy * (1.f / 4294967296.f) * 2.f - 1.f) * apron);
+        }
+    }
+
+    uint32_t JenkinsHash(uint32_t a)
+    {
+        a = (a + 0x7ed55d16) + (a << 12);
+        a = (a ^ 0xc761c23c) ^ (a >> 19);
+        a = (a + 0x165667b1) + (a << 5);
+        a = (a + 0xd3a2646c) ^ (a << 9);
+        a = (a + 0xfd7046c5) + (a << 3);
+        a = (a ^ 0xb55a4f09) ^ (a >> 16);
+        return a;
+    }
+
+    void GetTiledNeighborOffset(const SpatialAccessSettings& settings, uint32_t x, uint32_t y, uint32_t frameCount, uint32_t k, int32_t& offsetX, int32_t& offsetY)
+    {
+        uint32_t groupX = x / settings.tileSize, groupY = y / settings.tileSize;
+        int32_t tileX, tileY, pixelX, pixelY;
+        GetTileOffset(settings, groupX, groupY, frameCount, tileX, tileY);
+        GetPixelOffset(settings, groupX, groupY, x % settings.tileSize, y % settings.tileSize, frameCount, k, pixelX, pixelY);
+        offsetX = tileX + pixelX;
+        offsetY = tileY + pixelY;
+    }
+
+    SpatialAccessStats SimulateSpatialAccess(const SpatialAccessSettings& settings, SpatialReusePattern pattern, uint32_t frameCount)
+    {
+        SpatialAccessStats stats;
+        const int32_t width = (int32_t)settings.width;
+        const int32_t height = (int32_t)settings.height;
+        const int32_t tileSize = (int32_t)settings.tileSize;
+        const int32_t apron = (int32_t)settings.tileApron;
+        const int32_t stagedSize = tileSize + 2 * apron;
+
+        uint64_t reads = 0;
+        uint64_t lines = 0;
+        std::vector<uint64_t> tileLines;
+
+        auto load = [&](int32_t x, int32_t y)
+        {
+            if (x < 0 || y < 0 || x >= width || y >= height) return;
+            uint64_t address = ((uint64_t)y * (uint64_t)width + (uint64_t)x) * settings.elementSize;
+            // An element can straddle two lines.
+            tileLines.push_back(address / settings.cacheLineSize);
+            tileLines.push_back((address + settings.elementSize - 1) / settings.cacheLineSize);
+            reads++;
+        };
+
+        for (int32_t groupY = 0; groupY * tileSize < height; groupY++)
+        {
+            for (int32_t groupX = 0; groupX * tileSize < width; groupX++)
+            {
+                tileLines.clear();
+
+                if (pattern == SpatialReusePattern::Random)
+                {
+                    for (int32_t ty = 0; ty < tileSize; ty++)
+                    {
+                        for (int32_t tx = 0; tx < tileSize; tx++)
+                        {
+                            int32_t x = groupX * tileSize + tx;
+                            int32_t y = groupY * tileSize + ty;
+                            if (x >= width || y >= height) continue;
+
+                            HostSampleGenerator sg((uint32_t)x, (uint32_t)y, frameCount);
+                            for (uint32_t k = 0; k < settings.neighborCount; k++)
+                            {
+                                float offsetX = (sg.Next1D() * 2.f - 1.f) * settings.sampleRadius;
+                                float offsetY = (sg.Next1D() * 2.f - 1.f) * settings.sampleRadius;
+                                load((int32_t)(x + offsetX), (int32_t)(y + offsetY));
+                            }
+                        }
+                    }
+                }
+                else
+                {
+                    // The block is staged once, the neighbours are then read from groupshared memory.
+                    int32_t offsetX, offsetY;
+                    GetTileOffset(settings, (uint32_t)groupX, (uint32_t)groupY, frameCount, offsetX, offsetY);
+                    int32_t originX = groupX * tileSize + offsetX - apron;
+                    int32_t originY = groupY * tileSize + offsetY - apron;
+                    for (int32_t i = 0; i < stagedSize * stagedSize; i++) load(originX + i % stagedSize, originY + i / stagedSize);
+                }
+
+                std::sort(tileLines.begin(), tileLines.end());
+                lines += std::unique(tileLines.begin(), tileLines.end()) - tileLines.begin();
+                stats.tileCount++;
+            }
+        }
+
+        if (stats.tileCount > 0)
+        {
+            stats.readsPerTile = (double)reads / stats.tileCount;
+            stats.linesPerTile = (double)lines / stats.tileCount;
+        }
+        return stats;
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "HostReservoir.h"
+
+namespace ReSTIR
+{
+    /** How spatial reuse picks its neighbours, see SpatialtemporalResample.cs.slang.
+    */
+    enum class SpatialReusePattern : uint32_t
+    {
+        Random,     ///< Every pixel draws its own offsets in the sample radius (SpatialResample).
+        Tiled,      ///< A tile shares one offset and stages the block it reads once (SpatialResampleTiled).
+    };
+
+    struct SpatialAccessSettings
+    {
+        uint32_t width = 1920;
+        uint32_t height = 1080;
+        uint32_t sampleRadius = 30;
+        uint32_t neighborCount = 3;
+        uint32_t tileSize = 16;             ///< Thread group size of the resample pass.
+        uint32_t tileApron = 4;             ///< kTileApron of the shader.
+        uint32_t maxNeighborCount = 9;      ///< kMaxSpatialNeighbors of the shader, the stride of the per pixel sequence.
+        uint32_t elementSize = sizeof(Reservoir);   ///< Stride of temporalReservoirBuffer.
+        uint32_t cacheLineSize = 128;
+    };
+
+    /** Reads of the previous frame reservoirs issued by one thread group, averaged over the tiles of a frame.
+    */
+    struct SpatialAccessStats
+    {
+        uint64_t tileCount = 0;
+        double readsPerTile = 0.0;          ///< Reservoir loads.
+        double linesPerTile = 0.0;          ///< Distinct cache lines touched by those loads.
+
+        double GetBytesPerTile(uint32_t cacheLineSize) const { return linesPerTile * cacheLineSize; }
+    };
+
+    /** Replay the neighbour selection of a frame on the CPU and count the cache lines every thread group touches.
+        The tiled pattern follows GetTileOffset of the shader exactly, the random pattern uses HostSampleGenerator
+        in place of SampleGenerator, which has the same distribution. The similarity test is not modelled: every
+        random neighbour inside the frame counts as a load, while the tiled pattern always loads its whole block.
+    */
+    SpatialAccessStats SimulateSpatialAccess(const SpatialAccessSettings& settings, SpatialReusePattern pattern, uint32_t frameCount);
+
+    /** Offset of neighbour k of pixel (x, y) in tiled reuse, GetTileOffset plus GetPixelOffset of the shader before the clamp
+        to the staged block.
+    */
+    void GetTiledNeighborOffset(const SpatialAccessSettings& settings, uint32_t x, uint32_t y, uint32_t frameCount, uint32_t k, int32_t& offsetX, int32_t& offsetY);
+
+    /** Host version of jenkinsHash in Utils/Math/HashUtils.slang. */
+    uint32_t JenkinsHash(uint32_t a);
+}
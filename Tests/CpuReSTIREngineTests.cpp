@@ -0,0 +1,80 @@
+#include "Testing.h"
+#include "CpuReSTIREngine.h"
+#include <cstring>
+#include <random>
+
+using namespace ReSTIR;
+
+namespace
+{
+    /** A floor at z = 0 seen through the identity matrix, with the samples on a ceiling at z = 1. */
+    CpuGBuffer MakeGBuffer(std::mt19937& rng, uint32_t width, uint32_t height)
+    {
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+        CpuGBuffer gbuffer;
+        gbuffer.width = width;
+        gbuffer.height = height;
+        for (uint32_t y = 0; y < height; y++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                gbuffer.vPosW.push_back(Vec3((x + 0.5f) / width * 2.f - 1.f, 1.f - (y + 0.5f) / height * 2.f, 0.f));
+                gbuffer.vNormW.push_back(Vec3(0.f, 0.f, 1.f));
+                gbuffer.sPosW.push_back(Vec3(unit(rng) * 2.f - 1.f, unit(rng) * 2.f - 1.f, 1.f));
+                gbuffer.sNormW.push_back(Vec3(0.f, 0.f, -1.f));
+                gbuffer.sColor.push_back(Vec3(unit(rng), unit(rng), unit(rng)) * 4.f);
+                // a few pixels without a sample
+                gbuffer.random.push_back(rng() % 16 == 0 ? 0.f : 0.05f + unit(rng));
+            }
+        }
+        return gbuffer;
+    }
+
+    bool SameReservoirs(const Reservoir* a, const Reservoir* b, size_t count)
+    {
+        return std::memcmp(a, b, count * sizeof(Reservoir)) == 0;
+    }
+}
+
+RESTIR_TEST(CpuReSTIREngine, WorkerCountDoesNotChangeTheResult)
+{
+    // Every pixel draws from its own sample generator and reads only the history of the last frame, so the split into
+    // tiles over the workers must not show in the reservoirs.
+    CpuThreadPool serialPool(1), parallelPool(4);
+    UnoccludedRayCaster rayCaster;
+    CpuReSTIREngine serial(serialPool, rayCaster), parallel(parallelPool, rayCaster);
+    for (CpuReSTIREngine* engine : { &serial, &parallel })
+    {
+        CpuResampleSettings settings;
+        settings.sampleRadius = 8;
+        engine->SetSettings(settings);
+    }
+
+    std::mt19937 rng(7);
+    CpuCameraState camera;
+    camera.posW = Vec3(0.f, 0.f, 3.f);
+    for (uint32_t frame = 0; frame < 5; frame++)
+    {
+        // the last frame changes the resolution, the history is resampled into the new grid
+        CpuGBuffer gbuffer = frame < 4 ? MakeGBuffer(rng, 70, 45) : MakeGBuffer(rng, 50, 38);
+        camera.viewProj[12] = 0.01f * frame;
+        serial.ExecuteFrame(gbuffer, camera);
+        parallel.ExecuteFrame(gbuffer, camera);
+
+        const size_t pixelCount = gbuffer.GetPixelCount();
+        CHECK(parallel.GetWidth() == gbuffer.width && parallel.GetHeight() == gbuffer.height);
+        CHECK_MSG(SameReservoirs(serial.GetInitialReservoirs().data(), parallel.GetInitialReservoirs().data(), pixelCount), "frame " + std::to_string(frame));
+        CHECK_MSG(SameReservoirs(serial.GetTemporalReservoirs(true), parallel.GetTemporalReservoirs(true), pixelCount), "frame " + std::to_string(frame));
+        CHECK_MSG(SameReservoirs(serial.GetTemporalReservoirs(false), parallel.GetTemporalReservoirs(false), pixelCount), "frame " + std::to_string(frame));
+        CHECK_MSG(SameReservoirs(serial.GetSpatialReservoirs().data(), parallel.GetSpatialReservoirs().data(), pixelCount), "frame " + std::to_string(frame));
+
+        const auto& a = serial.GetFrameStats();
+        const auto& b = parallel.GetFrameStats();
+        CHECK(a.neighborsTested == b.neighborsTested && a.neighborsMerged == b.neighborsMerged && a.visibilityRays == b.visibilityRays);
+        CHECK(a.reusedVisibilityTests == b.reusedVisibilityTests && a.temporalResets == b.temporalResets);
+        // spatial reuse reads the history, from the second frame on the neighbours pass the similarity tests and merge
+        if (frame > 0) CHECK(b.neighborsMerged > 0);
+        if (frame > 0 && frame < 4) CHECK(b.temporalResets < pixelCount / 2);
+    }
+    CHECK(parallel.GetFrameCount() == 5);
+}
@@ -0,0 +1,66 @@
+#include "Testing.h"
+#include "CpuResampleKernels.h"
+#include <cmath>
+#include <random>
+
+using namespace ReSTIR;
+
+namespace
+{
+    Vec3 RandomVec3(std::mt19937& rng, float extent)
+    {
+        std::uniform_real_distribution<float> value(-extent, extent);
+        return Vec3(value(rng), value(rng), value(rng));
+    }
+
+    Vec3 RandomDirection(std::mt19937& rng)
+    {
+        Vec3 v;
+        do v = RandomVec3(rng, 1.f); while (Dot(v, v) < 1e-4f || Dot(v, v) > 1.f);
+        return Normalize(v);
+    }
+}
+
+RESTIR_TEST(CpuResampleKernels, VectorMatchesScalar)
+{
+    std::mt19937 rng(6);
+    const float jacobianClamp = 10.f;
+    for (uint32_t trial = 0; trial < 50; trial++)
+    {
+        // counts that are not a multiple of the lane width exercise the remainder loop too
+        ReuseCandidates candidates;
+        uint32_t count = 1 + rng() % 203;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            Reservoir neighbor;
+            neighbor.z.vPos = RandomVec3(rng, 2.f);
+            neighbor.z.vNorm = RandomDirection(rng);
+            neighbor.z.sPos = RandomVec3(rng, 4.f);
+            neighbor.z.sNorm = RandomDirection(rng);
+            neighbor.z.radiance = RandomVec3(rng, 1.f) + Vec3(1.f, 1.f, 1.f);
+            Vec3 receiverPos = RandomVec3(rng, 2.f);
+            // the degenerate shifts: the sample on the receiver or on the neighbour
+            if (i % 37 == 5) receiverPos = neighbor.z.sPos;
+            if (i % 41 == 7) neighbor.z.vPos = neighbor.z.sPos;
+            candidates.Push(receiverPos, RandomDirection(rng), neighbor);
+        }
+
+        ReuseCandidates vector = candidates;
+        EvaluateReuseCandidates(vector, jacobianClamp);
+        ReuseCandidates scalar = candidates;
+        scalar.targetPdf.resize(count);
+        scalar.accepted.resize(count);
+        for (uint32_t i = 0; i < count; i++) EvaluateReuseCandidate(scalar, i, jacobianClamp);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            CHECK_MSG(vector.accepted[i] == scalar.accepted[i], "candidate " + std::to_string(i));
+            // the lanes multiply by 1 / sqrt where the scalar code divides by the length, and the Jacobian divides by
+            // cosPhiB, which scales that rounding up for grazing samples
+            float tolerance = 1e-3f * scalar.targetPdf[i] + 1e-6f;
+            CHECK_MSG(std::abs(vector.targetPdf[i] - scalar.targetPdf[i]) <= tolerance,
+                std::to_string(vector.targetPdf[i]) + " vs " + std::to_string(scalar.targetPdf[i]));
+            CHECK(vector.targetPdf[i] >= 0.f && vector.targetPdf[i] <= jacobianClamp * candidates.luminance[i] * (1.f + 1e-6f));
+        }
+    }
+}
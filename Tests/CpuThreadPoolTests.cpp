@@ -0,0 +1,48 @@
+#include "Testing.h"
+#include "CpuThreadPool.h"
+#include <atomic>
+#include <memory>
+
+using namespace ReSTIR;
+
+RESTIR_TEST(CpuThreadPool, EveryIndexRunsOnce)
+{
+    for (uint32_t threadCount : { 1u, 2u, 4u, 7u })
+    {
+        CpuThreadPool threadPool(threadCount);
+        CHECK(threadPool.GetWorkerCount() == threadCount);
+
+        // consecutive calls reuse the workers, small counts leave some of them without work
+        for (uint32_t count : { 0u, 1u, 3u, 64u, 10007u })
+        {
+            std::unique_ptr<std::atomic<uint32_t>[]> runs(new std::atomic<uint32_t>[count]());
+            std::atomic<bool> badWorker{ false };
+            threadPool.ParallelFor(count, [&](uint32_t index, uint32_t workerIndex)
+            {
+                runs[index]++;
+                if (workerIndex >= threadCount) badWorker = true;
+            });
+
+            uint32_t wrong = 0;
+            for (uint32_t i = 0; i < count; i++) wrong += runs[i] != 1;
+            CHECK_MSG(wrong == 0, std::to_string(wrong) + " of " + std::to_string(count) + " on " + std::to_string(threadCount) + " threads");
+            CHECK(!badWorker);
+        }
+    }
+}
+
+RESTIR_TEST(CpuThreadPool, WorkersDoNotShareAnIndex)
+{
+    // A worker index is only used by one thread at a time, the engine keeps its scratch per worker.
+    CpuThreadPool threadPool(4);
+    std::unique_ptr<std::atomic<uint32_t>[]> busy(new std::atomic<uint32_t>[threadPool.GetWorkerCount()]());
+    std::atomic<uint32_t> overlaps{ 0 };
+    threadPool.ParallelFor(20000, [&](uint32_t index, uint32_t workerIndex)
+    {
+        if (busy[workerIndex]++ != 0) overlaps++;
+        volatile uint32_t sink = 0;
+        for (uint32_t i = 0; i < index % 64; i++) sink = sink + i;
+        busy[workerIndex]--;
+    });
+    CHECK(overlaps == 0);
+}
@@ -0,0 +1,128 @@
+#include "Testing.h"
+#include "LightAliasTable.h"
+#include "CpuThreadPool.h"
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+using namespace ReSTIR;
+
+namespace
+{
+    /** Probability of every item under the table, summed over the buckets. */
+    std::vector<double> GetSampledProbabilities(const std::vector<LightAliasEntry>& entries)
+    {
+        std::vector<double> p(entries.size(), 0.0);
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            p[i] += entries[i].threshold / (double)entries.size();
+            p[entries[i].alias] += (1.0 - entries[i].threshold) / (double)entries.size();
+        }
+        return p;
+    }
+
+    /** Weights spanning 7 decades with a quarter of zeros, or all equal. */
+    std::vector<float> RandomWeights(std::mt19937& rng, size_t count, bool equal)
+    {
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+        std::uniform_real_distribution<float> exponent(-8.f, 8.f);
+        std::vector<float> weights(count);
+        for (auto& w : weights)
+        {
+            uint32_t kind = rng() % 4;
+            w = equal ? 1.f : kind == 0 ? 0.f : kind == 1 ? std::exp(exponent(rng)) : unit(rng);
+        }
+        return weights;
+    }
+}
+
+RESTIR_TEST(LightAliasTable, MatchesTheSequentialSweep)
+{
+    // Without a pool Build runs the sequential sweep, on four workers the prefix sum form. The fixed point sums are
+    // exact, so the two tables have to be identical.
+    std::mt19937 rng(1);
+    CpuThreadPool threadPool(4);
+    for (uint32_t trial = 0; trial < 120; trial++)
+    {
+        size_t count = trial < 60 ? 1 + rng() % 50 : 1 + rng() % 50000;
+        std::vector<float> weights = RandomWeights(rng, count, trial % 7 == 0);
+        double weightSum = 0.0;
+        for (float w : weights) weightSum += w;
+
+        LightAliasTable serial, pooled;
+        bool built = serial.Build(weights);
+        CHECK(built == (weightSum > 0.0));
+        CHECK(pooled.Build(weights, &threadPool) == built);
+        if (!built) continue;
+        CHECK(serial.GetCount() == count && pooled.GetCount() == count);
+        CHECK(serial.GetWeightSum() == pooled.GetWeightSum());
+
+        std::vector<double> p = GetSampledProbabilities(pooled.GetEntries());
+        size_t differences = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            const LightAliasEntry& a = serial.GetEntries()[i];
+            const LightAliasEntry& b = pooled.GetEntries()[i];
+            if (a.alias != b.alias || a.threshold != b.threshold || a.pdf != b.pdf) differences++;
+
+            CHECK(std::abs(p[i] - weights[i] / weightSum) < 1e-6);
+            CHECK(std::abs(b.pdf - weights[i] / weightSum) <= 1e-6 * weights[i] / weightSum + 1e-12);
+            if (weights[i] == 0.f) CHECK(p[i] < 1e-9);
+        }
+        CHECK_MSG(differences == 0, std::to_string(differences) + " of " + std::to_string(count));
+    }
+
+    LightAliasTable table;
+    CHECK(!table.Build({}));
+    CHECK(!table.Build({ 0.f, -1.f, NAN }));
+    CHECK(table.IsEmpty());
+}
+
+RESTIR_TEST(LightAliasTable, PowerSamplingBeatsUniform)
+{
+    // One sample estimates of sum_i f_i, with f_i proportional to the weight up to a factor in [0.5, 1.5], like the
+    // contribution of a light follows its power up to distance and angle.
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    std::uniform_real_distribution<float> exponent(-5.f, 5.f);
+    const uint32_t count = 2000;
+    std::vector<float> weights(count), f(count);
+    double sum = 0.0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        weights[i] = std::exp(exponent(rng));
+        f[i] = weights[i] * (0.5f + unit(rng));
+        sum += f[i];
+    }
+
+    LightAliasTable table;
+    CHECK(table.Build(weights));
+
+    const uint32_t sampleCount = 500000;
+    double uniformSum = 0.0, uniformSquares = 0.0, powerSum = 0.0, powerSquares = 0.0;
+    for (uint32_t s = 0; s < sampleCount; s++)
+    {
+        uint32_t i = std::min((uint32_t)(unit(rng) * count), count - 1);
+        double uniform = (double)f[i] * count;
+        uniformSum += uniform;
+        uniformSquares += uniform * uniform;
+
+        float pdf;
+        uint32_t j = table.Sample(unit(rng), unit(rng), pdf);
+        CHECK(pdf > 0.f);
+        double power = f[j] / pdf;
+        powerSum += power;
+        powerSquares += power * power;
+    }
+
+    auto relativeStd = [&](double s, double squares) { double mean = s / sampleCount; return std::sqrt(std::max(squares / sampleCount - mean * mean, 0.0)) / sum; };
+    double uniformStd = relativeStd(uniformSum, uniformSquares);
+    double powerStd = relativeStd(powerSum, powerSquares);
+    std::printf("  relative std of one sample: uniform %.3f, power %.3f\n", uniformStd, powerStd);
+
+    CHECK_MSG(std::abs(powerSum / sampleCount / sum - 1.0) < 0.01, std::to_string(powerSum / sampleCount / sum));
+    CHECK_MSG(std::abs(uniformSum / sampleCount / sum - 1.0) < 0.05, std::to_string(uniformSum / sampleCount / sum));
+    // f / pdf stays within [0.5, 1.5] times the weight sum
+    CHECK(powerStd < 0.35);
+    CHECK(powerStd * 4.0 < uniformStd);
+}
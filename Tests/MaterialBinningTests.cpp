@@ -0,0 +1,73 @@
+#include "Testing.h"
+#include "MaterialBinning.h"
+#include "CpuThreadPool.h"
+#include <algorithm>
+#include <random>
+
+using namespace ReSTIR;
+
+RESTIR_TEST(MaterialBinning, MatchesTheNaiveBuild)
+{
+    std::mt19937 rng(4);
+    CpuThreadPool threadPool(4);
+    for (uint32_t trial = 0; trial < 100; trial++)
+    {
+        // a few bins above binCount, they land in the last bin like pixels without a surface
+        uint32_t pixelCount = trial < 50 ? rng() % 100 : rng() % 200000;
+        uint32_t binCount = 1 + rng() % 300;
+        std::vector<uint32_t> pixelBins(pixelCount);
+        for (auto& bin : pixelBins) bin = rng() % (binCount + 5);
+
+        MaterialBins naive, serial, pooled;
+        BuildMaterialBinsNaive(pixelBins, binCount, naive);
+        BuildMaterialBins(pixelBins, binCount, serial);
+        BuildMaterialBins(pixelBins, binCount, pooled, &threadPool);
+
+        CHECK(naive.GetBinCount() == binCount);
+        CHECK(serial.offsets == naive.offsets && serial.pixels == naive.pixels);
+        CHECK(pooled.offsets == naive.offsets && pooled.pixels == naive.pixels);
+        CHECK(ValidateMaterialBins(pixelBins, binCount, serial));
+        CHECK(ValidateMaterialBins(pixelBins, binCount, pooled));
+    }
+
+    MaterialBins empty;
+    BuildMaterialBins({}, 3, empty, &threadPool);
+    CHECK(empty.GetBinCount() == 3 && empty.pixels.empty());
+    CHECK(ValidateMaterialBins({}, 3, empty));
+}
+
+RESTIR_TEST(MaterialBinning, ValidationAcceptsTheGpuOrder)
+{
+    std::mt19937 rng(5);
+    const uint32_t binCount = 17;
+    std::vector<uint32_t> pixelBins(5000);
+    for (auto& bin : pixelBins) bin = rng() % binCount;
+
+    MaterialBins bins;
+    BuildMaterialBins(pixelBins, binCount, bins);
+
+    // The atomics of the shader leave a bin in any order.
+    MaterialBins shuffled = bins;
+    for (uint32_t bin = 0; bin < binCount; bin++)
+    {
+        std::shuffle(shuffled.pixels.begin() + shuffled.offsets[bin], shuffled.pixels.begin() + shuffled.offsets[bin + 1], rng);
+    }
+    CHECK(ValidateMaterialBins(pixelBins, binCount, shuffled));
+
+    // A pixel in the wrong bin, a pixel twice, or offsets that do not add up are rejected.
+    MaterialBins swapped = bins;
+    std::swap(swapped.pixels[swapped.offsets[0]], swapped.pixels[swapped.offsets[1]]);
+    CHECK(!ValidateMaterialBins(pixelBins, binCount, swapped));
+
+    MaterialBins duplicated = bins;
+    duplicated.pixels[1] = duplicated.pixels[0];
+    CHECK(!ValidateMaterialBins(pixelBins, binCount, duplicated));
+
+    MaterialBins shifted = bins;
+    shifted.offsets[1]++;
+    CHECK(!ValidateMaterialBins(pixelBins, binCount, shifted));
+
+    MaterialBins truncated = bins;
+    truncated.offsets.pop_back();
+    CHECK(!ValidateMaterialBins(pixelBins, binCount, truncated));
+}
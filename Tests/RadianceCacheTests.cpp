@@ -0,0 +1,151 @@
+#include "Testing.h"
+#include "RadianceCache.h"
+#include <cmath>
+#include <thread>
+
+using namespace ReSTIR;
+
+namespace
+{
+    constexpr uint32_t kThreadCount = 8;
+    const Vec3 kCamera(0.f, 0.f, 0.f);
+    const Vec3 kNormal(0.f, 1.f, 0.f);
+
+    /** Cell positions one cell size apart, all at distance 1..2 from the camera so they share a level. */
+    Vec3 CellPosition(uint32_t cell)
+    {
+        return Vec3(0.5f + (cell % 32) * 0.021f, 0.9f, 0.7f + (cell / 32) * 0.021f);
+    }
+
+    template<typename Function>
+    void RunThreads(const Function& function)
+    {
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < kThreadCount; t++) threads.emplace_back(function, t);
+        for (auto& thread : threads) thread.join();
+    }
+}
+
+RESTIR_TEST(RadianceCache, ConcurrentUpdatesAreNotLost)
+{
+    RadianceCacheSettings settings;
+    settings.capacity = 1u << 14;
+    settings.minSamples = 1;
+    settings.maxSamples = 1u << 24;
+    RadianceCache cache(settings);
+
+    constexpr uint32_t kCellCount = 64;
+    constexpr uint32_t kUpdatesPerThread = 20000;
+    RunThreads([&](uint32_t thread)
+    {
+        for (uint32_t i = 0; i < kUpdatesPerThread; i++)
+        {
+            // the threads walk the cells with different strides, so they collide on the same entries all the time
+            Vec3 pos = CellPosition((i * (2 * thread + 1)) % kCellCount);
+            cache.Accumulate(pos, kNormal, kCamera, Vec3(1.f, 0.5f, 0.25f));
+            Vec3 radiance;
+            cache.Lookup(pos, kNormal, kCamera, radiance);
+        }
+    });
+    CHECK(cache.GetDroppedUpdateCount() == 0);
+    CHECK(cache.GetEntryCount() == kCellCount);
+    CHECK(cache.Resolve() == 0);
+
+    float totalSamples = 0.f;
+    for (uint32_t cell = 0; cell < kCellCount; cell++)
+    {
+        Vec3 pos = CellPosition(cell);
+        uint32_t entry = cache.Find(cache.ComputeKey(pos, kNormal, kCamera));
+        CHECK(entry != RadianceCache::kInvalidEntry);
+        if (entry == RadianceCache::kInvalidEntry) continue;
+        totalSamples += cache.GetSampleCount(entry);
+
+        // the fixed point sums are exact, only the final scale rounds
+        Vec3 radiance;
+        CHECK(cache.Lookup(pos, kNormal, kCamera, radiance));
+        Vec3 error = radiance - Vec3(1.f, 0.5f, 0.25f);
+        CHECK_MSG(std::max(std::abs(error.x), std::max(std::abs(error.y), std::abs(error.z))) < 1e-6f, std::to_string(radiance.x) + " " + std::to_string(radiance.y) + " " + std::to_string(radiance.z));
+    }
+    CHECK_MSG(totalSamples == (float)(kThreadCount * kUpdatesPerThread), std::to_string(totalSamples));
+}
+
+RESTIR_TEST(RadianceCache, ConcurrentInsertsClaimOneEntryPerKey)
+{
+    RadianceCacheSettings settings;
+    settings.capacity = 1u << 12;
+    RadianceCache cache(settings);
+
+    // Keys crowded into few probe windows, so the threads race for the same free slots.
+    constexpr uint32_t kKeyCount = 2048;
+    std::vector<RadianceCacheKey> keys(kKeyCount);
+    for (uint32_t i = 0; i < kKeyCount; i++) keys[i] = { (i % 512) * 8, i + 1 };
+
+    std::vector<std::vector<uint32_t>> entries(kThreadCount, std::vector<uint32_t>(kKeyCount));
+    RunThreads([&](uint32_t thread)
+    {
+        for (uint32_t n = 0; n < kKeyCount; n++)
+        {
+            uint32_t i = (n * 7 + thread * 131) % kKeyCount;
+            entries[thread][i] = cache.Insert(keys[i]);
+        }
+    });
+
+    std::vector<uint32_t> owner(cache.GetCapacity(), 0);
+    uint32_t claimed = 0;
+    for (uint32_t i = 0; i < kKeyCount; i++)
+    {
+        uint32_t entry = entries[0][i];
+        for (uint32_t t = 1; t < kThreadCount; t++) CHECK_MSG(entries[t][i] == entry, "key " + std::to_string(i));
+        CHECK(entry == cache.Find(keys[i]));
+        if (entry == RadianceCache::kInvalidEntry) continue;
+
+        CHECK(owner[entry] == 0);
+        owner[entry] = keys[i].checksum;
+        claimed++;
+    }
+    // 4 keys per window of 8 entries, every key fits
+    CHECK(claimed == kKeyCount);
+    CHECK(cache.GetEntryCount() == claimed);
+}
+
+RESTIR_TEST(RadianceCache, CellsAreEvictedAfterMaxAge)
+{
+    RadianceCacheSettings settings;
+    settings.capacity = 1u << 10;
+    settings.minSamples = 4;
+    settings.maxAge = 3;
+    RadianceCache cache(settings);
+
+    const Vec3 stale = CellPosition(0);
+    const Vec3 live = CellPosition(1);
+    RunThreads([&](uint32_t)
+    {
+        for (uint32_t i = 0; i < 100; i++)
+        {
+            cache.Accumulate(stale, kNormal, kCamera, Vec3(2.f, 2.f, 2.f));
+            cache.Accumulate(live, kNormal, kCamera, Vec3(1.f, 1.f, 1.f));
+        }
+    });
+    CHECK(cache.Resolve() == 0);
+    Vec3 radiance;
+    CHECK(cache.Lookup(stale, kNormal, kCamera, radiance) && radiance == Vec3(2.f, 2.f, 2.f));
+
+    // Only the live cell keeps getting samples. The stale one survives maxAge resolves and goes on the next.
+    for (uint32_t resolve = 1; resolve <= settings.maxAge + 1; resolve++)
+    {
+        for (uint32_t i = 0; i < settings.minSamples; i++) cache.Accumulate(live, kNormal, kCamera, Vec3(1.f, 1.f, 1.f));
+        uint32_t evicted = cache.Resolve();
+        CHECK(evicted == (resolve == settings.maxAge + 1 ? 1u : 0u));
+        CHECK(cache.Lookup(stale, kNormal, kCamera, radiance) == (resolve <= settings.maxAge));
+    }
+    CHECK(cache.GetEntryCount() == 1);
+    CHECK(cache.Find(cache.ComputeKey(stale, kNormal, kCamera)) == RadianceCache::kInvalidEntry);
+    CHECK(cache.Lookup(live, kNormal, kCamera, radiance) && radiance == Vec3(1.f, 1.f, 1.f));
+
+    // The freed entry can be claimed again, and starts empty.
+    CHECK(cache.Accumulate(stale, kNormal, kCamera, Vec3(3.f, 3.f, 3.f)));
+    cache.Resolve();
+    uint32_t entry = cache.Find(cache.ComputeKey(stale, kNormal, kCamera));
+    CHECK(entry != RadianceCache::kInvalidEntry && cache.GetSampleCount(entry) == 1.f);
+    CHECK(!cache.Lookup(stale, kNormal, kCamera, radiance));
+}
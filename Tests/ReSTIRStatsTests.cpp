@@ -0,0 +1,94 @@
+#include "Testing.h"
+#include "ReSTIRStats.h"
+#include <algorithm>
+
+using namespace ReSTIR;
+
+namespace
+{
+    std::array<uint64_t, kStatsCounterCount> MakeCounters(uint64_t base)
+    {
+        std::array<uint64_t, kStatsCounterCount> counters;
+        for (uint32_t i = 0; i < kStatsCounterCount; i++) counters[i] = base + i;
+        return counters;
+    }
+}
+
+RESTIR_TEST(ReSTIRStats, CountersKeepSixtyFourBits)
+{
+    // An M sum at 4k with M around 600 passes 2^32 within one frame, the pixel count of the total after 518 frames.
+    const uint64_t pixelCount = 3840 * 2160;
+    const uint64_t frameCount = 600;
+    auto counters = MakeCounters(0);
+    counters[(uint32_t)StatsCounter::TemporalPixels] = pixelCount;
+    counters[(uint32_t)StatsCounter::TemporalMSum] = pixelCount * 600ull;
+    counters[(uint32_t)StatsCounter::VisibilityRays] = pixelCount * 3ull;
+
+    StatsAggregator aggregator;
+    for (uint64_t i = 1; i <= frameCount; i++) aggregator.AddFrame(i, (uint32_t)pixelCount, counters.data());
+
+    const FrameStatistics& frame = aggregator.GetFrames().back();
+    CHECK(frame.Get(StatsCounter::TemporalMSum) == pixelCount * 600ull);
+    CHECK(frame.GetAverageTemporalM() == 600.0);
+    CHECK(aggregator.ToCsv().find(std::to_string(pixelCount * 600ull)) != std::string::npos);
+
+    FrameStatistics total = aggregator.GetTotal();
+    CHECK(total.pixelCount == frameCount * pixelCount);
+    CHECK(total.Get(StatsCounter::TemporalMSum) == frameCount * pixelCount * 600ull);
+    CHECK(total.GetRaysPerPixel() == 3.0);
+    CHECK(total.GetAverageTemporalM() == 600.0);
+}
+
+RESTIR_TEST(ReSTIRStats, CsvHasOneColumnPerValue)
+{
+    StatsAggregator aggregator;
+    auto counters = MakeCounters(10);
+    aggregator.AddFrame(5, 100, counters.data());
+    aggregator.AddFrame(6, 100, counters.data(), { { "resampling", 1.5, 0.25 }, { "finalShading", 0.5, 0.125 } });
+    aggregator.AddFrame(7, 100, counters.data(), { { "finalShading", 0.75, 0.125 } });
+
+    std::string csv = aggregator.ToCsv();
+    std::vector<std::string> lines;
+    for (size_t start = 0, end; (end = csv.find('\n', start)) != std::string::npos; start = end + 1) lines.push_back(csv.substr(start, end - start));
+    CHECK(lines.size() == 4);
+
+    auto columns = [](const std::string& line) { return 1 + std::count(line.begin(), line.end(), ','); };
+    for (const auto& line : lines) CHECK_MSG(columns(line) == columns(lines[0]), line);
+
+    CHECK(lines[0].find(",resamplingGpuMs,resamplingCpuMs,finalShadingGpuMs,finalShadingCpuMs") != std::string::npos);
+    CHECK(lines[0].find(GetStatsCounterName(StatsCounter::PathRays)) != std::string::npos);
+    // frame 5 had no profiler data, frame 7 had no resampling scope
+    CHECK(lines[1].size() >= 4 && lines[1].compare(lines[1].size() - 4, 4, ",,,,") == 0);
+    CHECK(lines[3].find(",,,0.75,0.125") != std::string::npos);
+}
+
+RESTIR_TEST(ReSTIRStats, JsonHasCountersAndTimings)
+{
+    StatsAggregator aggregator;
+    auto counters = MakeCounters(1ull << 40);
+    aggregator.AddFrame(3, 64, counters.data(), { { "capture", 2.0, 1.0 } });
+
+    std::string json = aggregator.ToJson();
+    CHECK(json.find("\"frame\": 3") != std::string::npos);
+    CHECK(json.find("\"temporalPixels\": " + std::to_string(1ull << 40)) != std::string::npos);
+    CHECK(json.find("\"passTimings\": { \"capture\": { \"gpuMs\": 2, \"cpuMs\": 1 } }") != std::string::npos);
+
+    aggregator.Clear();
+    CHECK(aggregator.IsEmpty());
+    CHECK(aggregator.ToCsv().find("GpuMs") == std::string::npos);
+}
+
+RESTIR_TEST(ReSTIRStats, MaxFrameCountKeepsTheNewestFrames)
+{
+    StatsAggregator aggregator;
+    auto counters = MakeCounters(0);
+    for (uint64_t f = 0; f < 10; f++) aggregator.AddFrame(f, 1, counters.data());
+    aggregator.SetMaxFrameCount(4);
+    CHECK(aggregator.GetFrames().size() == 4);
+    CHECK(aggregator.GetFrames().front().frameIndex == 6);
+
+    aggregator.AddFrame(10, 1, counters.data());
+    CHECK(aggregator.GetFrames().size() == 4);
+    CHECK(aggregator.GetTotal().frameIndex == 10);
+    CHECK(aggregator.GetTotal().pixelCount == 4);
+}
@@ -0,0 +1,205 @@
+#include "Testing.h"
+#include "ReservoirCapture.h"
+#include "CpuGBuffer.h"
+#include <cstdio>
+#include <cstring>
+
+using namespace ReSTIR;
+
+namespace
+{
+    constexpr uint32_t kWidth = 7;
+    constexpr uint32_t kHeight = 5;
+    constexpr uint32_t kPixelCount = kWidth * kHeight;
+    const char* kSampleChannels[] = { "vPosW", "vNormW", "sPosW", "sNormW", "sColor" };
+
+    /** A small capture with every section the pass writes. The temporal reservoirs count M = i % 5, one has a negative weight. */
+    ReservoirCaptureWriter MakeCapture(uint32_t slotCount = 2, uint32_t curSlot = 1, uint32_t lastSlot = 0)
+    {
+        ReservoirCaptureWriter writer;
+        writer.GetHeader().width = kWidth;
+        writer.GetHeader().height = kHeight;
+        writer.GetHeader().frameIndex = 42;
+        writer.GetHeader().temCurOffset = curSlot;
+        writer.GetHeader().temLastOffset = lastSlot;
+        writer.GetHeader().temporalSlotCount = slotCount;
+
+        std::vector<Reservoir> initial(kPixelCount), temporal(slotCount * kPixelCount), spatial(kPixelCount);
+        for (uint32_t i = 0; i < slotCount * kPixelCount; i++)
+        {
+            temporal[i].M = i % 5;
+            temporal[i].weightF = 0.25f * i;
+        }
+        temporal[3].weightF = -1.f;
+        for (uint32_t i = 0; i < kPixelCount; i++) spatial[i].M = 1;
+
+        writer.AddSection(CaptureSectionType::InitialReservoirs, "initialReservoirs", sizeof(Reservoir), initial.data(), initial.size() * sizeof(Reservoir));
+        writer.AddSection(CaptureSectionType::TemporalReservoirs, "temporalReservoirBuffer", sizeof(Reservoir), temporal.data(), temporal.size() * sizeof(Reservoir));
+        writer.AddSection(CaptureSectionType::SpatialReservoirs, "spatialReservoirBuffer", sizeof(Reservoir), spatial.data(), spatial.size() * sizeof(Reservoir));
+
+        CaptureCamera camera = {};
+        camera.position[1] = 2.f;
+        writer.AddSection(CaptureSectionType::Camera, "camera", sizeof(camera), &camera, sizeof(camera));
+
+        std::vector<float> float4(4 * kPixelCount), float1(kPixelCount, 0.5f);
+        for (uint32_t i = 0; i < 4 * kPixelCount; i++) float4[i] = (float)i;
+        for (const char* channel : kSampleChannels) writer.AddTexture(channel, CaptureFormat::Float4, 16, kWidth, kHeight, float4.data());
+        writer.AddTexture("random", CaptureFormat::Float, 4, kWidth, kHeight, float1.data());
+        return writer;
+    }
+
+    std::vector<uint8_t> ReadFile(const std::string& path)
+    {
+        std::vector<uint8_t> bytes;
+        if (FILE* file = std::fopen(path.c_str(), "rb"))
+        {
+            std::fseek(file, 0, SEEK_END);
+            bytes.resize((size_t)std::ftell(file));
+            std::fseek(file, 0, SEEK_SET);
+            if (std::fread(bytes.data(), 1, bytes.size(), file) != bytes.size()) bytes.clear();
+            std::fclose(file);
+        }
+        return bytes;
+    }
+
+    void WriteFile(const std::string& path, const std::vector<uint8_t>& bytes)
+    {
+        FILE* file = std::fopen(path.c_str(), "wb");
+        std::fwrite(bytes.data(), 1, bytes.size(), file);
+        std::fclose(file);
+    }
+}
+
+RESTIR_TEST(ReservoirCapture, RoundTrip)
+{
+    Testing::TempDirectory directory("capture");
+    const std::string path = directory.GetPath() + "/frame.rstc";
+    CHECK(MakeCapture().Write(path));
+
+    ReservoirCaptureReader reader;
+    CHECK_MSG(reader.Open(path, true), reader.GetError());
+    CHECK(reader.GetHeader().frameIndex == 42);
+    CHECK(reader.GetPixelCount() == kPixelCount);
+    CHECK(reader.GetSectionCount() == 10);
+    for (uint32_t i = 0; i < reader.GetSectionCount(); i++) CHECK(reader.GetSections()[i].offset % kCaptureSectionAlignment == 0);
+
+    size_t count = 0;
+    const Reservoir* temporal = reader.GetReservoirs(CaptureSectionType::TemporalReservoirs, count);
+    CHECK(temporal && count == 2 * kPixelCount);
+    CHECK(reader.GetTemporalSlot(0) == temporal);
+    CHECK(reader.GetTemporalSlot(1) == temporal + kPixelCount);
+    CHECK(reader.GetTemporalSlot(1)[2].M == (kPixelCount + 2) % 5);
+    CHECK(reader.GetTemporalSlot(2) == nullptr);
+
+    CaptureReservoirStats stats = ComputeReservoirStats(temporal, count);
+    CHECK(stats.count == 70);
+    CHECK(stats.emptyCount == 14);
+    CHECK(stats.invalidCount == 1);
+    CHECK(stats.mMax == 4);
+    CHECK(stats.mHistogram[4] == 14);
+    CHECK(stats.weightMax == 0.25 * 69);
+    CHECK(stats.ToJson().find("\"count\": 70, \"empty\": 14, \"invalid\": 1") != std::string::npos);
+
+    const CaptureSectionEntry* pCamera = reader.FindSection(CaptureSectionType::Camera);
+    CHECK(pCamera && static_cast<const CaptureCamera*>(reader.GetSectionData(*pCamera))->position[1] == 2.f);
+    CHECK(reader.FindSection(CaptureSectionType::Texture, "sColor") != nullptr);
+    CHECK(reader.FindSection(CaptureSectionType::Texture, "depth") == nullptr);
+
+    CpuGBuffer gbuffer;
+    CHECK(reader.LoadGBuffer(gbuffer));
+    CHECK(gbuffer.width == kWidth && gbuffer.height == kHeight);
+    CHECK(gbuffer.sColor.size() == kPixelCount && gbuffer.sColor[1] == Vec3(4.f, 5.f, 6.f));
+    CHECK(gbuffer.random.size() == kPixelCount && gbuffer.random[0] == 0.5f);
+    CHECK(gbuffer.depth.empty());
+}
+
+RESTIR_TEST(ReservoirCapture, CorruptFilesAreRejected)
+{
+    Testing::TempDirectory directory("capture");
+    const std::string path = directory.GetPath() + "/frame.rstc";
+    const std::string corruptPath = directory.GetPath() + "/corrupt.rstc";
+    CHECK(MakeCapture().Write(path));
+    const std::vector<uint8_t> original = ReadFile(path);
+    CHECK(!original.empty());
+
+    auto openCorrupted = [&](auto&& corrupt, bool verifyChecksums)
+    {
+        std::vector<uint8_t> bytes = original;
+        corrupt(bytes);
+        WriteFile(corruptPath, bytes);
+        ReservoirCaptureReader reader;
+        bool opened = reader.Open(corruptPath, verifyChecksums);
+        CHECK(opened || !reader.GetError().empty());
+        return opened;
+    };
+    auto header = [](std::vector<uint8_t>& bytes) { return reinterpret_cast<CaptureFileHeader*>(bytes.data()); };
+    auto section = [](std::vector<uint8_t>& bytes, uint32_t i) { return reinterpret_cast<CaptureSectionEntry*>(bytes.data() + sizeof(CaptureFileHeader)) + i; };
+
+    // A flipped data byte is only found by the checksums.
+    auto flipData = [&](std::vector<uint8_t>& bytes) { bytes[section(bytes, 1)->offset + 5] ^= 0x55; };
+    CHECK(!openCorrupted(flipData, true));
+    CHECK(openCorrupted(flipData, false));
+
+    CHECK(!openCorrupted([](std::vector<uint8_t>& bytes) { bytes.resize(bytes.size() - 1); }, false));
+    CHECK(!openCorrupted([](std::vector<uint8_t>& bytes) { bytes.resize(sizeof(CaptureFileHeader) - 1); }, false));
+    CHECK(!openCorrupted([&](std::vector<uint8_t>& bytes) { header(bytes)->magic[0] = 'X'; }, false));
+    CHECK(!openCorrupted([&](std::vector<uint8_t>& bytes) { header(bytes)->version = kCaptureVersion + 1; }, false));
+    CHECK(!openCorrupted([&](std::vector<uint8_t>& bytes) { header(bytes)->reservoirStride = 16; }, false));
+    CHECK(!openCorrupted([&](std::vector<uint8_t>& bytes) { header(bytes)->sectionCount = 1000000; }, false));
+    CHECK(!openCorrupted([&](std::vector<uint8_t>& bytes) { header(bytes)->width = kWidth + 1; }, false));
+    CHECK(!openCorrupted([&](std::vector<uint8_t>& bytes) { section(bytes, 0)->offset += 16; }, false));
+    CHECK(!openCorrupted([&](std::vector<uint8_t>& bytes) { section(bytes, 2)->size += kCaptureSectionAlignment * 1000; }, false));
+    CHECK(!openCorrupted([&](std::vector<uint8_t>& bytes) { section(bytes, 3)->size -= 1; }, false));
+    CHECK(!openCorrupted([&](std::vector<uint8_t>& bytes) { header(bytes)->temporalSlotCount = 3; }, false));
+    CHECK(!openCorrupted([&](std::vector<uint8_t>& bytes) { header(bytes)->temporalSlotCount = 0; }, false));
+    CHECK(!openCorrupted([&](std::vector<uint8_t>& bytes) { header(bytes)->temCurOffset = 2; }, false));
+    CHECK(!openCorrupted([&](std::vector<uint8_t>& bytes) { std::memset(section(bytes, 4)->name, 'a', sizeof(CaptureSectionEntry::name)); }, false));
+
+    ReservoirCaptureReader missing;
+    CHECK(!missing.Open(directory.GetPath() + "/missing.rstc"));
+    CHECK(!missing.IsOpen());
+}
+
+RESTIR_TEST(ReservoirCapture, LongerRingsKeepEverySlot)
+{
+    Testing::TempDirectory directory("capture");
+    const std::string path = directory.GetPath() + "/ring.rstc";
+    CHECK(MakeCapture(5, 4, 3).Write(path));
+
+    ReservoirCaptureReader reader;
+    CHECK_MSG(reader.Open(path, true), reader.GetError());
+    CHECK(reader.GetHeader().temporalSlotCount == 5);
+
+    size_t count = 0;
+    const Reservoir* temporal = reader.GetReservoirs(CaptureSectionType::TemporalReservoirs, count);
+    CHECK(temporal && count == 5 * kPixelCount);
+    for (uint32_t slot = 0; slot < 5; slot++) CHECK(reader.GetTemporalSlot(slot) == temporal + slot * kPixelCount);
+    CHECK(reader.GetTemporalSlot(5) == nullptr);
+    CHECK(reader.GetTemporalSlot(reader.GetHeader().temCurOffset)[1].M == (4 * kPixelCount + 1) % 5);
+
+    // The slot count has to match the section, a two slot capture does not open as a five slot one.
+    ReservoirCaptureWriter mismatched = MakeCapture();
+    mismatched.GetHeader().temporalSlotCount = 5;
+    CHECK(mismatched.Write(path));
+    CHECK(!reader.Open(path));
+}
+
+RESTIR_TEST(ReservoirCapture, GBufferNeedsEverySampleChannel)
+{
+    Testing::TempDirectory directory("capture");
+    const std::string path = directory.GetPath() + "/fused.rstc";
+
+    ReservoirCaptureWriter writer;
+    writer.GetHeader().width = kWidth;
+    writer.GetHeader().height = kHeight;
+    std::vector<float> float4(4 * kPixelCount, 1.f);
+    writer.AddTexture("vPosW", CaptureFormat::Float4, 16, kWidth, kHeight, float4.data());
+    CHECK(writer.Write(path));
+
+    ReservoirCaptureReader reader;
+    CHECK_MSG(reader.Open(path, true), reader.GetError());
+    CpuGBuffer gbuffer;
+    CHECK(!reader.LoadGBuffer(gbuffer));
+    CHECK(gbuffer.vPosW.empty());
+    CHECK(reader.GetTemporalSlot(0) == nullptr);
+}
@@ -0,0 +1,126 @@
+#include "Testing.h"
+#include "ReservoirPacking.h"
+#include <random>
+
+using namespace ReSTIR;
+
+namespace
+{
+    // 16 bit octahedral snorm, the quantization step on the octahedron is 2 / 32767 and maps to at most ~1.5x that angle.
+    constexpr float kMaxNormalAngle = 1e-3f;
+    // 9 bit mantissas with a shared exponent, the brightest channel keeps at least 256 steps. Below 2^-16 the exponent
+    // is clamped and the error stays below half of the smallest step, 2^-25.
+    constexpr float kMaxRadianceRelError = 1.f / 512.f + 1e-6f;
+    constexpr float kMinRGB9E5Normal = 1.f / 65536.f;
+    const float kMaxRadianceAbsError = std::exp2(-25.f);
+
+    Vec3 RandomDirection(std::mt19937& rng)
+    {
+        std::normal_distribution<float> normal;
+        Vec3 v;
+        do v = Vec3(normal(rng), normal(rng), normal(rng)); while (Length(v) < 1e-4f);
+        return Normalize(v);
+    }
+
+    Reservoir RandomReservoir(std::mt19937& rng)
+    {
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+        std::uniform_real_distribution<float> position(-100.f, 100.f);
+        std::uniform_real_distribution<float> exponent(-14.f, 15.f);
+
+        Reservoir r;
+        r.z.vPos = Vec3(position(rng), position(rng), position(rng));
+        r.z.sPos = Vec3(position(rng), position(rng), position(rng));
+        r.z.vNorm = RandomDirection(rng);
+        r.z.sNorm = RandomDirection(rng);
+        // Channels a few decades apart, as for saturated colors. The brightest one stays above kMinRGB9E5Normal.
+        float scale = std::exp2(exponent(rng));
+        r.z.radiance = Vec3(0.5f + 0.5f * unit(rng), unit(rng) * 0.01f, unit(rng) * 1e-4f) * scale;
+        r.weightF = unit(rng) * 50.f;
+        r.M = rng() % 1000;
+        r.age = (int32_t)(rng() % 500);
+        return r;
+    }
+}
+
+RESTIR_TEST(ReservoirPacking, OctahedralErrorBound)
+{
+    std::mt19937 rng(1);
+    float maxAngle = 0.f;
+    auto check = [&](const Vec3& n)
+    {
+        Vec3 decoded = DecodeOctahedral(EncodeOctahedral(n));
+        CHECK(std::abs(Length(decoded) - 1.f) < 1e-5f);
+        maxAngle = std::max(maxAngle, std::acos(std::clamp(Dot(n, decoded), -1.f, 1.f)));
+    };
+
+    for (uint32_t i = 0; i < 200000; i++) check(RandomDirection(rng));
+    for (const Vec3& n : { Vec3(0, 0, 1), Vec3(0, 0, -1), Vec3(1, 0, 0), Vec3(-1, 0, 0), Vec3(0, 1, 0), Vec3(0, -1, 0), Normalize(Vec3(1, -1, -1e-7f)) }) check(n);
+    CHECK_MSG(maxAngle <= kMaxNormalAngle, std::to_string(maxAngle));
+
+    CHECK(EncodeOctahedral(Vec3()) == kOctahedralZero);
+    CHECK(IsZero(DecodeOctahedral(kOctahedralZero)));
+}
+
+RESTIR_TEST(ReservoirPacking, RGB9E5ErrorBound)
+{
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    std::uniform_real_distribution<float> exponent(-24.f, 15.9f);
+
+    float maxError = 0.f;
+    uint32_t failures = 0;
+    for (uint32_t i = 0; i < 200000; i++)
+    {
+        Vec3 c = Vec3(unit(rng), unit(rng), unit(rng)) * std::exp2(exponent(rng));
+        Vec3 d = DecodeRGB9E5(EncodeRGB9E5(c)) - c;
+        float maxC = std::max(c.x, std::max(c.y, c.z));
+        float error = std::max(std::abs(d.x), std::max(std::abs(d.y), std::abs(d.z)));
+        if (maxC >= kMinRGB9E5Normal) maxError = std::max(maxError, error / maxC);
+        else if (error > kMaxRadianceAbsError) failures++;
+    }
+    CHECK_MSG(maxError <= kMaxRadianceRelError, std::to_string(maxError));
+    CHECK(failures == 0);
+
+    CHECK(EncodeRGB9E5(Vec3()) == 0);
+    CHECK(IsZero(DecodeRGB9E5(EncodeRGB9E5(Vec3(-1.f, -2.f, 0.f)))));
+    Vec3 clamped = DecodeRGB9E5(EncodeRGB9E5(Vec3(1e9f, 1.f, 0.f)));
+    CHECK(clamped.x == kRGB9E5MaxValue);
+}
+
+RESTIR_TEST(ReservoirPacking, ReservoirRoundTrip)
+{
+    std::mt19937 rng(3);
+    PackingError error;
+    for (uint32_t i = 0; i < 100000; i++)
+    {
+        Reservoir r = RandomReservoir(rng);
+        Reservoir decoded = Unpack(Pack(r), r.z.vPos);
+        CHECK(decoded.z.vPos == r.z.vPos);
+        CHECK(decoded.z.sPos == r.z.sPos);
+        CHECK(decoded.weightF == r.weightF);
+        CHECK(decoded.M == r.M);
+        CHECK(decoded.age == r.age);
+        MeasureRoundTrip(r, error);
+    }
+    MeasureRoundTrip(Reservoir(), error);
+
+    CHECK(error.reservoirCount == 100001);
+    CHECK(error.countMismatches == 0);
+    CHECK_MSG(error.maxNormalAngle <= kMaxNormalAngle, std::to_string(error.maxNormalAngle));
+    CHECK_MSG(error.maxRadianceRelError <= kMaxRadianceRelError, std::to_string(error.maxRadianceRelError));
+}
+
+RESTIR_TEST(ReservoirPacking, CountsAboveSixteenBitsAreClamped)
+{
+    Reservoir r;
+    r.M = 70000;
+    r.age = 1 << 20;
+    PackingError error;
+    MeasureRoundTrip(r, error);
+    CHECK(error.countMismatches == 1);
+
+    Reservoir decoded = Unpack(Pack(r), r.z.vPos);
+    CHECK(decoded.M == 0xffffu);
+    CHECK(decoded.age == 0xffff);
+}
@@ -0,0 +1,165 @@
+#include "Testing.h"
+#include "ResourceLifetimePlanner.h"
+#include <random>
+
+using namespace ReSTIR;
+
+namespace
+{
+    bool Overlaps(const TransientResourceDesc& a, const TransientResourceDesc& b)
+    {
+        return a.firstStage <= b.lastStage && b.firstStage <= a.lastStage;
+    }
+
+    /** The invariants every plan has to hold, independent of the placement heuristic. */
+    void CheckPlan(const ResourceLifetimePlanner& planner, const ResourcePlan& plan)
+    {
+        const auto& resources = planner.GetResources();
+        CHECK(plan.allocationOf.size() == resources.size());
+
+        uint64_t requested = 0, skipped = 0, allocated = 0;
+        for (size_t i = 0; i < resources.size(); i++)
+        {
+            if (!resources[i].used)
+            {
+                CHECK(plan.allocationOf[i] == ResourcePlan::kSkipped);
+                skipped += resources[i].size;
+                continue;
+            }
+            requested += resources[i].size;
+            CHECK(plan.allocationOf[i] >= 0 && plan.allocationOf[i] < (int32_t)plan.allocations.size());
+        }
+
+        for (size_t a = 0; a < plan.allocations.size(); a++)
+        {
+            const auto& allocation = plan.allocations[a];
+            allocated += allocation.size;
+            CHECK(!allocation.resources.empty());
+            if (allocation.persistent) CHECK(allocation.resources.size() == 1);
+            for (size_t i = 0; i < allocation.resources.size(); i++)
+            {
+                const auto& desc = resources[allocation.resources[i]];
+                CHECK(plan.allocationOf[allocation.resources[i]] == (int32_t)a);
+                CHECK(desc.aliasGroup == allocation.aliasGroup);
+                CHECK(desc.size <= allocation.size);
+                for (size_t j = i + 1; j < allocation.resources.size(); j++) CHECK(!Overlaps(desc, resources[allocation.resources[j]]));
+            }
+        }
+
+        CHECK(plan.requestedBytes == requested);
+        CHECK(plan.skippedBytes == skipped);
+        CHECK(plan.allocatedBytes == allocated);
+        CHECK(plan.allocatedBytes <= plan.requestedBytes);
+    }
+}
+
+RESTIR_TEST(ResourceLifetimePlanner, RejectsInvalidIntervals)
+{
+    ResourceLifetimePlanner planner;
+    uint32_t a = planner.AddStage("a");
+    uint32_t b = planner.AddStage("b");
+    CHECK_THROWS(planner.AddResource({ "reversed", 16, b, a, "uint" }));
+    CHECK_THROWS(planner.AddResource({ "past the end", 16, a, b + 1, "uint" }));
+    CHECK(planner.GetResources().empty());
+}
+
+RESTIR_TEST(ResourceLifetimePlanner, OverlappingLifetimesAreNotAliased)
+{
+    ResourceLifetimePlanner planner;
+    uint32_t s0 = planner.AddStage("initial");
+    uint32_t s1 = planner.AddStage("resample");
+    uint32_t s2 = planner.AddStage("shade");
+
+    uint32_t first = planner.AddResource({ "first", 100, s0, s1, "Reservoir" });
+    uint32_t overlapping = planner.AddResource({ "overlapping", 50, s1, s2, "Reservoir" });
+    uint32_t disjoint = planner.AddResource({ "disjoint", 200, s2, s2, "Reservoir" });
+
+    ResourcePlan plan = planner.Plan();
+    CheckPlan(planner, plan);
+    CHECK(plan.allocationOf[first] != plan.allocationOf[overlapping]);
+    CHECK(plan.allocationOf[first] == plan.allocationOf[disjoint]);
+    CHECK(plan.allocations[plan.allocationOf[first]].size == 200);
+    CHECK(plan.allocatedBytes == 250);
+}
+
+RESTIR_TEST(ResourceLifetimePlanner, AliasGroupsAreSeparate)
+{
+    ResourceLifetimePlanner planner;
+    uint32_t s0 = planner.AddStage("a");
+    uint32_t s1 = planner.AddStage("b");
+
+    uint32_t reservoirs = planner.AddResource({ "reservoirs", 64, s0, s0, "Reservoir" });
+    uint32_t floats = planner.AddResource({ "floats", 64, s1, s1, "float" });
+    uint32_t uints = planner.AddResource({ "uints", 32, s1, s1, "uint" });
+    uint32_t moreUints = planner.AddResource({ "more uints", 32, s0, s0, "uint" });
+
+    ResourcePlan plan = planner.Plan();
+    CheckPlan(planner, plan);
+    CHECK(plan.allocationOf[reservoirs] != plan.allocationOf[floats]);
+    CHECK(plan.allocationOf[floats] != plan.allocationOf[uints]);
+    CHECK(plan.allocationOf[uints] == plan.allocationOf[moreUints]);
+    CHECK(plan.allocations.size() == 3);
+}
+
+RESTIR_TEST(ResourceLifetimePlanner, PersistentResourcesAreNeverAliased)
+{
+    ResourceLifetimePlanner planner;
+    uint32_t s0 = planner.AddStage("a");
+    uint32_t s1 = planner.AddStage("b");
+
+    uint32_t history = planner.AddResource({ "history", 128, s0, s0, "Reservoir", true });
+    uint32_t transient = planner.AddResource({ "transient", 64, s1, s1, "Reservoir" });
+    uint32_t otherHistory = planner.AddResource({ "other history", 32, s1, s1, "Reservoir", true });
+
+    ResourcePlan plan = planner.Plan();
+    CheckPlan(planner, plan);
+    CHECK(plan.allocations[plan.allocationOf[history]].persistent);
+    CHECK(plan.allocationOf[history] != plan.allocationOf[transient]);
+    CHECK(plan.allocationOf[history] != plan.allocationOf[otherHistory]);
+    CHECK(plan.allocationOf[transient] != plan.allocationOf[otherHistory]);
+    CHECK(plan.allocatedBytes == 224);
+}
+
+RESTIR_TEST(ResourceLifetimePlanner, UnusedResourcesAreSkipped)
+{
+    ResourceLifetimePlanner planner;
+    uint32_t s0 = planner.AddStage("a");
+
+    uint32_t used = planner.AddResource({ "used", 10, s0, s0, "uint" });
+    uint32_t unused = planner.AddResource({ "unused", 1000, s0, s0, "uint", false, false });
+
+    ResourcePlan plan = planner.Plan();
+    CheckPlan(planner, plan);
+    CHECK(plan.allocationOf[used] != ResourcePlan::kSkipped);
+    CHECK(plan.allocationOf[unused] == ResourcePlan::kSkipped);
+    CHECK(plan.skippedBytes == 1000);
+    CHECK(plan.requestedBytes == 10);
+    CHECK(planner.FormatReport(plan, 1, 1).find("unused: 1000 B, unused") != std::string::npos);
+}
+
+RESTIR_TEST(ResourceLifetimePlanner, RandomPlansHoldTheInvariants)
+{
+    std::mt19937 rng(7);
+    const char* groups[] = { "Reservoir", "uint", "float" };
+    for (uint32_t iteration = 0; iteration < 500; iteration++)
+    {
+        ResourceLifetimePlanner planner;
+        uint32_t stageCount = 1 + rng() % 6;
+        for (uint32_t s = 0; s < stageCount; s++) planner.AddStage("stage " + std::to_string(s));
+
+        uint32_t resourceCount = rng() % 12;
+        for (uint32_t r = 0; r < resourceCount; r++)
+        {
+            TransientResourceDesc desc;
+            desc.name = "r" + std::to_string(r);
+            desc.size = 1 + rng() % 4096;
+            desc.firstStage = rng() % stageCount;
+            desc.lastStage = desc.firstStage + rng() % (stageCount - desc.firstStage);
+            desc.aliasGroup = groups[rng() % 3];
+            desc.persistent = rng() % 5 == 0;
+            desc.used = rng() % 6 != 0;
+            planner.AddResource(desc);
+        }
+        CheckPlan(planner, planner.Plan());
+    }
+}
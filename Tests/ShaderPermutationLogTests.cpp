@@ -0,0 +1,144 @@
+#include "Testing.h"
+#include "ShaderPermutationLog.h"
+#include <fstream>
+
+using namespace ReSTIR;
+
+namespace
+{
+    ShaderPermutationDesc MakeDesc()
+    {
+        ShaderPermutationDesc desc;
+        desc.programName = "SpatialtemporalResample.cs.slang:main";
+        desc.sources = { "SpatialtemporalResample.cs.slang" };
+        desc.entryPoints = { "main" };
+        desc.shaderModel = "6_5";
+        desc.defines = { { "TILED_SPATIAL_REUSE", "1" }, { "RESTIR_STATS", "0" } };
+        desc.typeConformances = { { "StandardMaterial", "IMaterial#1" }, { "HairMaterial", "IMaterial#2" } };
+        desc.sourceHash = 0x1234;
+        desc.toolchain = "Falcor 5.2";
+        return desc;
+    }
+
+    void WriteText(const std::filesystem::path& path, const std::string& text)
+    {
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream file(path, std::ios::binary);
+        file << text;
+    }
+}
+
+RESTIR_TEST(ShaderPermutationLog, KeyIgnoresOrderAndName)
+{
+    const ShaderPermutationDesc desc = MakeDesc();
+    const uint64_t key = ComputePermutationKey(desc);
+    CHECK(key == ComputePermutationKey(MakeDesc()));
+
+    ShaderPermutationDesc same = desc;
+    same.programName = "other name";
+    same.defines = { { "RESTIR_STATS", "1" }, { "TILED_SPATIAL_REUSE", "1" }, { "RESTIR_STATS", "0" } };
+    same.typeConformances = { { "HairMaterial", "IMaterial#2" }, { "StandardMaterial", "IMaterial#1" }, { "HairMaterial", "IMaterial#2" } };
+    CHECK(same.GetCanonicalString() == desc.GetCanonicalString());
+    CHECK(ComputePermutationKey(same) == key);
+}
+
+RESTIR_TEST(ShaderPermutationLog, KeyCoversEveryCompileInput)
+{
+    const uint64_t key = ComputePermutationKey(MakeDesc());
+    std::vector<void (*)(ShaderPermutationDesc&)> changes =
+    {
+        [](ShaderPermutationDesc& d) { d.sources.push_back("Extra.slang"); },
+        [](ShaderPermutationDesc& d) { d.entryPoints = { "temporalMain" }; },
+        [](ShaderPermutationDesc& d) { d.shaderModel = "6_6"; },
+        [](ShaderPermutationDesc& d) { d.options.push_back("payload=64"); },
+        [](ShaderPermutationDesc& d) { d.defines.push_back({ "RESTIR_STATS", "1" }); },
+        [](ShaderPermutationDesc& d) { d.defines.push_back({ "NEW_DEFINE", "" }); },
+        [](ShaderPermutationDesc& d) { d.typeConformances.pop_back(); },
+        [](ShaderPermutationDesc& d) { d.sourceHash++; },
+        [](ShaderPermutationDesc& d) { d.toolchain = "Falcor 5.3"; },
+    };
+    for (size_t i = 0; i < changes.size(); i++)
+    {
+        ShaderPermutationDesc changed = MakeDesc();
+        changes[i](changed);
+        CHECK_MSG(ComputePermutationKey(changed) != key, "change " + std::to_string(i));
+    }
+
+    // the entry points keep their order, it is the binding table order
+    ShaderPermutationDesc ordered = MakeDesc(), reordered = MakeDesc();
+    ordered.entryPoints = { "a", "b" };
+    reordered.entryPoints = { "b", "a" };
+    CHECK(ComputePermutationKey(reordered) != ComputePermutationKey(ordered));
+}
+
+RESTIR_TEST(ShaderPermutationLog, FieldsAreLengthPrefixed)
+{
+    // Without the length prefix these would concatenate to the same text.
+    ShaderPermutationDesc a = MakeDesc(), b = MakeDesc();
+    a.defines = { { "A", "1\ndefine 3:B=2" } };
+    b.defines = { { "A", "1" }, { "B", "2" } };
+    CHECK(a.GetCanonicalString() != b.GetCanonicalString());
+    CHECK(ComputePermutationKey(a) != ComputePermutationKey(b));
+
+    a = MakeDesc();
+    b = MakeDesc();
+    a.sources = { "ab", "c" };
+    b.sources = { "a", "bc" };
+    CHECK(ComputePermutationKey(a) != ComputePermutationKey(b));
+
+    CHECK(FormatPermutationKey(0) == "0000000000000000");
+    CHECK(FormatPermutationKey(0x0123456789abcdefull) == "0123456789abcdef");
+}
+
+RESTIR_TEST(ShaderPermutationLog, DirectoryHashFollowsTheShaders)
+{
+    Testing::TempDirectory directory("shaders");
+    const std::filesystem::path root = directory.GetPath();
+    WriteText(root / "A.slang", "void a() {}");
+    WriteText(root / "Sub/B.slangh", "void b() {}");
+    WriteText(root / "Notes.txt", "not a shader");
+
+    const std::vector<std::string> extensions = { ".slang", ".slangh" };
+    const uint64_t hash = HashShaderDirectory(root, extensions);
+    CHECK(hash != 0);
+    CHECK(HashShaderDirectory(root, extensions) == hash);
+
+    WriteText(root / "Notes.txt", "edited");
+    CHECK(HashShaderDirectory(root, extensions) == hash);
+
+    WriteText(root / "Sub/B.slangh", "void b() { }");
+    uint64_t edited = HashShaderDirectory(root, extensions);
+    CHECK(edited != hash);
+
+    std::filesystem::rename(root / "Sub/B.slangh", root / "Sub/C.slangh");
+    CHECK(HashShaderDirectory(root, extensions) != edited);
+
+    CHECK(HashShaderDirectory(root / "missing", extensions) == 0);
+}
+
+RESTIR_TEST(ShaderPermutationLog, CompileLogPersistsAcrossRuns)
+{
+    Testing::TempDirectory directory("compilelog");
+    const std::filesystem::path path = std::filesystem::path(directory.GetPath()) / "logs" / "compiles.log";
+    const uint64_t key = ComputePermutationKey(MakeDesc());
+
+    {
+        ShaderCompileLog log(path);
+        CHECK(log.GetRecordCount() == 0);
+        CHECK(log.Find(key) == nullptr);
+        CHECK(log.Append({ key, 125.5, "SpatialtemporalResample.cs.slang:main" }));
+        CHECK(log.Append({ 7, 3.0, "FinalShading.rt.slang:RayGen" }));
+        CHECK(log.Append({ key, 99.0, "SpatialtemporalResample.cs.slang:main" }));
+        CHECK(log.GetRecordCount() == 2);
+        CHECK(log.Find(key) && log.Find(key)->compileTime == 99.0);
+    }
+
+    // The next run reads the log, broken lines are skipped.
+    { std::ofstream file(path, std::ios::app); file << "not a record\n0123 5 short key\n"; }
+    ShaderCompileLog log(path);
+    CHECK(log.GetRecordCount() == 2);
+    const ShaderCompileRecord* record = log.Find(key);
+    CHECK(record && record->compileTime == 99.0 && record->programName == "SpatialtemporalResample.cs.slang:main");
+    CHECK(log.Find(7) && log.Find(7)->programName == "FinalShading.rt.slang:RayGen");
+    CHECK(log.Find(0x0123) == nullptr);
+}
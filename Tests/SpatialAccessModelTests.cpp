@@ -0,0 +1,86 @@
+#include "Testing.h"
+#include "SpatialAccessModel.h"
+#include <cstdlib>
+#include <set>
+
+using namespace ReSTIR;
+
+RESTIR_TEST(SpatialAccessModel, TiledTouchesFewerCacheLines)
+{
+    SpatialAccessSettings settings;
+    settings.width = 640;
+    settings.height = 360;
+
+    for (uint32_t neighborCount : { 3u, 5u })
+    {
+        settings.neighborCount = neighborCount;
+        SpatialAccessStats random = SimulateSpatialAccess(settings, SpatialReusePattern::Random, 1);
+        SpatialAccessStats tiled = SimulateSpatialAccess(settings, SpatialReusePattern::Tiled, 1);
+
+        CHECK(random.tileCount == tiled.tileCount);
+        CHECK(random.tileCount == 40 * 23);
+        CHECK(tiled.linesPerTile > 0.0);
+        CHECK_MSG(tiled.linesPerTile * 2.0 < random.linesPerTile, std::to_string(tiled.linesPerTile) + " vs " + std::to_string(random.linesPerTile));
+        CHECK(tiled.GetBytesPerTile(settings.cacheLineSize) < random.GetBytesPerTile(settings.cacheLineSize));
+    }
+}
+
+RESTIR_TEST(SpatialAccessModel, TiledReadsAreBoundedByTheStagedBlock)
+{
+    SpatialAccessSettings settings;
+    settings.width = 256;
+    settings.height = 256;
+    SpatialAccessStats tiled = SimulateSpatialAccess(settings, SpatialReusePattern::Tiled, 7);
+
+    // 24^2 reservoirs staged per tile, fewer where the moved block leaves the frame.
+    const uint32_t staged = settings.tileSize + 2 * settings.tileApron;
+    CHECK(tiled.readsPerTile <= staged * staged);
+    CHECK(tiled.readsPerTile > 0.5 * staged * staged);
+    // rows of the block are contiguous, so a row costs about its bytes in lines plus one straddled line
+    double rowLines = (double)staged * settings.elementSize / settings.cacheLineSize + 2.0;
+    CHECK(tiled.linesPerTile <= staged * rowLines);
+}
+
+RESTIR_TEST(SpatialAccessModel, PixelsOfATileUseDifferentOffsets)
+{
+    SpatialAccessSettings settings;
+    for (uint32_t frame : { 0u, 1u, 100u })
+    {
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            std::set<std::pair<int32_t, int32_t>> offsets;
+            int32_t tileX = 0, tileY = 0;
+            for (uint32_t y = 32; y < 48; y++)
+            {
+                for (uint32_t x = 16; x < 32; x++)
+                {
+                    int32_t offsetX, offsetY;
+                    GetTiledNeighborOffset(settings, x, y, frame, k, offsetX, offsetY);
+                    offsets.insert({ offsetX, offsetY });
+                    if (x == 16 && y == 32) tileX = offsetX, tileY = offsetY;
+
+                    // the neighbour stays in the staged block around the tile offset
+                    int32_t apron = (int32_t)settings.tileApron;
+                    int32_t radius = (int32_t)(settings.sampleRadius - settings.tileApron);
+                    CHECK(std::abs(offsetX) <= radius + apron && std::abs(offsetY) <= radius + apron);
+                    CHECK(std::abs(offsetX - tileX) <= 2 * apron && std::abs(offsetY - tileY) <= 2 * apron);
+                }
+            }
+            // 256 pixels over the 9x9 offsets of the apron, far more than one shared offset
+            CHECK_MSG(offsets.size() > 40, std::to_string(offsets.size()));
+        }
+    }
+
+    // the neighbours of one pixel move between frames and between k
+    std::set<std::pair<int32_t, int32_t>> perPixel;
+    for (uint32_t frame = 0; frame < 8; frame++)
+    {
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            int32_t offsetX, offsetY;
+            GetTiledNeighborOffset(settings, 100, 100, frame, k, offsetX, offsetY);
+            perPixel.insert({ offsetX, offsetY });
+        }
+    }
+    CHECK(perPixel.size() > 12);
+}
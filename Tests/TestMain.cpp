@@ -0,0 +1,72 @@
+#include "Testing.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+
+namespace ReSTIR::Testing
+{
+    namespace
+    {
+        uint32_t gFailures = 0;
+    }
+
+    std::vector<TestCase>& GetTests()
+    {
+        static std::vector<TestCase> tests;
+        return tests;
+    }
+
+    void ReportFailure(const char* file, int line, const std::string& message)
+    {
+        std::fprintf(stderr, "%s(%d): check failed: %s\n", file, line, message.c_str());
+        gFailures++;
+    }
+
+    TempDirectory::TempDirectory(const std::string& name)
+    {
+        std::random_device device;
+        auto path = std::filesystem::temp_directory_path() / ("ReSTIRHostTests_" + name + "_" + std::to_string(device()));
+        std::filesystem::create_directories(path);
+        mPath = path.string();
+    }
+
+    TempDirectory::~TempDirectory()
+    {
+        std::error_code ec;
+        std::filesystem::remove_all(mPath, ec);
+    }
+}
+
+/** ReSTIRHostTests [suite]. Runs the tests of the suite, or all tests, and returns 1 if a check failed.
+*/
+int main(int argc, char** argv)
+{
+    using namespace ReSTIR::Testing;
+    const std::string suite = argc > 1 ? argv[1] : "";
+
+    uint32_t testCount = 0;
+    uint32_t failedTests = 0;
+    for (const auto& test : GetTests())
+    {
+        if (!suite.empty() && test.suite != suite) continue;
+
+        uint32_t failuresBefore = gFailures;
+        auto start = std::chrono::steady_clock::now();
+        test.function();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        bool passed = gFailures == failuresBefore;
+        std::printf("[%s] %s.%s (%.1f ms)\n", passed ? "  OK  " : "FAILED", test.suite.c_str(), test.name.c_str(), ms);
+        testCount++;
+        if (!passed) failedTests++;
+    }
+
+    if (testCount == 0)
+    {
+        std::fprintf(stderr, "No tests in suite '%s'\n", suite.c_str());
+        return 1;
+    }
+    std::printf("%u tests, %u failed\n", testCount, failedTests);
+    return failedTests == 0 ? 0 : 1;
+}
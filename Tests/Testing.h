@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/** Minimal test registry for the host-only code, no GPU and no third party framework.
+    RESTIR_TEST(Suite, Name) registers a test, CHECK records a failure and lets the test go on.
+    ReSTIRHostTests runs all tests, or the tests of one suite when its name is passed, see CMakeLists.txt.
+*/
+namespace ReSTIR::Testing
+{
+    using TestFunction = void (*)();
+
+    struct TestCase
+    {
+        std::string suite;
+        std::string name;
+        TestFunction function;
+    };
+
+    std::vector<TestCase>& GetTests();
+    void ReportFailure(const char* file, int line, const std::string& message);
+
+    struct Registrar
+    {
+        Registrar(const char* suite, const char* name, TestFunction function) { GetTests().push_back({ suite, name, function }); }
+    };
+
+    /** Temporary directory removed with the object, for tests writing files. */
+    class TempDirectory
+    {
+    public:
+        explicit TempDirectory(const std::string& name);
+        ~TempDirectory();
+
+        const std::string& GetPath() const { return mPath; }
+
+    private:
+        std::string mPath;
+    };
+}
+
+#define RESTIR_TEST(suite, name) \
+    static void suite##_##name(); \
+    static ReSTIR::Testing::Registrar suite##_##name##Registrar(#suite, #name, suite##_##name); \
+    static void suite##_##name()
+
+#define CHECK(expression) \
+    do { if (!(expression)) ReSTIR::Testing::ReportFailure(__FILE__, __LINE__, #expression); } while (0)
+
+#define CHECK_MSG(expression, message) \
+    do { if (!(expression)) ReSTIR::Testing::ReportFailure(__FILE__, __LINE__, std::string(#expression) + ": " + (message)); } while (0)
+
+#define CHECK_THROWS(expression) \
+    do { bool thrown = false; try { (void)(expression); } catch (...) { thrown = true; } \
+         if (!thrown) ReSTIR::Testing::ReportFailure(__FILE__, __LINE__, std::string(#expression) + " did not throw"); } while (0)